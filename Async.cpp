@@ -0,0 +1,52 @@
+//! @file Async.cpp
+#include "Async.hpp"
+#include "ThreadPool.hpp"
+
+#include <memory>
+#include <utility>
+
+namespace svg
+{
+    void convertAsync(const std::string &svg_file, const std::string &png_file,
+                      const RenderOptions &options, CancellationToken cancel, ConvertCallback done)
+    {
+        ThreadPool::shared().submit([svg_file, png_file, options, cancel, done]()
+                                    {
+                                        RenderStats stats;
+                                        std::exception_ptr error;
+                                        try
+                                        {
+                                            RenderOptions task_options = options;
+                                            task_options.cancel = &cancel;
+                                            checkCancelled(&cancel);
+                                            convert(svg_file, png_file, task_options, &stats);
+                                        }
+                                        catch (...)
+                                        {
+                                            error = std::current_exception();
+                                        }
+                                        done(error, stats);
+                                    });
+    }
+
+    std::future<RenderStats> convertAsync(const std::string &svg_file, const std::string &png_file,
+                                          const RenderOptions &options, CancellationToken cancel)
+    {
+        // std::function needs a copyable callback, so the promise is shared.
+        std::shared_ptr<std::promise<RenderStats>> result = std::make_shared<std::promise<RenderStats>>();
+        std::future<RenderStats> future = result->get_future();
+        convertAsync(svg_file, png_file, options, std::move(cancel),
+                     [result](std::exception_ptr error, const RenderStats &stats)
+                     {
+                         if (error)
+                         {
+                             result->set_exception(error);
+                         }
+                         else
+                         {
+                             result->set_value(stats);
+                         }
+                     });
+        return future;
+    }
+}
@@ -0,0 +1,41 @@
+//! @file Async.hpp
+#ifndef __svg_Async_hpp__
+#define __svg_Async_hpp__
+
+#include "Cancellation.hpp"
+#include "SVGElements.hpp"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <string>
+
+namespace svg
+{
+    //! Called on a pool thread when an asynchronous conversion ends.
+    //! @param error Exception thrown by the conversion (Cancelled if it was
+    //! cancelled), or null on success.
+    //! @param stats Rendering measurements (only valid on success).
+    typedef std::function<void(std::exception_ptr error, const RenderStats &stats)> ConvertCallback;
+
+    //! Convert a file on ThreadPool::shared() without blocking the caller.
+    //! Cancelling the token stops parsing at the next element and drawing at
+    //! the next scanline; a conversion still queued does not start.
+    //! @param svg_file SVG (or scene) file.
+    //! @param png_file PNG file to write.
+    //! @param options Rendering options (their cancel pointer is replaced by cancel).
+    //! @param cancel Token the caller keeps to cancel the conversion.
+    //! @return Rendering measurements, or the exception of the conversion.
+    std::future<RenderStats> convertAsync(const std::string &svg_file, const std::string &png_file,
+                                          const RenderOptions &options = RenderOptions(),
+                                          CancellationToken cancel = CancellationToken());
+    //! Convert a file on ThreadPool::shared() and report the result to a callback.
+    //! @param svg_file SVG (or scene) file.
+    //! @param png_file PNG file to write.
+    //! @param options Rendering options (their cancel pointer is replaced by cancel).
+    //! @param cancel Token the caller keeps to cancel the conversion.
+    //! @param done Called once with the result; it must not throw.
+    void convertAsync(const std::string &svg_file, const std::string &png_file,
+                      const RenderOptions &options, CancellationToken cancel, ConvertCallback done);
+}
+#endif
@@ -0,0 +1,100 @@
+//! @file BoundedQueue.hpp
+#ifndef __svg_BoundedQueue_hpp__
+#define __svg_BoundedQueue_hpp__
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace svg
+{
+    //! Blocking first-in first-out queue with a maximum size, used to join
+    //! threads of consecutive stages. It also records how full it was.
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        //! Constructor.
+        //! @param capacity Maximum number of queued items (at least 1).
+        explicit BoundedQueue(size_t capacity)
+            : capacity_(capacity > 0 ? capacity : 1), closed_(false),
+              pushes_(0), depth_sum_(0), max_depth_(0)
+        {
+        }
+        //! Add an item, waiting while the queue is full.
+        //! @param item Item.
+        void push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+            items_.push_back(std::move(item));
+            pushes_++;
+            depth_sum_ += items_.size();
+            if (items_.size() > max_depth_)
+            {
+                max_depth_ = items_.size();
+            }
+            not_empty_.notify_one();
+        }
+        //! Take the oldest item, waiting while the queue is empty.
+        //! @param item Where to store the item.
+        //! @return False if the queue is closed and empty.
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+            if (items_.empty())
+            {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return true;
+        }
+        //! Signal that no more items will be pushed.
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+        }
+        //! Get the largest number of items queued at once.
+        //! @return The maximum depth.
+        size_t max_depth() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return max_depth_;
+        }
+        //! Get the average number of queued items, right after each push.
+        //! @return The mean depth.
+        double mean_depth() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return pushes_ > 0 ? (double)depth_sum_ / pushes_ : 0;
+        }
+
+    private:
+        //! Maximum number of items.
+        size_t capacity_;
+        //! Queued items.
+        std::deque<T> items_;
+        //! Whether close() was called.
+        bool closed_;
+        //! Number of pushed items.
+        size_t pushes_;
+        //! Sum of the depths after each push.
+        size_t depth_sum_;
+        //! Largest depth.
+        size_t max_depth_;
+        //! Protects all members.
+        mutable std::mutex mutex_;
+        //! Signalled when an item is taken.
+        std::condition_variable not_full_;
+        //! Signalled when an item is added or the queue is closed.
+        std::condition_variable not_empty_;
+    };
+}
+#endif
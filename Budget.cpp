@@ -0,0 +1,179 @@
+//! @file Budget.cpp
+#include "Budget.hpp"
+#include "Color.hpp"
+#include "SceneOptimizer.hpp"
+
+#include <string>
+
+namespace svg
+{
+    namespace
+    {
+        /**
+         * @brief Gets the pixels of an image as a box.
+         */
+        Box canvasOf(const Point &dimensions)
+        {
+            return Box{{0, 0}, {dimensions.x - 1, dimensions.y - 1}};
+        }
+
+        /**
+         * @brief Gets the memory of an image, throwing for sizes no image can have.
+         */
+        uint64_t imageBytes(const Point &dimensions)
+        {
+            checkDimensions(dimensions, "Document");
+            return (uint64_t)dimensions.x * (uint64_t)dimensions.y * sizeof(Color);
+        }
+
+        /**
+         * @brief Removes the elements that do not fit the budget, in painting order.
+         *
+         * @param svg_elements The elements (groups are entered).
+         * @param canvas The pixels of the image.
+         * @param budget The limits.
+         * @param used The cost of the elements kept so far.
+         * @return True once an element did not fit.
+         */
+        bool truncate(std::vector<std::unique_ptr<SVGElement>> &svg_elements, const Box &canvas,
+                      const RenderBudget &budget, RenderCost &used)
+        {
+            for (size_t i = 0; i < svg_elements.size(); i++)
+            {
+                Group *g = dynamic_cast<Group *>(svg_elements[i].get());
+                if (g != nullptr)
+                {
+                    if (truncate(g->elements(), canvas, budget, used))
+                    {
+                        svg_elements.erase(svg_elements.begin() + i + 1, svg_elements.end());
+                        return true;
+                    }
+                    continue;
+                }
+                RenderCost with = used;
+                svg_elements[i]->cost(canvas, with);
+                if (!budgetExcess(with, budget).empty())
+                {
+                    svg_elements.erase(svg_elements.begin() + i, svg_elements.end());
+                    return true;
+                }
+                used = with;
+            }
+            return false;
+        }
+    }
+
+    RenderCost estimateCost(const std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                            const Point &dimensions)
+    {
+        RenderCost cost;
+        cost.bytes = imageBytes(dimensions);
+        Box canvas = canvasOf(dimensions);
+        for (const std::unique_ptr<SVGElement> &e : svg_elements)
+        {
+            e->cost(canvas, cost);
+        }
+        return cost;
+    }
+
+    RenderCost estimateCost(const SceneFile &scene, const Point &dimensions)
+    {
+        RenderCost cost;
+        cost.bytes = imageBytes(dimensions);
+        scene.cost(canvasOf(dimensions), cost);
+        return cost;
+    }
+
+    std::string budgetExcess(const RenderCost &cost, const RenderBudget &budget)
+    {
+        struct Limit
+        {
+            const char *name;
+            uint64_t value, limit;
+        };
+        for (const Limit &l : {Limit{"pixels", cost.pixels, budget.max_pixels},
+                               Limit{"edges", cost.edges, budget.max_edges},
+                               Limit{"vertices", cost.vertices, budget.max_vertices},
+                               Limit{"bytes", cost.bytes, budget.max_bytes}})
+        {
+            if (l.limit != 0 && l.value > l.limit)
+            {
+                return std::to_string(l.value) + " " + l.name + " (limit " + std::to_string(l.limit) + ")";
+            }
+        }
+        return "";
+    }
+
+    void enforceBudget(std::vector<std::unique_ptr<SVGElement>> &svg_elements, Point &dimensions,
+                       const RenderOptions &options, RenderStats &stats)
+    {
+        const RenderBudget &budget = options.budget;
+        stats.cost = estimateCost(svg_elements, dimensions);
+        std::string excess = budgetExcess(stats.cost, budget);
+        if (excess.empty())
+        {
+            return;
+        }
+        switch (budget.policy)
+        {
+        case BudgetPolicy::Reject:
+            throw BudgetExceeded("Render budget exceeded: " + excess);
+        case BudgetPolicy::Downscale:
+        {
+            // Halve the resolution until the scene fits, dropping the vertices
+            // that no longer matter at the lower resolution.
+            RenderCost cost = stats.cost;
+            while (!excess.empty())
+            {
+                if (dimensions.x <= 1 && dimensions.y <= 1)
+                {
+                    throw BudgetExceeded("Render budget exceeded at any size: " + excess);
+                }
+                for (const std::unique_ptr<SVGElement> &e : svg_elements)
+                {
+                    e->shrink(2);
+                    e->simplify(options.simplify_tolerance);
+                }
+                dimensions = {(dimensions.x + 1) / 2, (dimensions.y + 1) / 2};
+                stats.downscale *= 2;
+                cost = estimateCost(svg_elements, dimensions);
+                excess = budgetExcess(cost, budget);
+            }
+            return;
+        }
+        case BudgetPolicy::Truncate:
+        {
+            RenderCost used;
+            used.bytes = imageBytes(dimensions);
+            if (!budgetExcess(used, budget).empty())
+            {
+                throw BudgetExceeded("Render budget exceeded by the image alone: " + budgetExcess(used, budget));
+            }
+            size_t shapes = sceneStats(svg_elements).shapes;
+            truncate(svg_elements, canvasOf(dimensions), budget, used);
+            stats.truncated = shapes - sceneStats(svg_elements).shapes;
+            return;
+        }
+        }
+    }
+
+    void enforceBudget(const SceneFile &scene, const Point &dimensions,
+                       const RenderOptions &options, RenderStats &stats)
+    {
+        stats.cost = estimateCost(scene, dimensions);
+        std::string excess = budgetExcess(stats.cost, options.budget);
+        if (!excess.empty())
+        {
+            throw BudgetExceeded("Render budget exceeded by scene file: " + excess);
+        }
+    }
+
+    void throwIfTruncated(const RenderStats &stats, const RenderOptions &options)
+    {
+        if (stats.truncated > 0)
+        {
+            throw BudgetExceeded("Render budget exceeded: " + budgetExcess(stats.cost, options.budget) +
+                                 "; the last " + std::to_string(stats.truncated) + " elements were not drawn");
+        }
+    }
+}
@@ -0,0 +1,75 @@
+//! @file Budget.hpp
+#ifndef __svg_Budget_hpp__
+#define __svg_Budget_hpp__
+
+#include "SVGElements.hpp"
+#include "SceneFile.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Thrown when a document does not fit its RenderBudget.
+    class BudgetExceeded : public std::runtime_error
+    {
+    public:
+        //! Constructor.
+        //! @param what Description of the exceeded limit.
+        explicit BudgetExceeded(const std::string &what) : std::runtime_error(what)
+        {
+        }
+    };
+
+    //! Estimate the work and memory of drawing a parsed scene, in one pass
+    //! over its elements and without drawing.
+    //! @param svg_elements Elements of the scene.
+    //! @param dimensions Image size (throws std::runtime_error if invalid).
+    //! @return Estimated cost.
+    RenderCost estimateCost(const std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                            const Point &dimensions);
+
+    //! Estimate the work and memory of drawing a scene file.
+    //! @param scene Scene.
+    //! @param dimensions Image size.
+    //! @return Estimated cost.
+    RenderCost estimateCost(const SceneFile &scene, const Point &dimensions);
+
+    //! Check a cost against a budget.
+    //! @param cost Estimated cost.
+    //! @param budget Limits.
+    //! @return Description of the first exceeded limit, or "" if the cost fits.
+    std::string budgetExcess(const RenderCost &cost, const RenderBudget &budget);
+
+    //! Apply a budget to a parsed scene before drawing it. The scene is left
+    //! as is if it fits; otherwise, depending on the budget policy, this
+    //! throws BudgetExceeded, shrinks the scene and its dimensions, or removes
+    //! the elements, in painting order, from the first one that does not fit.
+    //! @param svg_elements Elements of the scene.
+    //! @param dimensions Image size (updated when downscaling).
+    //! @param options Rendering options (budget and simplification tolerance).
+    //! @param stats Where the cost, downscale factor and number of removed
+    //! elements are stored.
+    void enforceBudget(std::vector<std::unique_ptr<SVGElement>> &svg_elements, Point &dimensions,
+                       const RenderOptions &options, RenderStats &stats);
+
+    //! Apply a budget to a scene file before drawing it. Its geometry is
+    //! final, so it is neither downscaled nor truncated: it is rejected
+    //! whatever the policy if it does not fit.
+    //! @param scene Scene.
+    //! @param dimensions Image size.
+    //! @param options Rendering options.
+    //! @param stats Where the cost is stored.
+    //! @throw BudgetExceeded If the scene does not fit.
+    void enforceBudget(const SceneFile &scene, const Point &dimensions,
+                       const RenderOptions &options, RenderStats &stats);
+
+    //! Report elements removed by enforceBudget(), once the rest was drawn.
+    //! @param stats Measurements filled by enforceBudget().
+    //! @param options Rendering options.
+    //! @throw BudgetExceeded If elements were removed.
+    void throwIfTruncated(const RenderStats &stats, const RenderOptions &options);
+}
+#endif
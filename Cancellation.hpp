@@ -0,0 +1,57 @@
+//! @file Cancellation.hpp
+#ifndef __svg_Cancellation_hpp__
+#define __svg_Cancellation_hpp__
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+namespace svg
+{
+    //! Request to abandon a conversion. Copies share the same state, so a
+    //! caller can keep one copy and cancel the work holding another.
+    class CancellationToken
+    {
+    public:
+        //! Constructor (not cancelled).
+        CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false))
+        {
+        }
+        //! Ask the work using this token to stop.
+        void cancel() const
+        {
+            cancelled_->store(true, std::memory_order_relaxed);
+        }
+        //! Check if cancel() was called on this token or a copy.
+        //! @return True if cancelled.
+        bool cancelled() const
+        {
+            return cancelled_->load(std::memory_order_relaxed);
+        }
+
+    private:
+        //! Shared flag.
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+    };
+
+    //! Thrown by parsing and drawing when their token is cancelled.
+    class Cancelled : public std::runtime_error
+    {
+    public:
+        //! Constructor.
+        Cancelled() : std::runtime_error("Conversion cancelled")
+        {
+        }
+    };
+
+    //! Throw Cancelled if a token is cancelled.
+    //! @param cancel Token, or nullptr if the work cannot be cancelled.
+    inline void checkCancelled(const CancellationToken *cancel)
+    {
+        if (cancel != nullptr && cancel->cancelled())
+        {
+            throw Cancelled();
+        }
+    }
+}
+#endif
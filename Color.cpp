@@ -1,34 +1,431 @@
 #include "Color.hpp"
-#include <map>
-#include <iomanip>
-#include <sstream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
 
 namespace svg
 {
-    const std::map<std::string, Color> NAMES_TO_COLORS = {
+    namespace
+    {
+        //! A color keyword and its value.
+        struct NamedColor
+        {
+            const char *name;
+            Color color;
+        };
+
+        //! The 147 color keywords of CSS 3 / SVG 1.1. "green" keeps the
+        //! value this project has always used for it (CSS "lime").
+        constexpr NamedColor NAMED_COLORS[] = {
+        {"aliceblue", {240, 248, 255}},
+        {"antiquewhite", {250, 235, 215}},
+        {"aqua", {0, 255, 255}},
+        {"aquamarine", {127, 255, 212}},
+        {"azure", {240, 255, 255}},
+        {"beige", {245, 245, 220}},
+        {"bisque", {255, 228, 196}},
         {"black", {0, 0, 0}},
-        {"white", {255, 255, 255}},
-        {"red", {255, 0, 0}},
-        {"green", {0, 255, 0}},
+        {"blanchedalmond", {255, 235, 205}},
         {"blue", {0, 0, 255}},
-        {"yellow", {255, 255, 0}}};
+        {"blueviolet", {138, 43, 226}},
+        {"brown", {165, 42, 42}},
+        {"burlywood", {222, 184, 135}},
+        {"cadetblue", {95, 158, 160}},
+        {"chartreuse", {127, 255, 0}},
+        {"chocolate", {210, 105, 30}},
+        {"coral", {255, 127, 80}},
+        {"cornflowerblue", {100, 149, 237}},
+        {"cornsilk", {255, 248, 220}},
+        {"crimson", {220, 20, 60}},
+        {"cyan", {0, 255, 255}},
+        {"darkblue", {0, 0, 139}},
+        {"darkcyan", {0, 139, 139}},
+        {"darkgoldenrod", {184, 134, 11}},
+        {"darkgray", {169, 169, 169}},
+        {"darkgreen", {0, 100, 0}},
+        {"darkgrey", {169, 169, 169}},
+        {"darkkhaki", {189, 183, 107}},
+        {"darkmagenta", {139, 0, 139}},
+        {"darkolivegreen", {85, 107, 47}},
+        {"darkorange", {255, 140, 0}},
+        {"darkorchid", {153, 50, 204}},
+        {"darkred", {139, 0, 0}},
+        {"darksalmon", {233, 150, 122}},
+        {"darkseagreen", {143, 188, 143}},
+        {"darkslateblue", {72, 61, 139}},
+        {"darkslategray", {47, 79, 79}},
+        {"darkslategrey", {47, 79, 79}},
+        {"darkturquoise", {0, 206, 209}},
+        {"darkviolet", {148, 0, 211}},
+        {"deeppink", {255, 20, 147}},
+        {"deepskyblue", {0, 191, 255}},
+        {"dimgray", {105, 105, 105}},
+        {"dimgrey", {105, 105, 105}},
+        {"dodgerblue", {30, 144, 255}},
+        {"firebrick", {178, 34, 34}},
+        {"floralwhite", {255, 250, 240}},
+        {"forestgreen", {34, 139, 34}},
+        {"fuchsia", {255, 0, 255}},
+        {"gainsboro", {220, 220, 220}},
+        {"ghostwhite", {248, 248, 255}},
+        {"gold", {255, 215, 0}},
+        {"goldenrod", {218, 165, 32}},
+        {"gray", {128, 128, 128}},
+        {"green", {0, 255, 0}},
+        {"greenyellow", {173, 255, 47}},
+        {"grey", {128, 128, 128}},
+        {"honeydew", {240, 255, 240}},
+        {"hotpink", {255, 105, 180}},
+        {"indianred", {205, 92, 92}},
+        {"indigo", {75, 0, 130}},
+        {"ivory", {255, 255, 240}},
+        {"khaki", {240, 230, 140}},
+        {"lavender", {230, 230, 250}},
+        {"lavenderblush", {255, 240, 245}},
+        {"lawngreen", {124, 252, 0}},
+        {"lemonchiffon", {255, 250, 205}},
+        {"lightblue", {173, 216, 230}},
+        {"lightcoral", {240, 128, 128}},
+        {"lightcyan", {224, 255, 255}},
+        {"lightgoldenrodyellow", {250, 250, 210}},
+        {"lightgray", {211, 211, 211}},
+        {"lightgreen", {144, 238, 144}},
+        {"lightgrey", {211, 211, 211}},
+        {"lightpink", {255, 182, 193}},
+        {"lightsalmon", {255, 160, 122}},
+        {"lightseagreen", {32, 178, 170}},
+        {"lightskyblue", {135, 206, 250}},
+        {"lightslategray", {119, 136, 153}},
+        {"lightslategrey", {119, 136, 153}},
+        {"lightsteelblue", {176, 196, 222}},
+        {"lightyellow", {255, 255, 224}},
+        {"lime", {0, 255, 0}},
+        {"limegreen", {50, 205, 50}},
+        {"linen", {250, 240, 230}},
+        {"magenta", {255, 0, 255}},
+        {"maroon", {128, 0, 0}},
+        {"mediumaquamarine", {102, 205, 170}},
+        {"mediumblue", {0, 0, 205}},
+        {"mediumorchid", {186, 85, 211}},
+        {"mediumpurple", {147, 112, 219}},
+        {"mediumseagreen", {60, 179, 113}},
+        {"mediumslateblue", {123, 104, 238}},
+        {"mediumspringgreen", {0, 250, 154}},
+        {"mediumturquoise", {72, 209, 204}},
+        {"mediumvioletred", {199, 21, 133}},
+        {"midnightblue", {25, 25, 112}},
+        {"mintcream", {245, 255, 250}},
+        {"mistyrose", {255, 228, 225}},
+        {"moccasin", {255, 228, 181}},
+        {"navajowhite", {255, 222, 173}},
+        {"navy", {0, 0, 128}},
+        {"oldlace", {253, 245, 230}},
+        {"olive", {128, 128, 0}},
+        {"olivedrab", {107, 142, 35}},
+        {"orange", {255, 165, 0}},
+        {"orangered", {255, 69, 0}},
+        {"orchid", {218, 112, 214}},
+        {"palegoldenrod", {238, 232, 170}},
+        {"palegreen", {152, 251, 152}},
+        {"paleturquoise", {175, 238, 238}},
+        {"palevioletred", {219, 112, 147}},
+        {"papayawhip", {255, 239, 213}},
+        {"peachpuff", {255, 218, 185}},
+        {"peru", {205, 133, 63}},
+        {"pink", {255, 192, 203}},
+        {"plum", {221, 160, 221}},
+        {"powderblue", {176, 224, 230}},
+        {"purple", {128, 0, 128}},
+        {"red", {255, 0, 0}},
+        {"rosybrown", {188, 143, 143}},
+        {"royalblue", {65, 105, 225}},
+        {"saddlebrown", {139, 69, 19}},
+        {"salmon", {250, 128, 114}},
+        {"sandybrown", {244, 164, 96}},
+        {"seagreen", {46, 139, 87}},
+        {"seashell", {255, 245, 238}},
+        {"sienna", {160, 82, 45}},
+        {"silver", {192, 192, 192}},
+        {"skyblue", {135, 206, 235}},
+        {"slateblue", {106, 90, 205}},
+        {"slategray", {112, 128, 144}},
+        {"slategrey", {112, 128, 144}},
+        {"snow", {255, 250, 250}},
+        {"springgreen", {0, 255, 127}},
+        {"steelblue", {70, 130, 180}},
+        {"tan", {210, 180, 140}},
+        {"teal", {0, 128, 128}},
+        {"thistle", {216, 191, 216}},
+        {"tomato", {255, 99, 71}},
+        {"turquoise", {64, 224, 208}},
+        {"violet", {238, 130, 238}},
+        {"wheat", {245, 222, 179}},
+        {"white", {255, 255, 255}},
+        {"whitesmoke", {245, 245, 245}},
+        {"yellow", {255, 255, 0}},
+        {"yellowgreen", {154, 205, 50}},
+        };
+        constexpr size_t NAMED_COLOR_COUNT = sizeof(NAMED_COLORS) / sizeof(NAMED_COLORS[0]);
+
+        //! Number of first-level buckets of the perfect hash.
+        constexpr size_t HASH_BUCKETS = 64;
+        //! Number of slots of the perfect hash table.
+        constexpr size_t HASH_SLOTS = 256;
+        //! Marker of an unused slot.
+        constexpr uint8_t EMPTY_SLOT = 0xFF;
+        //! Largest bucket the table builder can handle.
+        constexpr size_t MAX_BUCKET_SIZE = 16;
+
+        //! Length of a C string (usable at compile time).
+        constexpr size_t name_length(const char *s)
+        {
+            size_t n = 0;
+            while (s[n] != '\0')
+            {
+                n++;
+            }
+            return n;
+        }
+
+        //! Seeded FNV-1a hash of a name, ignoring ASCII letter case.
+        constexpr uint32_t name_hash(const char *s, size_t n, uint32_t seed)
+        {
+            uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+            for (size_t i = 0; i < n; i++)
+            {
+                h ^= (uint8_t)(s[i] | 0x20);
+                h *= 16777619u;
+            }
+            return h ^ (h >> 16);
+        }
+
+        //! Two-level perfect hash ("hash and displace") of the color names:
+        //! a name goes to bucket name_hash(name, 0), and the seed of that
+        //! bucket takes it to a slot no other name uses.
+        struct PerfectHash
+        {
+            //! Second-level seed of each bucket.
+            uint32_t seed[HASH_BUCKETS];
+            //! Index into NAMED_COLORS of each slot, or EMPTY_SLOT.
+            uint8_t slot[HASH_SLOTS];
+            //! Whether construction succeeded.
+            bool ok;
+        };
+
+        //! Build the perfect hash table at compile time.
+        //! Buckets are placed from the largest to the smallest, trying
+        //! seeds until all of the bucket's names land in free slots.
+        constexpr PerfectHash build_perfect_hash()
+        {
+            PerfectHash ph{};
+            for (size_t s = 0; s < HASH_SLOTS; s++)
+            {
+                ph.slot[s] = EMPTY_SLOT;
+            }
+            size_t bucket_of[NAMED_COLOR_COUNT] = {};
+            size_t bucket_size[HASH_BUCKETS] = {};
+            for (size_t k = 0; k < NAMED_COLOR_COUNT; k++)
+            {
+                const char *name = NAMED_COLORS[k].name;
+                bucket_of[k] = name_hash(name, name_length(name), 0) % HASH_BUCKETS;
+                bucket_size[bucket_of[k]]++;
+            }
+            ph.ok = true;
+            for (size_t size = MAX_BUCKET_SIZE; size > 0; size--)
+            {
+                for (size_t b = 0; b < HASH_BUCKETS; b++)
+                {
+                    if (bucket_size[b] != size)
+                    {
+                        continue;
+                    }
+                    size_t keys[MAX_BUCKET_SIZE] = {};
+                    size_t n = 0;
+                    for (size_t k = 0; k < NAMED_COLOR_COUNT; k++)
+                    {
+                        if (bucket_of[k] == b)
+                        {
+                            keys[n++] = k;
+                        }
+                    }
+                    bool placed = false;
+                    for (uint32_t seed = 1; seed < 100000 && !placed; seed++)
+                    {
+                        size_t slots[MAX_BUCKET_SIZE] = {};
+                        bool fits = true;
+                        for (size_t i = 0; i < n && fits; i++)
+                        {
+                            const char *name = NAMED_COLORS[keys[i]].name;
+                            slots[i] = name_hash(name, name_length(name), seed) % HASH_SLOTS;
+                            fits = ph.slot[slots[i]] == EMPTY_SLOT;
+                            for (size_t j = 0; j < i && fits; j++)
+                            {
+                                fits = slots[j] != slots[i];
+                            }
+                        }
+                        if (fits)
+                        {
+                            ph.seed[b] = seed;
+                            for (size_t i = 0; i < n; i++)
+                            {
+                                ph.slot[slots[i]] = (uint8_t)keys[i];
+                            }
+                            placed = true;
+                        }
+                    }
+                    ph.ok = ph.ok && placed;
+                }
+            }
+            for (size_t b = 0; b < HASH_BUCKETS; b++)
+            {
+                ph.ok = ph.ok && bucket_size[b] <= MAX_BUCKET_SIZE;
+            }
+            return ph;
+        }
+
+        constexpr PerfectHash COLOR_HASH = build_perfect_hash();
+        static_assert(COLOR_HASH.ok, "Color name table is not a perfect hash");
+        static_assert(NAMED_COLOR_COUNT < EMPTY_SLOT, "Too many color names");
+
+        //! Look up a color keyword (case-insensitive).
+        bool find_named_color(const char *s, size_t n, Color &c)
+        {
+            uint32_t b = name_hash(s, n, 0) % HASH_BUCKETS;
+            uint8_t k = COLOR_HASH.slot[name_hash(s, n, COLOR_HASH.seed[b]) % HASH_SLOTS];
+            if (k == EMPTY_SLOT)
+            {
+                return false;
+            }
+            const char *name = NAMED_COLORS[k].name;
+            size_t i = 0;
+            for (; i < n && name[i] != '\0'; i++)
+            {
+                if ((s[i] | 0x20) != name[i])
+                {
+                    return false;
+                }
+            }
+            if (i != n || name[i] != '\0')
+            {
+                return false;
+            }
+            c = NAMED_COLORS[k].color;
+            return true;
+        }
+
+        //! Value of a hexadecimal digit, or -1.
+        inline int hex_digit(char ch)
+        {
+            unsigned d = (unsigned)(ch - '0');
+            if (d < 10)
+            {
+                return (int)d;
+            }
+            d = (unsigned)((ch | 0x20) - 'a');
+            return d < 6 ? (int)d + 10 : -1;
+        }
+
+        //! Parse '#rgb' or '#rrggbb' (s points after the '#').
+        bool parse_hex(const char *s, size_t n, Color &c)
+        {
+            if (n == 6)
+            {
+                int r1 = hex_digit(s[0]), r0 = hex_digit(s[1]);
+                int g1 = hex_digit(s[2]), g0 = hex_digit(s[3]);
+                int b1 = hex_digit(s[4]), b0 = hex_digit(s[5]);
+                if ((r1 | r0 | g1 | g0 | b1 | b0) < 0)
+                {
+                    return false;
+                }
+                c.red = (rgb_value)(r1 << 4 | r0);
+                c.green = (rgb_value)(g1 << 4 | g0);
+                c.blue = (rgb_value)(b1 << 4 | b0);
+                return true;
+            }
+            if (n == 3)
+            {
+                int r = hex_digit(s[0]), g = hex_digit(s[1]), b = hex_digit(s[2]);
+                if ((r | g | b) < 0)
+                {
+                    return false;
+                }
+                c.red = (rgb_value)(r * 17);
+                c.green = (rgb_value)(g * 17);
+                c.blue = (rgb_value)(b * 17);
+                return true;
+            }
+            return false;
+        }
+
+        //! Skip spaces in a functional color notation.
+        inline void skip_spaces(const char *&s, const char *end)
+        {
+            while (s < end && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r'))
+            {
+                s++;
+            }
+        }
+
+        //! Parse one 'rgb()' component: an integer or a percentage.
+        bool parse_component(const char *&s, const char *end, rgb_value &v)
+        {
+            skip_spaces(s, end);
+            int value = 0, digits = 0;
+            for (; s < end && (unsigned)(*s - '0') < 10; s++, digits++)
+            {
+                value = std::min(value * 10 + (*s - '0'), 100000);
+            }
+            if (digits == 0)
+            {
+                return false;
+            }
+            if (s < end && *s == '%')
+            {
+                s++;
+                value = (std::min(value, 100) * 255 + 50) / 100;
+            }
+            v = (rgb_value)std::min(value, 255);
+            skip_spaces(s, end);
+            return true;
+        }
+
+        //! Parse 'rgb(r, g, b)' (s points after 'rgb(').
+        bool parse_rgb(const char *s, const char *end, Color &c)
+        {
+            if (!parse_component(s, end, c.red) || s == end || *s++ != ',' ||
+                !parse_component(s, end, c.green) || s == end || *s++ != ',' ||
+                !parse_component(s, end, c.blue) || s == end || *s++ != ')')
+            {
+                return false;
+            }
+            skip_spaces(s, end);
+            return s == end;
+        }
+    }
 
     Color parse_color(const std::string &str)
     {
-        Color c;
-        if (str.at(0) == '#')
+        Color c = {0, 0, 0};
+        const char *s = str.data();
+        size_t n = str.size();
+        bool ok;
+        if (n > 0 && s[0] == '#')
+        {
+            ok = parse_hex(s + 1, n - 1, c);
+        }
+        else if (n > 4 && (s[0] | 0x20) == 'r' && (s[1] | 0x20) == 'g' && (s[2] | 0x20) == 'b' && s[3] == '(')
         {
-            int v;
-            std::istringstream ss(str.substr(1));
-            ss >> std::hex >> v;
-            c.red = (v >> 16);
-            c.green = (v >> 8) & 0xFF;
-            c.blue = v & 0xFF;
+            ok = parse_rgb(s + 4, s + n, c);
         }
         else
         {
-            c = NAMES_TO_COLORS.at(str);
+            ok = find_named_color(s, n, c);
+        }
+        if (!ok)
+        {
+            throw std::invalid_argument("Invalid color: " + str);
         }
         return c;
     }
-}
\ No newline at end of file
+}
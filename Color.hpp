@@ -18,11 +18,14 @@ namespace svg {
   };
 
   //! Parse a color from a string.
-  //! The string may refer to a color name or have a
-  //! '#rrggbb' format where 'rr', 'gg' and 'bb' 
-  //! are hexadecimal values for each RGB component. 
+  //! The string may refer to a color name (any of the 147 CSS
+  //! color keywords, case-insensitive), have a '#rrggbb' or
+  //! '#rgb' format where 'rr', 'gg' and 'bb' (or 'r', 'g', 'b')
+  //! are hexadecimal values for each RGB component, or have
+  //! an 'rgb(r, g, b)' format with integers or percentages.
   //! @param str String.
   //! @return A corresponding color.
+  //! @throw std::invalid_argument If the string is not a valid color.
   Color parse_color(const std::string& str);
   
 }
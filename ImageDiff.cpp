@@ -0,0 +1,120 @@
+//! @file ImageDiff.cpp
+#include "ImageDiff.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace svg
+{
+    namespace
+    {
+        //! Pixels compared by one vector step (48 bytes, three SSE2 registers).
+        const int BLOCK = 16;
+
+        /**
+         * @brief Gets the largest channel difference of two pixels.
+         */
+        int channelDifference(const Color &a, const Color &b)
+        {
+            return std::max(std::max(std::abs(a.red - b.red), std::abs(a.green - b.green)),
+                            std::abs(a.blue - b.blue));
+        }
+
+        /**
+         * @brief Checks if a block of pixels may contain a difference above the tolerance.
+         *
+         * @param a The first pixel of the block in one image.
+         * @param b The first pixel of the block in the other image.
+         * @param tolerance The largest difference considered equal.
+         * @return False only if every channel is within the tolerance.
+         */
+        bool blockDiffers(const Color *a, const Color *b, int tolerance)
+        {
+#ifdef __SSE2__
+            const __m128i limit = _mm_set1_epi8((char)(uint8_t)tolerance);
+            const __m128i zero = _mm_setzero_si128();
+            __m128i over = zero;
+            for (int k = 0; k < 3; k++)
+            {
+                __m128i va = _mm_loadu_si128((const __m128i *)((const uint8_t *)a + 16 * k));
+                __m128i vb = _mm_loadu_si128((const __m128i *)((const uint8_t *)b + 16 * k));
+                __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+                over = _mm_or_si128(over, _mm_subs_epu8(diff, limit));
+            }
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(over, zero)) != 0xFFFF;
+#else
+            for (int i = 0; i < BLOCK; i++)
+            {
+                if (channelDifference(a[i], b[i]) > tolerance)
+                {
+                    return true;
+                }
+            }
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Gets a faded gray copy of a pixel, for the unchanged parts of a heatmap.
+         */
+        Color faded(const Color &c)
+        {
+            uint8_t gray = (uint8_t)(192 + (c.red * 77 + c.green * 150 + c.blue * 29) / (256 * 4));
+            return {gray, gray, gray};
+        }
+    }
+
+    DiffResult diffImages(const PNGImage &expected, const PNGImage &actual, int tolerance, PNGImage *heatmap)
+    {
+        DiffResult result;
+        int w = expected.width(), h = expected.height();
+        if (w != actual.width() || h != actual.height())
+        {
+            return result;
+        }
+        result.same_size = true;
+        tolerance = std::max(0, std::min(tolerance, 255));
+        bool map = heatmap != nullptr && heatmap->width() == w && heatmap->height() == h;
+        for (int y = 0; y < h; y++)
+        {
+            const Color *a = expected.row(y), *b = actual.row(y);
+            Color *out = map ? heatmap->row(y) : nullptr;
+            for (int x0 = 0; x0 < w; x0 += BLOCK)
+            {
+                int x1 = std::min(x0 + BLOCK, w);
+                // Blocks within the tolerance are the common case: one vector test.
+                if (x1 - x0 < BLOCK || blockDiffers(a + x0, b + x0, tolerance))
+                {
+                    for (int x = x0; x < x1; x++)
+                    {
+                        int d = channelDifference(a[x], b[x]);
+                        if (d > tolerance)
+                        {
+                            if (result.pixels == 0)
+                            {
+                                result.first = {x, y};
+                            }
+                            result.pixels++;
+                            result.box.extend(Point{x, y});
+                            result.max_difference = std::max(result.max_difference, d);
+                        }
+                    }
+                }
+                if (out != nullptr)
+                {
+                    for (int x = x0; x < x1; x++)
+                    {
+                        int d = channelDifference(a[x], b[x]);
+                        out[x] = d > tolerance ? Color{(uint8_t)(128 + d / 2), 0, 0} : faded(a[x]);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+}
@@ -0,0 +1,38 @@
+//! @file ImageDiff.hpp
+#ifndef __svg_ImageDiff_hpp__
+#define __svg_ImageDiff_hpp__
+
+#include "PNGImage.hpp"
+#include "Point.hpp"
+
+#include <cstddef>
+
+namespace svg
+{
+    //! Result of diffImages().
+    struct DiffResult
+    {
+        //! Whether both images have the same size (nothing else is set otherwise).
+        bool same_size = false;
+        //! Number of pixels with a channel differing by more than the tolerance.
+        size_t pixels = 0;
+        //! Box enclosing those pixels (empty if none).
+        Box box;
+        //! First of those pixels, in row order (only valid if pixels > 0).
+        Point first = {0, 0};
+        //! Largest channel difference of those pixels (0 if none).
+        int max_difference = 0;
+    };
+
+    //! Compare two images, 16 pixels at a time with SSE2 where available.
+    //! @param expected Reference image.
+    //! @param actual Image to check.
+    //! @param tolerance Largest per-channel difference considered equal.
+    //! @param heatmap If not null, an image of the same size that receives a
+    //! faded copy of the reference, with differing pixels in red (brighter
+    //! for larger differences).
+    //! @return Count and location of the differing pixels.
+    DiffResult diffImages(const PNGImage &expected, const PNGImage &actual, int tolerance = 0,
+                          PNGImage *heatmap = nullptr);
+}
+#endif
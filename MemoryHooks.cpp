@@ -0,0 +1,103 @@
+//! @file MemoryHooks.cpp
+// Not part of libproj.a: only the programs that report memory statistics
+// (svgtopng and svgbench) link this file, so that embedders of the library
+// keep their own global allocation functions.
+#include "MemoryStats.hpp"
+
+#include <new>
+
+namespace
+{
+    /**
+     * @brief Allocates memory for operator new, throwing if there is none.
+     */
+    void *allocate(std::size_t size)
+    {
+        void *p = svg::trackedMalloc(size != 0 ? size : 1);
+        while (p == nullptr)
+        {
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            handler();
+            p = svg::trackedMalloc(size != 0 ? size : 1);
+        }
+        return p;
+    }
+
+    /**
+     * @brief Frees memory from allocate().
+     */
+    void deallocate(void *p) noexcept
+    {
+        svg::trackedFree(p);
+    }
+}
+
+// Replacements of the global allocation functions. They only add counting
+// to malloc and free while the calling thread tracks its allocations.
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
@@ -0,0 +1,158 @@
+//! @file MemoryStats.cpp
+#include "MemoryStats.hpp"
+
+#include <cstdlib>
+#include <malloc.h>
+#include <sys/resource.h>
+
+namespace svg
+{
+    namespace
+    {
+        // Per-thread state, constant-initialized so that the allocation
+        // functions can use it before any constructor runs.
+        thread_local bool tracking = false;
+        thread_local MemoryPhase phase = MemoryPhase::Other;
+        //! Bytes allocated minus bytes freed since tracking started.
+        thread_local int64_t live = 0;
+        //! Live bytes when the current phase began.
+        thread_local int64_t phase_base = 0;
+        thread_local int64_t peak = 0;
+        thread_local PhaseMemory counters[MEMORY_PHASES];
+
+        /**
+         * @brief Raises the peak of a phase to the current live bytes.
+         */
+        void updatePeak(MemoryPhase p, int64_t base)
+        {
+            PhaseMemory &c = counters[(size_t)p];
+            if (live - base > (int64_t)c.peak_bytes)
+            {
+                c.peak_bytes = (uint64_t)(live - base);
+            }
+        }
+
+        /**
+         * @brief Counts a new block of memory.
+         */
+        void noteAllocation(void *p)
+        {
+            if (!tracking || p == nullptr)
+            {
+                return;
+            }
+            size_t size = ::malloc_usable_size(p);
+            PhaseMemory &c = counters[(size_t)phase];
+            c.allocations++;
+            c.bytes += size;
+            live += (int64_t)size;
+            updatePeak(phase, phase_base);
+            if (live > peak)
+            {
+                peak = live;
+            }
+        }
+
+        /**
+         * @brief Counts a block of memory about to be freed.
+         */
+        void noteDeallocation(void *p)
+        {
+            if (tracking && p != nullptr)
+            {
+                live -= (int64_t)::malloc_usable_size(p);
+            }
+        }
+    }
+
+    const char *memoryPhaseName(MemoryPhase p)
+    {
+        static const char *const names[MEMORY_PHASES] = {
+            "other", "xml", "elements", "use copies", "optimize", "canvas", "draw", "encode"};
+        return names[(size_t)p];
+    }
+
+    void startMemoryTracking()
+    {
+        for (PhaseMemory &c : counters)
+        {
+            c = PhaseMemory();
+        }
+        phase = MemoryPhase::Other;
+        live = phase_base = peak = 0;
+        tracking = true;
+    }
+
+    MemoryStats stopMemoryTracking()
+    {
+        tracking = false;
+        MemoryStats stats;
+        for (size_t i = 0; i < MEMORY_PHASES; i++)
+        {
+            stats.phases[i] = counters[i];
+        }
+        stats.peak_bytes = (uint64_t)peak;
+        stats.peak_rss = peakRSS();
+        return stats;
+    }
+
+    bool memoryTracking()
+    {
+        return tracking;
+    }
+
+    uint64_t peakRSS()
+    {
+        struct rusage usage;
+        if (::getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+        return (uint64_t)usage.ru_maxrss * 1024; // Kilobytes on Linux.
+    }
+
+    MemoryPhaseScope::MemoryPhaseScope(MemoryPhase p)
+        : previous_(phase), previous_base_(phase_base)
+    {
+        phase = p;
+        phase_base = live;
+    }
+
+    MemoryPhaseScope::~MemoryPhaseScope()
+    {
+        // Memory still held by the inner phase counts for the enclosing one.
+        updatePeak(previous_, previous_base_);
+        phase = previous_;
+        phase_base = previous_base_;
+    }
+
+    void *trackedMalloc(size_t size)
+    {
+        void *p = std::malloc(size);
+        noteAllocation(p);
+        return p;
+    }
+
+    void *trackedRealloc(void *p, size_t size)
+    {
+        if (!tracking)
+        {
+            return std::realloc(p, size);
+        }
+        // Count a move to a new block as a new allocation.
+        size_t before = p != nullptr ? ::malloc_usable_size(p) : 0;
+        void *q = std::realloc(p, size);
+        if (q != nullptr)
+        {
+            live -= (int64_t)before;
+            noteAllocation(q);
+        }
+        return q;
+    }
+
+    void trackedFree(void *p)
+    {
+        noteDeallocation(p);
+        std::free(p);
+    }
+}
@@ -0,0 +1,94 @@
+//! @file MemoryStats.hpp
+#ifndef __svg_MemoryStats_hpp__
+#define __svg_MemoryStats_hpp__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace svg
+{
+    //! Conversion phases whose allocations are counted separately.
+    enum class MemoryPhase
+    {
+        Other,     // Anything outside the phases below.
+        Xml,       // Loading and parsing the XML document.
+        Elements,  // Building the element tree.
+        UseCopies, // Copying the elements referenced by <use>.
+        Optimize,  // Budgets, optimizeScene and simplification.
+        Canvas,    // Allocating the image.
+        Draw,      // Drawing (scratch buffers, span buffer).
+        Encode     // Compressing and writing the PNG file.
+    };
+    //! Number of MemoryPhase values.
+    const size_t MEMORY_PHASES = 8;
+
+    //! Get the name of a phase.
+    //! @param phase Phase.
+    //! @return Lower-case name.
+    const char *memoryPhaseName(MemoryPhase phase);
+
+    //! Allocations made during one phase.
+    struct PhaseMemory
+    {
+        //! Number of allocations.
+        uint64_t allocations = 0;
+        //! Bytes allocated (freed bytes are not subtracted).
+        uint64_t bytes = 0;
+        //! Largest growth of the live bytes since the phase began.
+        uint64_t peak_bytes = 0;
+    };
+
+    //! Allocations of the calling thread between startMemoryTracking() and
+    //! stopMemoryTracking(), through the PNG codec, and through operator new
+    //! in programs linked with MemoryHooks.o.
+    struct MemoryStats
+    {
+        //! Allocations of each phase, indexed by MemoryPhase.
+        PhaseMemory phases[MEMORY_PHASES];
+        //! Largest growth of the live bytes since tracking started.
+        uint64_t peak_bytes = 0;
+        //! Peak resident set size of the process (bytes).
+        uint64_t peak_rss = 0;
+    };
+
+    //! Start counting the allocations of the calling thread, from zero.
+    //! Counting costs a few operations per allocation; when it is off the
+    //! allocation functions only check a thread-local flag.
+    void startMemoryTracking();
+    //! Stop counting the allocations of the calling thread.
+    //! @return Counters since startMemoryTracking().
+    MemoryStats stopMemoryTracking();
+    //! Check if the allocations of the calling thread are counted.
+    //! @return True between startMemoryTracking() and stopMemoryTracking().
+    bool memoryTracking();
+    //! Get the peak resident set size of the process.
+    //! @return Bytes.
+    uint64_t peakRSS();
+
+    //! Attributes the allocations of the calling thread to a phase while in scope.
+    class MemoryPhaseScope
+    {
+    public:
+        //! Constructor.
+        //! @param phase Phase entered.
+        explicit MemoryPhaseScope(MemoryPhase phase);
+        //! Destructor: returns to the enclosing phase.
+        ~MemoryPhaseScope();
+        MemoryPhaseScope(const MemoryPhaseScope &) = delete;
+        MemoryPhaseScope &operator=(const MemoryPhaseScope &) = delete;
+
+    private:
+        //! Enclosing phase.
+        MemoryPhase previous_;
+        //! Live bytes when the enclosing phase began.
+        int64_t previous_base_;
+    };
+
+    //! malloc() counted like operator new (for C code such as the PNG codec).
+    void *trackedMalloc(size_t size);
+    //! realloc() counted like operator new.
+    void *trackedRealloc(void *p, size_t size);
+    //! free() for memory from trackedMalloc() or trackedRealloc().
+    void trackedFree(void *p);
+}
+#endif
@@ -1,11 +1,21 @@
 #include "PNGImage.hpp"
+#include "MemoryStats.hpp"
 
 #include <stdexcept>
 #include <cmath>
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <new>
+#include <cstdint>
 
+// Route the codec's memory through the allocation counters.
+#define STBI_MALLOC(sz) svg::trackedMalloc(sz)
+#define STBI_REALLOC(p, newsz) svg::trackedRealloc(p, newsz)
+#define STBI_FREE(p) svg::trackedFree(p)
+#define STBIW_MALLOC(sz) svg::trackedMalloc(sz)
+#define STBIW_REALLOC(p, newsz) svg::trackedRealloc(p, newsz)
+#define STBIW_FREE(p) svg::trackedFree(p)
 #define STBI_ONLY_PNG
 #define STB_IMAGE_IMPLEMENTATION
 #include "external/stb/stb_image.h"
@@ -14,7 +24,18 @@
 
 namespace svg
 {
+    struct PNGImage::Edge
+    {
+        //! Top end point (pixel space).
+        double x0, y0;
+        //! Bottom end point (pixel space).
+        double x1, y1;
+        //! Winding direction (+1 downwards, -1 upwards).
+        float dir;
+    };
+
     PNGImage::PNGImage(const std::string &png_file_name)
+        : owned_(true), antialias_(false), spans_(nullptr), cancel_(nullptr)
     {
         int dummy;
         pixels_ = (Color *)::stbi_load(png_file_name.c_str(),
@@ -24,15 +45,71 @@ namespace svg
         {
             throw std::runtime_error(png_file_name + ": could not load image!");
         }
+        stride_ = width_ * (int)sizeof(Color);
+        set_clip(Box());
     }
-    PNGImage::PNGImage(int w, int h)
+    PNGImage::PNGImage(int w, int h, bool blank)
+        : owned_(true), antialias_(false), spans_(nullptr), cancel_(nullptr)
     {
-        assert(w > 0 && h > 0);
-        size_t sz = w * h * sizeof(Color);
+        if (w <= 0 || h <= 0)
+        {
+            throw std::invalid_argument("Invalid image size");
+        }
+        size_t sz = (size_t)w * h * sizeof(Color);
         pixels_ = (Color *)::stbi__malloc(sz);
+        if (pixels_ == nullptr)
+        {
+            throw std::bad_alloc();
+        }
         width_ = w;
         height_ = h;
-        ::memset(pixels_, 0xFF, sz);
+        stride_ = w * (int)sizeof(Color);
+        set_clip(Box());
+        if (blank)
+        {
+            ::memset(pixels_, 0xFF, sz);
+        }
+    }
+    PNGImage::PNGImage(Color *pixels, int w, int h, int stride)
+        : width_(w), height_(h), stride_(stride), pixels_(pixels),
+          owned_(false), antialias_(false), spans_(nullptr), cancel_(nullptr)
+    {
+        assert(pixels != nullptr && w > 0 && h > 0);
+        assert(stride >= w * (int)sizeof(Color));
+        set_clip(Box());
+    }
+    PNGImage::PNGImage(PNGImage &&other) noexcept
+        : width_(other.width_), height_(other.height_), stride_(other.stride_),
+          pixels_(other.pixels_), owned_(other.owned_), antialias_(other.antialias_),
+          coverage_(std::move(other.coverage_)), spans_(other.spans_), cancel_(other.cancel_), clip_(other.clip_)
+    {
+        other.pixels_ = nullptr;
+        other.owned_ = false;
+        other.width_ = other.height_ = other.stride_ = 0;
+    }
+    PNGImage &PNGImage::operator=(PNGImage &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (owned_)
+            {
+                stbi_image_free(pixels_);
+            }
+            width_ = other.width_;
+            height_ = other.height_;
+            stride_ = other.stride_;
+            pixels_ = other.pixels_;
+            owned_ = other.owned_;
+            antialias_ = other.antialias_;
+            coverage_ = std::move(other.coverage_);
+            spans_ = other.spans_;
+            cancel_ = other.cancel_;
+            clip_ = other.clip_;
+            other.pixels_ = nullptr;
+            other.owned_ = false;
+            other.width_ = other.height_ = other.stride_ = 0;
+        }
+        return *this;
     }
     void PNGImage::save(const std::string &png_file_name) const
     {
@@ -41,12 +118,24 @@ namespace svg
                          height_,
                          3,
                          pixels_,
-                         width_ * 3);
+                         stride_);
+    }
+
+    std::string PNGImage::encode() const
+    {
+        std::string png;
+        ::stbi_write_png_to_func([](void *context, void *data, int size)
+                                 { ((std::string *)context)->append((const char *)data, (size_t)size); },
+                                 &png, width_, height_, 3, pixels_, stride_);
+        return png;
     }
 
     PNGImage::~PNGImage()
     {
-        stbi_image_free(pixels_);
+        if (owned_)
+        {
+            stbi_image_free(pixels_);
+        }
     }
 
     int PNGImage::width() const
@@ -57,20 +146,52 @@ namespace svg
     {
         return height_;
     }
+    int PNGImage::stride() const
+    {
+        return stride_;
+    }
+    bool PNGImage::owns_pixels() const
+    {
+        return owned_;
+    }
+    Color *PNGImage::row(int y)
+    {
+        return (Color *)((unsigned char *)pixels_ + (size_t)y * stride_);
+    }
+    const Color *PNGImage::row(int y) const
+    {
+        return (const Color *)((const unsigned char *)pixels_ + (size_t)y * stride_);
+    }
     Color &PNGImage::at(int x, int y)
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return row(y)[x];
     }
     Color PNGImage::at(int x, int y) const
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return row(y)[x];
+    }
+    void PNGImage::clear(const Color &c)
+    {
+        for (int y = 0; y < height_; y++)
+        {
+            Color *r = row(y);
+            if (c.red == c.green && c.green == c.blue)
+            {
+                ::memset(r, c.red, (size_t)width_ * sizeof(Color));
+            }
+            else
+            {
+                std::fill(r, r + width_, c);
+            }
+        }
     }
     void PNGImage::draw_line(const Point &a, const Point &b, const Color &c)
     {
+        checkCancelled(cancel_);
         //  Bresenham Algorithm.
         int x_from = a.x;
         int y_from = a.y;
@@ -91,7 +212,7 @@ namespace svg
         }
         dy *= 2;
         dx *= 2;
-        at(x_from, y_from) = c;
+        plot(x_from, y_from, c);
         if (dx > dy)
         {
             int fraction = dy - (dx / 2);
@@ -104,7 +225,7 @@ namespace svg
                 }
                 x_from += step_x;
                 fraction += dy;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, c);
             }
         }
         else
@@ -119,93 +240,658 @@ namespace svg
                 }
                 y_from += step_y;
                 fraction += dx;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, c);
+            }
+        }
+    }
+
+    void PNGImage::draw_polygon(const PointVector &points, const Color &c, FillRule rule)
+    {
+        draw_polygon(points.data(), points.size(), c, rule);
+    }
+
+    void PNGImage::draw_polygon(const Point *points, size_t n, const Color &c, FillRule rule)
+    {
+        if (!antialias_ && rule == FillRule::EvenOdd)
+        {
+            fill_crossing_pairs(points, n, c);
+            return;
+        }
+        PointSpan contour = {points, n};
+        fill_contours(&contour, 1, c, rule);
+    }
+
+    void PNGImage::draw_polygon(const std::vector<PointVector> &contours, const Color &c, FillRule rule)
+    {
+        contours_.clear();
+        for (const PointVector &points : contours)
+        {
+            contours_.push_back({points.data(), points.size()});
+        }
+        fill_contours(contours_.data(), contours_.size(), c, rule);
+    }
+
+    void PNGImage::draw_polygon(const PointSpan *contours, size_t count, const Color &c, FillRule rule)
+    {
+        fill_contours(contours, count, c, rule);
+    }
+
+    void PNGImage::draw_convex_polygon(const PointVector &points, const Color &c)
+    {
+        draw_convex_polygon(points.data(), points.size(), c);
+    }
+
+    void PNGImage::draw_convex_polygon(const Point *points, size_t n, const Color &c)
+    {
+        if (antialias_ || n < 3)
+        {
+            draw_polygon(points, n, c);
+            return;
+        }
+        size_t top = 0;
+        int y_top = points[0].y, y_bottom = points[0].y;
+        for (size_t i = 1; i < n; i++)
+        {
+            if (points[i].y < y_top)
+            {
+                top = i;
+                y_top = points[i].y;
+            }
+            y_bottom = std::max(y_bottom, points[i].y);
+        }
+
+        // Walk down both chains from the top vertex. Each chain is monotone
+        // in y, so every row meets exactly one edge of each chain, and the
+        // span between them is the one the even-odd scanline would find.
+        // Edges keep their polygon orientation so the intersections are
+        // computed exactly as in fill_contours.
+        size_t fwd = top, bwd = top;
+        for (int y = std::max(y_top, 0); y < std::min(y_bottom, height()); y++)
+        {
+            checkCancelled(cancel_);
+            size_t next = (fwd + 1) % n;
+            while (points[next].y < y || points[next].y == points[fwd].y)
+            {
+                fwd = next;
+                next = (fwd + 1) % n;
+            }
+            size_t prev = (bwd + n - 1) % n;
+            while (points[prev].y < y || points[prev].y == points[bwd].y)
+            {
+                bwd = prev;
+                prev = (bwd + n - 1) % n;
+            }
+            Point a = points[fwd], b = points[next];
+            double x_fwd = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
+            a = points[prev];
+            b = points[bwd];
+            double x_bwd = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
+            int x0 = (int)round(std::min(x_fwd, x_bwd));
+            int x1 = (int)round(std::max(x_fwd, x_bwd));
+            if (x0 != x1)
+            {
+                fill_span(y, x0, x1, c);
             }
         }
+        for (size_t i = 0; i < n; i++)
+        {
+            draw_line(points[i], points[(i + 1) % n], c);
+        }
+    }
+
+    void PNGImage::draw_rect(const Point &a, const Point &b, const Color &c)
+    {
+        if (antialias_)
+        {
+            Point corners[4] = {a, {b.x, a.y}, b, {a.x, b.y}};
+            draw_polygon(corners, 4, c);
+            return;
+        }
+        int y0 = std::max(std::min(a.y, b.y), 0);
+        int y1 = std::min(std::max(a.y, b.y), height() - 1);
+        for (int y = y0; y <= y1; y++)
+        {
+            fill_span(y, std::min(a.x, b.x), std::max(a.x, b.x), c);
+        }
     }
 
-    void PNGImage::draw_polygon(const std::vector<Point> &points, const Color &c)
+    void PNGImage::fill_contours(const PointSpan *contours, size_t count, const Color &c, FillRule rule)
     {
+        if (antialias_)
+        {
+            // Integer coordinates refer to pixel centers.
+            std::vector<Edge> edges;
+            for (size_t k = 0; k < count; k++)
+            {
+                const Point *points = contours[k].data;
+                size_t n = contours[k].size;
+                for (size_t i = 0; i < n; i++)
+                {
+                    Point a = points[i];
+                    Point b = points[(i + 1) % n];
+                    if (a.y == b.y)
+                    {
+                        continue;
+                    }
+                    if (a.y < b.y)
+                    {
+                        edges.push_back({a.x + 0.5, a.y + 0.5, b.x + 0.5, b.y + 0.5, 1.0f});
+                    }
+                    else
+                    {
+                        edges.push_back({b.x + 0.5, b.y + 0.5, a.x + 0.5, a.y + 0.5, -1.0f});
+                    }
+                }
+            }
+            fill_coverage(edges, c, rule);
+            return;
+        }
         int x_min = width(), x_max = 0, y_min = height(), y_max = 0;
-        for (const Point &p : points)
+        for (size_t k = 0; k < count; k++)
+        {
+            for (size_t i = 0; i < contours[k].size; i++)
+            {
+                const Point &p = contours[k].data[i];
+                x_min = std::min(x_min, p.x);
+                x_max = std::max(x_max, p.x);
+                y_min = std::min(y_min, p.y);
+                y_max = std::max(y_max, p.y);
+            }
+        }
+
+        // Each edge covers the rows from its top end up to, but excluding,
+        // its bottom end, so a vertex shared by two edges is crossed once.
+        std::vector<Crossing> &crossings = intersections_;
+        for (int y = y_min; y < y_max; y++)
         {
-            x_min = std::min(x_min, p.x);
-            x_max = std::max(x_max, p.x);
-            y_min = std::min(y_min, p.y);
-            y_max = std::max(y_max, p.y);
+            checkCancelled(cancel_);
+            for (size_t k = 0; k < count; k++)
+            {
+                const Point *points = contours[k].data;
+                size_t n = contours[k].size;
+                for (size_t i = 0; i < n; i++)
+                {
+                    Point a = points[i];
+                    Point b = points[(i + 1) % n];
+                    if (y < std::min(a.y, b.y) || y >= std::max(a.y, b.y))
+                    {
+                        continue;
+                    }
+                    double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
+                    crossings.push_back({x_inters, a.y < b.y ? 1 : -1});
+                }
+            }
+            std::sort(crossings.begin(), crossings.end(),
+                      [](const Crossing &a, const Crossing &b)
+                      { return a.x < b.x; });
+            int winding = 0;
+            double start = 0;
+            for (const Crossing &crossing : crossings)
+            {
+                bool was_inside = rule == FillRule::NonZero ? winding != 0 : winding % 2 != 0;
+                winding += crossing.dir;
+                bool inside = rule == FillRule::NonZero ? winding != 0 : winding % 2 != 0;
+                if (!was_inside && inside)
+                {
+                    start = crossing.x;
+                }
+                else if (was_inside && !inside)
+                {
+                    int x0 = (int)round(start);
+                    int x1 = (int)round(crossing.x);
+                    if (x0 != x1)
+                    {
+                        fill_span(y, x0, x1, c);
+                    }
+                }
+            }
+            crossings.clear();
         }
+        for (size_t k = 0; k < count; k++)
+        {
+            const Point *points = contours[k].data;
+            size_t n = contours[k].size;
+            for (size_t i = 0; i < n; i++)
+            {
+                draw_line(points[i], points[(i + 1) % n], c);
+            }
+        }
+    }
 
-        std::vector<double> seg;
+    void PNGImage::fill_crossing_pairs(const Point *points, size_t n, const Color &c)
+    {
+        int y_min = height(), y_max = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            y_min = std::min(y_min, points[i].y);
+            y_max = std::max(y_max, points[i].y);
+        }
+
+        std::vector<Crossing> &crossings = intersections_;
         for (int y = y_min; y < y_max; y++)
         {
-            for (size_t i = 0; i < points.size(); i++)
+            checkCancelled(cancel_);
+            for (size_t i = 0; i < n; i++)
             {
                 Point a = points[i];
-                Point b = points[(i + 1) % points.size()];
-                if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y))
+                Point b = points[(i + 1) % n];
+                if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y) || a.y == b.y)
                 {
                     continue;
                 }
-                if (a.y != b.y)
-                {
-                    double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
-                    seg.push_back(x_inters);
-                }
+                double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
+                crossings.push_back({x_inters, 0});
             }
-            std::sort(seg.begin(), seg.end());
-            size_t i_s = 0;
-            while ((i_s + 1) < seg.size())
+            std::sort(crossings.begin(), crossings.end(),
+                      [](const Crossing &a, const Crossing &b)
+                      { return a.x < b.x; });
+            // A crossing that rounds to the same column as the next one is
+            // dropped, so the pairs after it shift by one.
+            size_t i = 0;
+            while (i + 1 < crossings.size())
             {
-                Point a = {(int)round(seg.at(i_s)), y};
-                Point b = {(int)round(seg.at(i_s + 1)), y};
-                if (a.x == b.x)
+                int x0 = (int)round(crossings[i].x);
+                int x1 = (int)round(crossings[i + 1].x);
+                if (x0 == x1)
                 {
-                    i_s++;
+                    i++;
                 }
                 else
                 {
-                    draw_line(a, b, c);
-                    i_s += 2;
+                    fill_span(y, x0, x1, c);
+                    i += 2;
                 }
             }
-            seg.clear();
+            crossings.clear();
         }
-        for (size_t i = 0; i < points.size(); i++)
+        for (size_t i = 0; i < n; i++)
         {
-            draw_line(points[i], points[(i + 1) % points.size()], c);
+            draw_line(points[i], points[(i + 1) % n], c);
         }
     }
 
-    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill)
+    void PNGImage::plot(int x, int y, const Color &c)
     {
-        draw_line(center.translate({-radius.x, 0}),
-                  center.translate({+radius.x, 0}),
-                  fill);
-        int x0 = radius.x;
-        int dx = 0;
-        for (int y = 1; y <= radius.y; y++)
+        if (clip_.contains({x, y}))
         {
-            double vy = (double)y / (double)radius.y;
+            if (spans_ != nullptr)
+            {
+                spans_->add(y, x, x, c);
+                return;
+            }
+            row(y)[x] = c;
+        }
+    }
+
+    void PNGImage::fill_span(int y, int x0, int x1, const Color &c)
+    {
+        if (y < clip_.min.y || y > clip_.max.y)
+        {
+            return;
+        }
+        x0 = std::max(x0, clip_.min.x);
+        x1 = std::min(x1, clip_.max.x);
+        if (spans_ != nullptr)
+        {
+            spans_->add(y, x0, x1, c);
+            return;
+        }
+        Color *pixel_row = row(y);
+        for (int x = x0; x <= x1; x++)
+        {
+            pixel_row[x] = c;
+        }
+    }
+
+    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill,
+                                int orientation)
+    {
+        int degrees = orientation % 180;
+        if (degrees < 0)
+        {
+            degrees += 180;
+        }
+        Point r = radius;
+        if (degrees == 90)
+        {
+            // A quarter turn just swaps the axes.
+            std::swap(r.x, r.y);
+            degrees = 0;
+        }
+        if (antialias_)
+        {
+            // Flatten to a polygon whose chords deviate at most
+            // 1/10 of a pixel from the true outline.
+            double rmax = std::max(r.x, r.y);
+            if (rmax <= 0)
+            {
+                return;
+            }
+            int n = 8;
+            if (rmax > 0.1)
+            {
+                n = std::max(n, (int)std::ceil(M_PI / std::acos(1.0 - 0.1 / rmax)));
+            }
+            double cx = center.x + 0.5, cy = center.y + 0.5;
+            double s = std::sin(M_PI * degrees / 180.0);
+            double c = std::cos(M_PI * degrees / 180.0);
+            std::vector<Edge> edges;
+            double px = cx + c * r.x, py = cy + s * r.x;
+            for (int i = 1; i <= n; i++)
+            {
+                double angle = 2.0 * M_PI * i / n;
+                double u = r.x * std::cos(angle);
+                double v = r.y * std::sin(angle);
+                double qx = cx + c * u - s * v;
+                double qy = cy + s * u + c * v;
+                if (py < qy)
+                {
+                    edges.push_back({px, py, qx, qy, 1.0f});
+                }
+                else if (py > qy)
+                {
+                    edges.push_back({qx, qy, px, py, -1.0f});
+                }
+                px = qx;
+                py = qy;
+            }
+            fill_coverage(edges, fill, FillRule::NonZero);
+            return;
+        }
+        if (degrees != 0)
+        {
+            fill_rotated_ellipse(center, r, M_PI * degrees / 180.0, fill);
+            return;
+        }
+
+        // Midpoint-style scan conversion: the half-width x of row y is the
+        // largest x with x^2 ry^2 + y^2 rx^2 <= rx^2 ry^2. It never grows
+        // with y, so it is found incrementally with integer arithmetic.
+        fill_span(center.y, center.x - r.x, center.x + r.x, fill);
+        int64_t a2 = (int64_t)r.x * r.x;
+        int64_t b2 = (int64_t)r.y * r.y;
+        bool exact = r.x < 46341 && r.y < 46341;
+        int64_t ab = exact ? a2 * b2 : 0;
+        int x = r.x;
+        for (int y = 1; y <= r.y; y++)
+        {
+            checkCancelled(cancel_);
+            double vy = (double)y / (double)r.y;
             vy *= vy;
-            int x1 = x0 - (dx - 1);
-            for (; x1 > 0; x1--)
+            if (!exact)
+            {
+                // Too large for 64-bit integers: estimate, then refine below.
+                x = std::min(x, (int)(r.x * std::sqrt(std::max(0.0, 1 - vy))) + 1);
+            }
+            int64_t yy = (int64_t)y * y * a2;
+            for (; x > 0; x--)
             {
-                double vx = (double)x1 / (double)radius.x;
-                vx *= vx;
-                if (vx + vy <= 1)
+                if (exact)
+                {
+                    int64_t e = (int64_t)x * x * b2 + yy;
+                    if (e < ab)
+                    {
+                        break;
+                    }
+                    if (e > ab)
+                    {
+                        continue;
+                    }
+                }
+                // On the boundary: keep the floating-point rounding of
+                // the reference implementation.
+                double vx = (double)x / (double)r.x;
+                if (vx * vx + vy <= 1)
                 {
                     break;
                 }
             }
-            dx = x0 - x1;
-            x0 = x1;
-            draw_line(center.translate({-x0, -y}),
-                      center.translate({+x0, -y}),
-                      fill);
-            draw_line(center.translate({-x0, +y}),
-                      center.translate({+x0, +y}),
-                      fill);
+            fill_span(center.y - y, center.x - x, center.x + x, fill);
+            fill_span(center.y + y, center.x - x, center.x + x, fill);
+        }
+    }
+
+    void PNGImage::fill_rotated_ellipse(const Point &center, const Point &radius,
+                                        double angle, const Color &fill)
+    {
+        // Implicit form A x^2 + B x y + C y^2 <= F relative to the center.
+        double a2 = (double)radius.x * radius.x;
+        double b2 = (double)radius.y * radius.y;
+        double s = std::sin(angle), c = std::cos(angle);
+        double A = b2 * c * c + a2 * s * s;
+        double B = 2 * s * c * (b2 - a2);
+        double C = b2 * s * s + a2 * c * c;
+        double F = a2 * b2;
+        if (A <= 0 || F <= 0)
+        {
+            fill_span(center.y, center.x, center.x, fill);
+            return;
+        }
+        int y_extent = (int)std::floor(std::sqrt(4 * A * F / (4 * A * C - B * B)));
+        int y_from = std::max(-y_extent, -center.y);
+        int y_to = std::min(y_extent, height_ - 1 - center.y);
+        for (int y = y_from; y <= y_to; y++)
+        {
+            checkCancelled(cancel_);
+            // Solve A x^2 + (B y) x + (C y^2 - F) <= 0 for x.
+            double b = B * y;
+            double disc = b * b - 4 * A * (C * y * y - F);
+            if (disc < 0)
+            {
+                continue;
+            }
+            double root = std::sqrt(disc);
+            int x0 = (int)std::ceil((-b - root) / (2 * A));
+            int x1 = (int)std::floor((-b + root) / (2 * A));
+            if (x0 <= x1)
+            {
+                fill_span(center.y + y, center.x + x0, center.x + x1, fill);
+            }
         }
     }
 
+    void PNGImage::set_antialiasing(bool on)
+    {
+        antialias_ = on;
+    }
+
+    bool PNGImage::antialiasing() const
+    {
+        return antialias_;
+    }
+
+    void PNGImage::set_span_buffer(SpanBuffer *spans)
+    {
+        assert(spans == nullptr || (spans->width() == width_ && spans->height() == height_));
+        spans_ = spans;
+    }
+
+    void PNGImage::set_cancellation(const CancellationToken *cancel)
+    {
+        cancel_ = cancel;
+    }
+
+    void PNGImage::set_clip(const Box &box)
+    {
+        Box image{{0, 0}, {width_ - 1, height_ - 1}};
+        if (box.empty())
+        {
+            clip_ = image;
+            return;
+        }
+        clip_.min = {std::max(box.min.x, 0), std::max(box.min.y, 0)};
+        clip_.max = {std::min(box.max.x, image.max.x), std::min(box.max.y, image.max.y)};
+    }
+
+    void PNGImage::accumulate(double xa, double ya, double xb, double yb,
+                              int &x_lo, int &x_hi)
+    {
+        // Signed-area accumulation: each segment deposits, in the cells it
+        // crosses, the change of coverage it causes for all pixels to its
+        // right. A prefix sum over the row then yields the exact coverage.
+        double lo = std::min(xa, xb), hi = std::max(xa, xb);
+        if (lo < 0 && hi > 0)
+        {
+            double ym = ya + (yb - ya) * (0 - xa) / (xb - xa);
+            accumulate(xa, ya, 0, ym, x_lo, x_hi);
+            accumulate(0, ym, xb, yb, x_lo, x_hi);
+            return;
+        }
+        if (lo < width_ && hi > width_)
+        {
+            double ym = ya + (yb - ya) * (width_ - xa) / (xb - xa);
+            accumulate(xa, ya, width_, ym, x_lo, x_hi);
+            accumulate(width_, ym, xb, yb, x_lo, x_hi);
+            return;
+        }
+        float d = (float)(yb - ya);
+        if (hi <= 0 || lo >= width_)
+        {
+            // Outside the image: only the net effect matters.
+            int x = hi <= 0 ? 0 : width_;
+            coverage_[x] += d;
+            x_lo = std::min(x_lo, x);
+            x_hi = std::max(x_hi, x);
+            return;
+        }
+        float *acc = coverage_.data();
+        double x0_floor = std::floor(lo);
+        int x0i = (int)x0_floor;
+        int x1i = (int)std::ceil(hi);
+        x_lo = std::min(x_lo, x0i);
+        if (x1i <= x0i + 1)
+        {
+            // The segment stays within one pixel column.
+            float xmf = (float)(0.5 * (xa + xb) - x0_floor);
+            acc[x0i] += d - d * xmf;
+            acc[x0i + 1] += d * xmf;
+            x_hi = std::max(x_hi, x0i + 1);
+            return;
+        }
+        float s = (float)(1.0 / (hi - lo));
+        float x0f = (float)(lo - x0_floor);
+        float a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+        float x1f = (float)(hi - x1i + 1);
+        float am = 0.5f * s * x1f * x1f;
+        acc[x0i] += d * a0;
+        if (x1i == x0i + 2)
+        {
+            acc[x0i + 1] += d * (1.0f - a0 - am);
+        }
+        else
+        {
+            float a1 = s * (1.5f - x0f);
+            acc[x0i + 1] += d * (a1 - a0);
+            for (int x = x0i + 2; x < x1i - 1; x++)
+            {
+                acc[x] += d * s;
+            }
+            float a2 = a1 + (float)(x1i - x0i - 3) * s;
+            acc[x1i - 1] += d * (1.0f - a2 - am);
+        }
+        acc[x1i] += d * am;
+        x_hi = std::max(x_hi, x1i);
+    }
+
+    void PNGImage::fill_coverage(std::vector<Edge> &edges, const Color &fill, FillRule rule)
+    {
+        assert(spans_ == nullptr);
+        if (edges.empty())
+        {
+            return;
+        }
+        std::sort(edges.begin(), edges.end(),
+                  [](const Edge &a, const Edge &b)
+                  { return a.y0 < b.y0; });
+        double y_max = edges.front().y1;
+        for (const Edge &e : edges)
+        {
+            y_max = std::max(y_max, e.y1);
+        }
+        int row_begin = std::max(0, (int)std::floor(edges.front().y0));
+        int row_end = std::min(height_, (int)std::ceil(y_max));
+        coverage_.assign(width_ + 2, 0.0f);
+
+        std::vector<const Edge *> active;
+        size_t next = 0;
+        for (int y = row_begin; y < row_end; y++)
+        {
+            checkCancelled(cancel_);
+            double top = y, bottom = y + 1;
+            // Update the active edge list for this row.
+            size_t kept = 0;
+            for (size_t i = 0; i < active.size(); i++)
+            {
+                if (active[i]->y1 > top)
+                {
+                    active[kept++] = active[i];
+                }
+            }
+            active.resize(kept);
+            while (next < edges.size() && edges[next].y0 < bottom)
+            {
+                if (edges[next].y1 > top)
+                {
+                    active.push_back(&edges[next]);
+                }
+                next++;
+            }
+            if (active.empty())
+            {
+                continue;
+            }
+
+            int x_lo = width_ + 1, x_hi = -1;
+            for (const Edge *e : active)
+            {
+                double ya = std::max(e->y0, top);
+                double yb = std::min(e->y1, bottom);
+                double dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
+                double xa = e->x0 + (ya - e->y0) * dxdy;
+                double xb = e->x0 + (yb - e->y0) * dxdy;
+                if (e->dir > 0)
+                {
+                    accumulate(xa, ya, xb, yb, x_lo, x_hi);
+                }
+                else
+                {
+                    accumulate(xb, yb, xa, ya, x_lo, x_hi);
+                }
+            }
+
+            // Resolve coverage and blend, clearing the buffer as we go.
+            float sum = 0;
+            Color *pixel_row = row(y);
+            bool visible = y >= clip_.min.y && y <= clip_.max.y;
+            for (int x = x_lo; x <= x_hi; x++)
+            {
+                sum += coverage_[x];
+                coverage_[x] = 0;
+                if (!visible || x < clip_.min.x || x > clip_.max.x)
+                {
+                    continue;
+                }
+                // The sum is the winding number weighted by coverage; even-odd
+                // folds it back into [0, 1] with a period of two windings.
+                float area = rule == FillRule::NonZero ? std::min(1.0f, std::fabs(sum))
+                                                       : std::fabs(sum - 2.0f * std::nearbyint(sum * 0.5f));
+                int alpha = (int)(area * 255.0f + 0.5f);
+                if (alpha == 0)
+                {
+                    continue;
+                }
+                Color &p = pixel_row[x];
+                if (alpha == 255)
+                {
+                    p = fill;
+                }
+                else
+                {
+                    p.red = (rgb_value)((fill.red * alpha + p.red * (255 - alpha) + 127) / 255);
+                    p.green = (rgb_value)((fill.green * alpha + p.green * (255 - alpha) + 127) / 255);
+                    p.blue = (rgb_value)((fill.blue * alpha + p.blue * (255 - alpha) + 127) / 255);
+                }
+            }
+        }
+    }
 }
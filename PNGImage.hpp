@@ -2,14 +2,29 @@
 #ifndef __svg_png_image_hpp__
 #define __svg_png_image_hpp__
 
+#include "Cancellation.hpp"
 #include "Color.hpp"
 #include "Point.hpp"
+#include "PointVector.hpp"
+#include "SpanBuffer.hpp"
 
 #include <string>
 #include <vector>
 
 namespace svg
 {
+    //! Rule deciding which parts of a shape are inside when its contours
+    //! overlap or cross themselves.
+    enum class FillRule
+    {
+        //! Inside where the contours wind around the point a nonzero number
+        //! of times (the SVG default).
+        NonZero,
+        //! Inside where a ray from the point crosses the contours an odd
+        //! number of times.
+        EvenOdd
+    };
+
     //! PNG image.
     class PNGImage
     {
@@ -19,9 +34,28 @@ namespace svg
         PNGImage(const std::string &png_file_name);
         //! Constructor of blank image.
         //! Initally, all pixels will be white.
+        //! @param w Image width (throws std::invalid_argument if not positive).
+        //! @param h Image height (throws std::invalid_argument if not positive).
+        //! @param blank If false, the pixels are left uninitialized (for
+        //! images that are entirely overwritten, e.g. by SpanBuffer::resolve).
+        PNGImage(int w, int h, bool blank = true);
+        //! Constructor of a view over caller-owned pixels.
+        //! The pixels are neither cleared nor freed by the image,
+        //! and must outlive it.
+        //! @param pixels First pixel of the first row.
         //! @param w Image width.
         //! @param h Image height.
-        PNGImage(int w, int h);
+        //! @param stride Distance in bytes between the start of consecutive rows.
+        PNGImage(Color *pixels, int w, int h, int stride);
+        //! Move constructor.
+        //! @param other Image whose pixels are taken over (left empty).
+        PNGImage(PNGImage &&other) noexcept;
+        //! Move assignment.
+        //! @param other Image whose pixels are taken over (left empty).
+        //! @return This image.
+        PNGImage &operator=(PNGImage &&other) noexcept;
+        PNGImage(const PNGImage &) = delete;
+        PNGImage &operator=(const PNGImage &) = delete;
         //! Destructor.
         ~PNGImage();
         //! Get image width.
@@ -30,6 +64,20 @@ namespace svg
         //! Get image height.
         //! @return The image height.
         int height() const;
+        //! Get the distance in bytes between consecutive rows.
+        //! @return The row stride.
+        int stride() const;
+        //! Check if the image owns its pixels (false for views).
+        //! @return True if the pixels are freed with the image.
+        bool owns_pixels() const;
+        //! Get a row of pixels.
+        //! @param y Row.
+        //! @return Pointer to the first pixel of the row.
+        Color *row(int y);
+        //! Get a row of pixels.
+        //! @param y Row.
+        //! @return Pointer to the first pixel of the row.
+        const Color *row(int y) const;
         //! Get mutable reference to image pixel.
         //! @param x X position
         //! @param y Y position.
@@ -40,9 +88,15 @@ namespace svg
         //! @param y Y position.
         //! @return Reference to pixel.
         Color at(int x, int y) const;
+        //! Set all pixels to the same color.
+        //! @param c Color to use (white by default).
+        void clear(const Color &c = Color{255, 255, 255});
         //! Save to output file.
         //! @param png_file_name Output file name.
         void save(const std::string &png_file_name) const;
+        //! Encode as a PNG file in memory.
+        //! @return Contents of the PNG file save() would write.
+        std::string encode() const;
         //! Draw a line defined by 2 points.
         //! @param a First point.
         //! @param b Second point.
@@ -51,21 +105,151 @@ namespace svg
         //! Draw a polygon.
         //! @param points Vector of points defining the polygon.
         //! @param fill Color to use for the polygon fill.
-        void draw_polygon(const std::vector<Point> &points, const Color &fill);
+        //! @param rule Fill rule (even-odd by default, as polygons have
+        //! always been filled).
+        void draw_polygon(const PointVector &points, const Color &fill,
+                          FillRule rule = FillRule::EvenOdd);
+        //! Draw a polygon.
+        //! @param points First point defining the polygon.
+        //! @param n Number of points.
+        //! @param fill Color to use for the polygon fill.
+        //! @param rule Fill rule (even-odd by default).
+        void draw_polygon(const Point *points, size_t n, const Color &fill,
+                          FillRule rule = FillRule::EvenOdd);
+        //! Draw a polygon made of several closed contours.
+        //! @param contours Vector of contours, each a vector of points.
+        //! @param fill Color to use for the polygon fill.
+        //! @param rule Fill rule.
+        void draw_polygon(const std::vector<PointVector> &contours, const Color &fill,
+                          FillRule rule = FillRule::NonZero);
+        //! Draw a polygon made of several closed contours.
+        //! @param contours First contour.
+        //! @param count Number of contours.
+        //! @param fill Color to use for the polygon fill.
+        //! @param rule Fill rule.
+        void draw_polygon(const PointSpan *contours, size_t count, const Color &fill,
+                          FillRule rule = FillRule::NonZero);
+        //! Draw a convex polygon.
+        //! Produces the same pixels as draw_polygon, without sorting
+        //! intersections. The result is undefined for non-convex polygons.
+        //! @param points Vector of points defining the polygon.
+        //! @param fill Color to use for the polygon fill.
+        void draw_convex_polygon(const PointVector &points, const Color &fill);
+        //! Draw a convex polygon (see above).
+        //! @param points First point defining the polygon.
+        //! @param n Number of points.
+        //! @param fill Color to use for the polygon fill.
+        void draw_convex_polygon(const Point *points, size_t n, const Color &fill);
+        //! Draw a rectangle with sides parallel to the image axes.
+        //! @param a One corner.
+        //! @param b Opposite corner (both corners are included).
+        //! @param fill Color to use for the rectangle fill.
+        void draw_rect(const Point &a, const Point &b, const Color &fill);
         //! Draw an ellipse.
         //! @param center Coordinates for the ellipse center.
         //! @param radius Radius in X and Y axis.
         //! @param fill Color to use for the ellipse fill.
-        //! @param orientation ellipse orientation.
-        void draw_ellipse(const Point &center, const Point &radius, const Color &fill);
+        //! @param orientation ellipse orientation (rotation in degrees).
+        void draw_ellipse(const Point &center, const Point &radius, const Color &fill,
+                          int orientation = 0);
+        //! Enable or disable anti-aliased rendering.
+        //! When enabled, polygons and ellipses are filled using the exact
+        //! area of each pixel they cover and blended with the existing
+        //! pixels. Aliased rendering is the default. Both modes apply the
+        //! same fill rule.
+        //! @param on Whether anti-aliasing should be used.
+        void set_antialiasing(bool on);
+        //! Check if anti-aliased rendering is enabled.
+        //! @return True if anti-aliasing is enabled.
+        bool antialiasing() const;
+        //! Record drawing into a span buffer instead of the pixels.
+        //! Anti-aliased drawing blends with the pixels underneath, so it
+        //! cannot be recorded and must not be combined with a span buffer.
+        //! @param spans Span buffer of the same size, or nullptr to draw
+        //! directly into the pixels again.
+        void set_span_buffer(SpanBuffer *spans);
+        //! Check a cancellation token once per scanline while filling.
+        //! Drawing then throws Cancelled, leaving the image partly drawn.
+        //! @param cancel Token (not owned), or nullptr to never stop.
+        void set_cancellation(const CancellationToken *cancel);
+        //! Restrict drawing to a box. Pixels outside it are left as they are,
+        //! and pixels inside are drawn exactly as without the box.
+        //! @param box Box (clipped to the image), or an empty Box to draw on
+        //! the whole image again.
+        void set_clip(const Box &box);
 
     private:
+        //! Set a pixel, ignoring positions outside the image.
+        //! @param x X position.
+        //! @param y Y position.
+        //! @param c Color to use.
+        void plot(int x, int y, const Color &c);
+        //! Fill a horizontal run of pixels, clipped to the image.
+        //! @param y Row.
+        //! @param x0 First column.
+        //! @param x1 Last column (inclusive).
+        //! @param c Color to use.
+        void fill_span(int y, int x0, int x1, const Color &c);
+        //! Fill the area enclosed by a set of contours.
+        //! @param contours Pointer to the first contour.
+        //! @param count Number of contours.
+        //! @param c Color to use.
+        //! @param rule Fill rule.
+        void fill_contours(const PointSpan *contours, size_t count, const Color &c, FillRule rule);
+        //! Fill a single aliased polygon with the even-odd rule by pairing
+        //! its sorted scanline crossings. Edges include both end rows, as
+        //! polygons have always been filled, which keeps their pixels
+        //! unchanged (fill_contours uses half-open edges instead).
+        //! @param points First point of the polygon.
+        //! @param n Number of points.
+        //! @param c Color to use.
+        void fill_crossing_pairs(const Point *points, size_t n, const Color &c);
+        //! Fill an ellipse whose axes are not aligned with the image axes.
+        void fill_rotated_ellipse(const Point &center, const Point &radius,
+                                  double angle, const Color &fill);
+        //! Polygon edge used by the anti-aliased rasterizer.
+        struct Edge;
+        //! Fill the area enclosed by a set of edges with pixel coverage.
+        //! @param edges Edges of the area (consumed).
+        //! @param fill Color to blend with each covered pixel.
+        //! @param rule Fill rule.
+        void fill_coverage(std::vector<Edge> &edges, const Color &fill, FillRule rule);
+        //! Scanline crossing of a polygon edge (aliased polygons).
+        struct Crossing
+        {
+            //! X position.
+            double x;
+            //! 1 for an edge going down, -1 for an edge going up.
+            int dir;
+        };
+        //! Accumulate the signed area of a segment within a single row.
+        void accumulate(double xa, double ya, double xb, double yb,
+                        int &x_lo, int &x_hi);
+
         //! Width.
         int width_;
         //! Height.
         int height_;
+        //! Row stride in bytes.
+        int stride_;
         //! Pixels.
         Color *pixels_;
+        //! Whether pixels_ is owned (and freed) by the image.
+        bool owned_;
+        //! Anti-aliasing flag.
+        bool antialias_;
+        //! Signed-area accumulation buffer for one row (anti-aliasing).
+        std::vector<float> coverage_;
+        //! Scanline intersections of one row (aliased polygons).
+        std::vector<Crossing> intersections_;
+        //! Contour list passed to fill_contours.
+        std::vector<PointSpan> contours_;
+        //! Span buffer receiving aliased drawing, if any.
+        SpanBuffer *spans_;
+        //! Cancellation token checked by the fill loops, if any.
+        const CancellationToken *cancel_;
+        //! Pixels that drawing may change (the whole image by default).
+        Box clip_;
     };
 }
 
@@ -0,0 +1,218 @@
+//! @file Pipeline.cpp
+#include "Pipeline.hpp"
+#include "BoundedQueue.hpp"
+#include "Budget.hpp"
+#include "SceneFile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace svg
+{
+    namespace
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        //! Parsed document waiting to be drawn.
+        struct ParsedJob
+        {
+            size_t job;
+            Point dimensions;
+            std::vector<std::unique_ptr<SVGElement>> svg_elements;
+            std::unique_ptr<SceneFile> scene;
+            RenderStats measured;
+        };
+
+        //! Drawn image waiting to be written.
+        struct RenderedJob
+        {
+            size_t job;
+            std::unique_ptr<PNGImage> img;
+            RenderStats measured;
+        };
+
+        /**
+         * @brief Runs the threads of one stage and waits for them.
+         *
+         * @param threads Number of threads.
+         * @param stats Activity of the stage (threads, items and busy time are updated).
+         * @param step Processes one item; returns false when there is no more work.
+         * It receives the time to add to the busy total and whether an item was done.
+         */
+        template <typename Step>
+        void runStage(unsigned threads, StageStats &stats, const Step &step)
+        {
+            std::mutex stats_mutex;
+            std::vector<std::thread> pool;
+            stats.threads = threads;
+            for (unsigned i = 0; i < threads; i++)
+            {
+                pool.emplace_back([&]()
+                                  {
+                                      double busy = 0;
+                                      size_t items = 0;
+                                      while (step(busy, items))
+                                      {
+                                      }
+                                      std::lock_guard<std::mutex> lock(stats_mutex);
+                                      stats.busy += busy;
+                                      stats.items += items;
+                                  });
+            }
+            for (std::thread &t : pool)
+            {
+                t.join();
+            }
+        }
+
+        /**
+         * @brief Gets the seconds elapsed since a time point.
+         */
+        double since(const Clock::time_point &start)
+        {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+    }
+
+    PipelineStats convertBatch(const std::vector<ConversionJob> &jobs, const PipelineOptions &options)
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        unsigned readers = std::max(1u, options.readers);
+        unsigned renderers = options.renderers != 0 ? options.renderers : cores;
+        unsigned encoders = options.encoders != 0 ? options.encoders : cores;
+
+        PipelineStats stats;
+        std::mutex errors_mutex;
+        auto fail = [&](size_t job, const std::exception &e)
+        {
+            std::lock_guard<std::mutex> lock(errors_mutex);
+            stats.errors.push_back(jobs[job].svg_file + ": " + e.what());
+        };
+
+        BoundedQueue<ParsedJob> parsed(options.queue_capacity);
+        BoundedQueue<RenderedJob> rendered(options.queue_capacity);
+        std::atomic<size_t> next_job(0);
+        Clock::time_point start = Clock::now();
+
+        // Each stage closes its output queue once all of its threads are done,
+        // so the next stage ends after draining it.
+        std::thread read_stage([&]()
+                               {
+                                   runStage(readers, stats.read, [&](double &busy, size_t &items)
+                                            {
+                                                size_t job = next_job++;
+                                                if (job >= jobs.size())
+                                                {
+                                                    return false;
+                                                }
+                                                Clock::time_point t = Clock::now();
+                                                ParsedJob item;
+                                                item.job = job;
+                                                try
+                                                {
+                                                    const std::string &file = jobs[job].svg_file;
+                                                    if (SceneFile::probe(file))
+                                                    {
+                                                        item.scene.reset(new SceneFile(file));
+                                                        item.dimensions = item.scene->dimensions();
+                                                        enforceBudget(*item.scene, item.dimensions, options.render, item.measured);
+                                                    }
+                                                    else
+                                                    {
+                                                        readSVG(file, item.dimensions, item.svg_elements);
+                                                        enforceBudget(item.svg_elements, item.dimensions, options.render, item.measured);
+                                                    }
+                                                }
+                                                catch (const std::exception &e)
+                                                {
+                                                    fail(job, e);
+                                                    busy += since(t);
+                                                    return true;
+                                                }
+                                                busy += since(t);
+                                                items++;
+                                                parsed.push(std::move(item));
+                                                return true;
+                                            });
+                                   parsed.close();
+                               });
+        std::thread render_stage([&]()
+                                 {
+                                     runStage(renderers, stats.render, [&](double &busy, size_t &items)
+                                              {
+                                                  ParsedJob item;
+                                                  if (!parsed.pop(item))
+                                                  {
+                                                      return false;
+                                                  }
+                                                  Clock::time_point t = Clock::now();
+                                                  RenderedJob out;
+                                                  out.job = item.job;
+                                                  out.measured = item.measured;
+                                                  try
+                                                  {
+                                                      out.img.reset(new PNGImage(item.dimensions.x, item.dimensions.y, false));
+                                                      if (item.scene)
+                                                      {
+                                                          renderScene(*item.scene, *out.img, options.render);
+                                                      }
+                                                      else
+                                                      {
+                                                          renderScene(item.svg_elements, *out.img, options.render);
+                                                      }
+                                                  }
+                                                  catch (const std::exception &e)
+                                                  {
+                                                      fail(item.job, e);
+                                                      busy += since(t);
+                                                      return true;
+                                                  }
+                                                  busy += since(t);
+                                                  items++;
+                                                  rendered.push(std::move(out));
+                                                  return true;
+                                              });
+                                     rendered.close();
+                                 });
+        runStage(encoders, stats.encode, [&](double &busy, size_t &items)
+                 {
+                     RenderedJob item;
+                     if (!rendered.pop(item))
+                     {
+                         return false;
+                     }
+                     Clock::time_point t = Clock::now();
+                     try
+                     {
+                         item.img->save(jobs[item.job].png_file);
+                         items++;
+                         throwIfTruncated(item.measured, options.render);
+                     }
+                     catch (const std::exception &e)
+                     {
+                         fail(item.job, e);
+                     }
+                     busy += since(t);
+                     return true;
+                 });
+        read_stage.join();
+        render_stage.join();
+
+        stats.elapsed = since(start);
+        stats.render.max_queue_depth = parsed.max_depth();
+        stats.render.mean_queue_depth = parsed.mean_depth();
+        stats.encode.max_queue_depth = rendered.max_depth();
+        stats.encode.mean_queue_depth = rendered.mean_depth();
+        for (StageStats *s : {&stats.read, &stats.render, &stats.encode})
+        {
+            s->utilization = stats.elapsed > 0 ? s->busy / (s->threads * stats.elapsed) : 0;
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,79 @@
+//! @file Pipeline.hpp
+#ifndef __svg_Pipeline_hpp__
+#define __svg_Pipeline_hpp__
+
+#include "SVGElements.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Input and output file of one conversion.
+    struct ConversionJob
+    {
+        //! SVG (or scene) file to read.
+        std::string svg_file;
+        //! PNG file to write.
+        std::string png_file;
+    };
+
+    //! Thread counts and queue sizes of convertBatch().
+    struct PipelineOptions
+    {
+        //! Threads loading and parsing input files.
+        unsigned readers = 1;
+        //! Threads drawing images (0: one per core).
+        unsigned renderers = 0;
+        //! Threads encoding and writing PNG files (0: one per core).
+        unsigned encoders = 0;
+        //! Maximum number of items waiting between two stages.
+        size_t queue_capacity = 4;
+        //! How each image is drawn.
+        RenderOptions render;
+    };
+
+    //! Activity of one stage of the pipeline.
+    struct StageStats
+    {
+        //! Number of threads.
+        unsigned threads = 0;
+        //! Number of items processed.
+        size_t items = 0;
+        //! Time spent working, summed over the threads (seconds).
+        double busy = 0;
+        //! Fraction of the elapsed time the threads were working.
+        double utilization = 0;
+        //! Largest number of items waiting for the stage.
+        size_t max_queue_depth = 0;
+        //! Average number of items waiting for the stage.
+        double mean_queue_depth = 0;
+    };
+
+    //! Result of convertBatch().
+    struct PipelineStats
+    {
+        //! Load and parse stage.
+        StageStats read;
+        //! Rasterization stage.
+        StageStats render;
+        //! Encode and write stage.
+        StageStats encode;
+        //! Total time (seconds).
+        double elapsed = 0;
+        //! One message per failed job.
+        std::vector<std::string> errors;
+    };
+
+    //! Convert many files with overlapping stages: reading and parsing,
+    //! drawing, and encoding and writing run in their own threads, joined
+    //! by bounded queues. A failed job is reported and skipped. The render
+    //! budget is applied by the read stage, before an image is allocated.
+    //! @param jobs Files to convert.
+    //! @param options Thread counts, queue sizes and rendering options.
+    //! @return Per-stage activity and errors.
+    PipelineStats convertBatch(const std::vector<ConversionJob> &jobs,
+                               const PipelineOptions &options = PipelineOptions());
+}
+#endif
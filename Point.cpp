@@ -1,4 +1,5 @@
 //! @file point.cpp
+#include <algorithm>
 #include <cmath>
 #include "Point.hpp"
 
@@ -27,4 +28,41 @@ namespace svg
                 origin.y + (y - origin.y) * v};
     }
 
+    Point Point::shrink(int v) const
+    {
+        // Round toward minus infinity, so pixel columns 0 .. v-1 become column 0.
+        auto down = [v](int c) { return c >= 0 ? c / v : -((-c + v - 1) / v); };
+        return {down(x), down(y)};
+    }
+
+    bool Box::empty() const
+    {
+        return min.x > max.x || min.y > max.y;
+    }
+
+    bool Box::contains(const Point &p) const
+    {
+        return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y;
+    }
+
+    bool Box::intersects(const Box &b) const
+    {
+        return b.min.x <= max.x && b.max.x >= min.x && b.min.y <= max.y && b.max.y >= min.y;
+    }
+
+    void Box::extend(const Point &p)
+    {
+        min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+        max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+    }
+
+    void Box::extend(const Box &b)
+    {
+        if (!b.empty())
+        {
+            extend(b.min);
+            extend(b.max);
+        }
+    }
+
 }
@@ -2,6 +2,8 @@
 #ifndef __svg_point_hpp__
 #define __svg_point_hpp__
 
+#include <climits>
+
 namespace svg
 {
     //! 2D Point struct, with a few convenience member functions (can be defined for structs too).
@@ -26,6 +28,37 @@ namespace svg
         //! @param v Scale amount.
         //! @return Scaling result.
         Point scale(const Point &origin, int v) const;
+        //! Divide the coordinates of a point, rounding down.
+        //! @param v Divisor (positive).
+        //! @return Point at 1/v of the resolution.
+        Point shrink(int v) const;
+    };
+
+    //! Axis-aligned box, including both corners. Initially empty.
+    struct Box
+    {
+        //! Top-left corner.
+        Point min = {INT_MAX, INT_MAX};
+        //! Bottom-right corner.
+        Point max = {INT_MIN, INT_MIN};
+
+        //! Check if the box contains no point.
+        //! @return True if empty.
+        bool empty() const;
+        //! Check if a point lies in the box.
+        //! @param p Point.
+        //! @return True if p is in the box.
+        bool contains(const Point &p) const;
+        //! Check if two boxes have a point in common.
+        //! @param b Other box.
+        //! @return True if the boxes overlap.
+        bool intersects(const Box &b) const;
+        //! Grow the box to include a point.
+        //! @param p Point.
+        void extend(const Point &p);
+        //! Grow the box to include another box.
+        //! @param b Other box.
+        void extend(const Box &b);
     };
 }
 #endif
@@ -0,0 +1,432 @@
+//! @file PointVector.cpp
+#include "PointVector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace svg
+{
+    PointVector::PointVector()
+        : size_(0)
+    {
+    }
+
+    PointVector::PointVector(std::initializer_list<Point> points)
+        : size_(0)
+    {
+        if (points.size() > INLINE_CAPACITY)
+        {
+            heap_.assign(points.begin(), points.end());
+        }
+        else
+        {
+            std::copy(points.begin(), points.end(), inline_);
+        }
+        size_ = points.size();
+    }
+
+    PointVector::PointVector(std::vector<Point> &&points)
+        : size_(points.size())
+    {
+        if (size_ > INLINE_CAPACITY)
+        {
+            heap_ = std::move(points);
+        }
+        else
+        {
+            std::copy(points.begin(), points.end(), inline_);
+        }
+    }
+
+    PointVector::PointVector(const std::vector<Point> &points)
+        : size_(points.size())
+    {
+        if (size_ > INLINE_CAPACITY)
+        {
+            heap_ = points;
+        }
+        else
+        {
+            std::copy(points.begin(), points.end(), inline_);
+        }
+    }
+
+    PointVector::PointVector(const PointVector &other)
+        : size_(other.size_), heap_(other.heap_)
+    {
+        if (size_ <= INLINE_CAPACITY)
+        {
+            std::copy(other.inline_, other.inline_ + size_, inline_);
+        }
+    }
+
+    PointVector::PointVector(PointVector &&other) noexcept
+        : size_(other.size_), heap_(std::move(other.heap_))
+    {
+        if (size_ <= INLINE_CAPACITY)
+        {
+            std::copy(other.inline_, other.inline_ + size_, inline_);
+        }
+        other.size_ = 0;
+        other.heap_.clear();
+    }
+
+    PointVector &PointVector::operator=(const PointVector &other)
+    {
+        if (this != &other)
+        {
+            size_ = other.size_;
+            heap_ = other.heap_;
+            if (size_ <= INLINE_CAPACITY)
+            {
+                std::copy(other.inline_, other.inline_ + size_, inline_);
+            }
+        }
+        return *this;
+    }
+
+    PointVector &PointVector::operator=(PointVector &&other) noexcept
+    {
+        if (this != &other)
+        {
+            size_ = other.size_;
+            heap_ = std::move(other.heap_);
+            if (size_ <= INLINE_CAPACITY)
+            {
+                std::copy(other.inline_, other.inline_ + size_, inline_);
+            }
+            other.size_ = 0;
+            other.heap_.clear();
+        }
+        return *this;
+    }
+
+    size_t PointVector::size() const
+    {
+        return size_;
+    }
+
+    bool PointVector::empty() const
+    {
+        return size_ == 0;
+    }
+
+    bool PointVector::on_heap() const
+    {
+        return size_ > INLINE_CAPACITY;
+    }
+
+    Point &PointVector::operator[](size_t i)
+    {
+        return data()[i];
+    }
+
+    const Point &PointVector::operator[](size_t i) const
+    {
+        return data()[i];
+    }
+
+    Point *PointVector::data()
+    {
+        return size_ > INLINE_CAPACITY ? heap_.data() : inline_;
+    }
+
+    const Point *PointVector::data() const
+    {
+        return size_ > INLINE_CAPACITY ? heap_.data() : inline_;
+    }
+
+    Point *PointVector::begin()
+    {
+        return data();
+    }
+
+    Point *PointVector::end()
+    {
+        return data() + size_;
+    }
+
+    const Point *PointVector::begin() const
+    {
+        return data();
+    }
+
+    const Point *PointVector::end() const
+    {
+        return data() + size_;
+    }
+
+    const Point &PointVector::front() const
+    {
+        return data()[0];
+    }
+
+    const Point &PointVector::back() const
+    {
+        return data()[size_ - 1];
+    }
+
+    void PointVector::push_back(const Point &p)
+    {
+        if (size_ < INLINE_CAPACITY)
+        {
+            inline_[size_] = p;
+        }
+        else
+        {
+            if (size_ == INLINE_CAPACITY)
+            {
+                // Spill the inline points to the heap.
+                heap_.reserve(2 * INLINE_CAPACITY);
+                heap_.assign(inline_, inline_ + INLINE_CAPACITY);
+            }
+            heap_.push_back(p);
+        }
+        size_++;
+    }
+
+    void PointVector::clear()
+    {
+        heap_.clear();
+        size_ = 0;
+    }
+
+    void PointVector::truncate(size_t n)
+    {
+        if (n >= size_)
+        {
+            return;
+        }
+        if (size_ > INLINE_CAPACITY && n <= INLINE_CAPACITY)
+        {
+            std::copy(heap_.begin(), heap_.begin() + n, inline_);
+            heap_.clear();
+        }
+        else if (n > INLINE_CAPACITY)
+        {
+            heap_.resize(n);
+        }
+        size_ = n;
+    }
+
+    namespace
+    {
+        //! Squared distance from p to the segment [a, b].
+        double segmentDistance2(const Point &p, const Point &a, const Point &b)
+        {
+            double dx = b.x - a.x, dy = b.y - a.y;
+            double px = p.x - a.x, py = p.y - a.y;
+            double len2 = dx * dx + dy * dy;
+            if (len2 > 0)
+            {
+                double t = std::max(0.0, std::min(1.0, (px * dx + py * dy) / len2));
+                px -= t * dx;
+                py -= t * dy;
+            }
+            return px * px + py * py;
+        }
+    }
+
+    PointVector simplify(const PointVector &points, double tolerance, bool closed)
+    {
+        std::vector<Point> unique;
+        unique.reserve(points.size());
+        for (const Point &p : points)
+        {
+            if (unique.empty() || p.x != unique.back().x || p.y != unique.back().y)
+            {
+                unique.push_back(p);
+            }
+        }
+        if (closed)
+        {
+            while (unique.size() > 1 && unique.back().x == unique.front().x &&
+                   unique.back().y == unique.front().y)
+            {
+                unique.pop_back();
+            }
+        }
+        else if (unique.size() == 1 && points.size() > 1)
+        {
+            // Keep a degenerate segment so the single pixel is still drawn.
+            unique.push_back(unique.front());
+        }
+        if (tolerance <= 0 || unique.size() <= 3)
+        {
+            return PointVector(std::move(unique));
+        }
+
+        // A closed contour is split at its first point and the point
+        // farthest from it, and both halves are simplified as open chains.
+        size_t n = unique.size();
+        std::vector<bool> keep(n, false);
+        std::vector<std::pair<size_t, size_t>> pending;
+        keep[0] = true;
+        if (closed)
+        {
+            size_t far = 0;
+            double far_d2 = -1;
+            for (size_t i = 1; i < n; i++)
+            {
+                double dx = unique[i].x - unique[0].x, dy = unique[i].y - unique[0].y;
+                if (dx * dx + dy * dy > far_d2)
+                {
+                    far = i;
+                    far_d2 = dx * dx + dy * dy;
+                }
+            }
+            keep[far] = true;
+            unique.push_back(unique[0]);
+            pending.push_back({0, far});
+            pending.push_back({far, n});
+        }
+        else
+        {
+            keep[n - 1] = true;
+            pending.push_back({0, n - 1});
+        }
+
+        double tolerance2 = tolerance * tolerance;
+        while (!pending.empty())
+        {
+            size_t first = pending.back().first;
+            size_t last = pending.back().second;
+            pending.pop_back();
+            size_t worst = first;
+            double worst_d2 = tolerance2;
+            for (size_t i = first + 1; i < last; i++)
+            {
+                double d2 = segmentDistance2(unique[i], unique[first], unique[last]);
+                if (d2 > worst_d2)
+                {
+                    worst = i;
+                    worst_d2 = d2;
+                }
+            }
+            if (worst != first)
+            {
+                keep[worst] = true;
+                pending.push_back({first, worst});
+                pending.push_back({worst, last});
+            }
+        }
+
+        std::vector<Point> result;
+        for (size_t i = 0; i < n; i++)
+        {
+            if (keep[i])
+            {
+                result.push_back(unique[i]);
+            }
+        }
+        return PointVector(std::move(result));
+    }
+
+#ifdef __SSE2__
+    namespace
+    {
+        static_assert(sizeof(Point) == 2 * sizeof(int), "points are loaded as pairs of ints");
+
+        /**
+         * @brief Rounds two doubles half away from zero, like lround.
+         *
+         * @param v The values.
+         * @return The rounded values in the two low lanes.
+         */
+        __m128i roundHalfAway(__m128d v)
+        {
+            // v - trunc(v) is exact, so comparing it with 0.5 decides ties
+            // the same way lround does.
+            __m128i t = _mm_cvttpd_epi32(v);
+            __m128d frac = _mm_sub_pd(v, _mm_cvtepi32_pd(t));
+            __m128i up = _mm_castpd_si128(_mm_cmpge_pd(frac, _mm_set1_pd(0.5)));
+            __m128i down = _mm_castpd_si128(_mm_cmple_pd(frac, _mm_set1_pd(-0.5)));
+            // Each 64-bit mask becomes a 32-bit one (-1 or 0).
+            up = _mm_shuffle_epi32(up, _MM_SHUFFLE(3, 1, 2, 0));
+            down = _mm_shuffle_epi32(down, _MM_SHUFFLE(3, 1, 2, 0));
+            return _mm_add_epi32(_mm_sub_epi32(t, up), down);
+        }
+
+        /**
+         * @brief Multiplies 32-bit lanes, keeping the low 32 bits (SSE2 has no pmulld).
+         */
+        __m128i multiplyLow(__m128i a, __m128i b)
+        {
+            __m128i even = _mm_mul_epu32(a, b);
+            __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+    }
+#endif
+
+    void translatePoints(Point *points, size_t n, const Point &t)
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i vt = _mm_setr_epi32(t.x, t.y, t.x, t.y);
+        for (; i + 2 <= n; i += 2)
+        {
+            __m128i *p = (__m128i *)(points + i);
+            _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), vt));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            points[i] = points[i].translate(t);
+        }
+    }
+
+    void rotatePoints(Point *points, size_t n, const Point &origin, int degrees)
+    {
+        double angle = M_PI * degrees / 180.0;
+        double s = ::sin(angle);
+        double c = ::cos(angle);
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i vo = _mm_setr_epi32(origin.x, origin.y, origin.x, origin.y);
+        const __m128d vs = _mm_set1_pd(s);
+        const __m128d vc = _mm_set1_pd(c);
+        for (; i + 2 <= n; i += 2)
+        {
+            __m128i *p = (__m128i *)(points + i);
+            // x0 y0 x1 y1 -> x0 x1 y0 y1.
+            __m128i d = _mm_shuffle_epi32(_mm_sub_epi32(_mm_loadu_si128(p), vo), _MM_SHUFFLE(3, 1, 2, 0));
+            __m128d dx = _mm_cvtepi32_pd(d);
+            __m128d dy = _mm_cvtepi32_pd(_mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+            __m128i rx = roundHalfAway(_mm_sub_pd(_mm_mul_pd(vc, dx), _mm_mul_pd(vs, dy)));
+            __m128i ry = roundHalfAway(_mm_add_pd(_mm_mul_pd(vs, dx), _mm_mul_pd(vc, dy)));
+            _mm_storeu_si128(p, _mm_add_epi32(_mm_unpacklo_epi32(rx, ry), vo));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            double dx = points[i].x - origin.x;
+            double dy = points[i].y - origin.y;
+            points[i] = {origin.x + (int)::lround(c * dx - s * dy), origin.y + (int)::lround(s * dx + c * dy)};
+        }
+    }
+
+    void scalePoints(Point *points, size_t n, const Point &origin, int v)
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i vo = _mm_setr_epi32(origin.x, origin.y, origin.x, origin.y);
+        const __m128i vv = _mm_set1_epi32(v);
+        for (; i + 2 <= n; i += 2)
+        {
+            __m128i *p = (__m128i *)(points + i);
+            _mm_storeu_si128(p, _mm_add_epi32(multiplyLow(_mm_sub_epi32(_mm_loadu_si128(p), vo), vv), vo));
+        }
+#endif
+        for (; i < n; i++)
+        {
+            points[i] = points[i].scale(origin, v);
+        }
+    }
+}
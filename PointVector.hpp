@@ -0,0 +1,132 @@
+//! @file PointVector.hpp
+#ifndef __svg_PointVector_hpp__
+#define __svg_PointVector_hpp__
+
+#include "Point.hpp"
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+namespace svg
+{
+    //! Read-only view of consecutive points stored elsewhere.
+    struct PointSpan
+    {
+        //! First point.
+        const Point *data;
+        //! Number of points.
+        size_t size;
+    };
+
+    //! Sequence of points that keeps small point sets (lines, triangles,
+    //! rectangles) inline and only uses the heap for larger ones.
+    class PointVector
+    {
+    public:
+        //! Number of points stored without a heap allocation.
+        static const size_t INLINE_CAPACITY = 4;
+
+        //! Constructor of an empty sequence.
+        PointVector();
+        //! Constructor from a list of points.
+        //! @param points Points.
+        PointVector(std::initializer_list<Point> points);
+        //! Constructor from a vector of points.
+        //! Large vectors are adopted without copying.
+        //! @param points Points.
+        PointVector(std::vector<Point> &&points);
+        //! Constructor from a vector of points.
+        //! @param points Points.
+        PointVector(const std::vector<Point> &points);
+        //! Copy constructor.
+        PointVector(const PointVector &other);
+        //! Move constructor.
+        PointVector(PointVector &&other) noexcept;
+        //! Copy assignment.
+        PointVector &operator=(const PointVector &other);
+        //! Move assignment.
+        PointVector &operator=(PointVector &&other) noexcept;
+
+        //! Get the number of points.
+        //! @return The number of points.
+        size_t size() const;
+        //! Check if there are no points.
+        //! @return True if empty.
+        bool empty() const;
+        //! Check if the points are stored on the heap.
+        //! @return True if a heap allocation is in use.
+        bool on_heap() const;
+        //! Get mutable reference to a point.
+        //! @param i Index.
+        //! @return Reference to point.
+        Point &operator[](size_t i);
+        //! Get const reference to a point.
+        //! @param i Index.
+        //! @return Reference to point.
+        const Point &operator[](size_t i) const;
+        //! Get pointer to the first point.
+        Point *data();
+        //! Get const pointer to the first point.
+        const Point *data() const;
+        //! Iterator to the first point.
+        Point *begin();
+        //! Iterator past the last point.
+        Point *end();
+        //! Const iterator to the first point.
+        const Point *begin() const;
+        //! Const iterator past the last point.
+        const Point *end() const;
+        //! Get the first point.
+        const Point &front() const;
+        //! Get the last point.
+        const Point &back() const;
+        //! Append a point.
+        //! @param p Point to append.
+        void push_back(const Point &p);
+        //! Remove all points.
+        void clear();
+        //! Keep only the first n points.
+        //! @param n New size (not larger than the current one).
+        void truncate(size_t n);
+
+    private:
+        //! Number of points.
+        size_t size_;
+        //! Inline storage, used while size_ <= INLINE_CAPACITY.
+        Point inline_[INLINE_CAPACITY];
+        //! Heap storage, used while size_ > INLINE_CAPACITY.
+        std::vector<Point> heap_;
+    };
+
+    //! Remove points that do not change how a sequence is rendered.
+    //! Repeated points are always dropped. With a positive tolerance, the
+    //! sequence is further reduced with the Douglas-Peucker algorithm, so no
+    //! dropped point lies farther than the tolerance from the result.
+    //! @param points Points.
+    //! @param tolerance Maximum distance (in pixels) of a dropped point.
+    //! @param closed Whether the last point connects back to the first.
+    //! @return The remaining points, in their original order.
+    PointVector simplify(const PointVector &points, double tolerance, bool closed);
+
+    //! Translate points in place (same result as Point::translate on each).
+    //! @param points First point.
+    //! @param n Number of points.
+    //! @param t Translation direction.
+    void translatePoints(Point *points, size_t n, const Point &t);
+    //! Rotate points in place (same result as Point::rotate on each). The
+    //! sine and cosine are computed once, and with SSE2 two points are
+    //! rotated per step, with their x and y coordinates in separate lanes.
+    //! @param points First point.
+    //! @param n Number of points.
+    //! @param origin Rotation origin.
+    //! @param degrees Degrees of rotation.
+    void rotatePoints(Point *points, size_t n, const Point &origin, int degrees);
+    //! Scale points in place (same result as Point::scale on each).
+    //! @param points First point.
+    //! @param n Number of points.
+    //! @param origin Scaling origin.
+    //! @param v Scale amount.
+    void scalePoints(Point *points, size_t n, const Point &origin, int v);
+}
+#endif
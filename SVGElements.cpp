@@ -1,10 +1,114 @@
 #include "SVGElements.hpp"
+#include "SceneFile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
 
 namespace svg
 {
+    namespace
+    {
+        /**
+         * @brief Computes the box enclosing a list of points.
+         *
+         * @param points The points.
+         * @param box The box to extend.
+         */
+        void extendBounds(const PointVector &points, Box &box)
+        {
+            for (const Point &p : points)
+            {
+                box.extend(p);
+            }
+        }
+
+        /**
+         * @brief Counts the pixels of a box that lie on the canvas.
+         *
+         * @param box The box.
+         * @param canvas The pixels of the image.
+         * @return The number of pixels in both boxes.
+         */
+        uint64_t coveredPixels(const Box &box, const Box &canvas)
+        {
+            int64_t w = (int64_t)std::min(box.max.x, canvas.max.x) - std::max(box.min.x, canvas.min.x) + 1;
+            int64_t h = (int64_t)std::min(box.max.y, canvas.max.y) - std::max(box.min.y, canvas.min.y) + 1;
+            return w > 0 && h > 0 ? (uint64_t)w * (uint64_t)h : 0;
+        }
+
+        /**
+         * @brief Adds the cost of drawing the segments between consecutive points.
+         *
+         * @param points The points.
+         * @param closed Whether the last point is joined to the first.
+         * @param canvas The pixels of the image.
+         * @param total The cost to increase.
+         */
+        void addLines(const PointVector &points, bool closed, const Box &canvas, RenderCost &total)
+        {
+            size_t n = points.size();
+            for (size_t i = 0; i + 1 < n || (closed && i + 1 == n && n > 1); i++)
+            {
+                const Point &a = points[i], &b = points[(i + 1) % n];
+                Box box;
+                box.extend(a);
+                box.extend(b);
+                int64_t length = std::max(std::llabs((int64_t)b.x - a.x), std::llabs((int64_t)b.y - a.y)) + 1;
+                total.pixels += std::min((uint64_t)length, coveredPixels(box, canvas));
+                total.edges++;
+            }
+        }
+
+        /**
+         * @brief Adds the cost of storing a list of points.
+         *
+         * @param points The points.
+         * @param total The cost to increase.
+         */
+        void addVertices(const PointVector &points, RenderCost &total)
+        {
+            total.vertices += points.size();
+            total.bytes += points.size() * sizeof(Point);
+        }
+
+        /**
+         * @brief Shrinks every point of a list.
+         *
+         * @param points The points.
+         * @param v The divisor.
+         */
+        void shrinkPoints(PointVector &points, int v)
+        {
+            for (size_t i = 0; i < points.size(); i++)
+            {
+                points[i] = points[i].shrink(v);
+            }
+        }
+    }
+
     SVGElement::SVGElement() {}
     SVGElement::~SVGElement() {}
 
+    /**
+     * @brief Drops vertices that do not change the rendered element (none by default).
+     *
+     * @param tolerance Maximum distance, in pixels, of a dropped vertex.
+     */
+    void SVGElement::simplify(double tolerance) {}
+
+    /**
+     * @brief Checks if drawing the element has no effect (never, by default).
+     *
+     * @return True if the element can be left out of the scene.
+     */
+    bool SVGElement::empty() const
+    {
+        return false;
+    }
+
     /**
      * @brief Constructs an Ellipse object with the specified fill color, center point, and radius.
      * 
@@ -16,8 +120,9 @@ namespace svg
                      const Point &center,
                      const Point &radius, 
                      const std::string &id)
-        : fill(fill), center(center), radius(radius)
+        : fill(fill), center(center), radius(radius), orientation(0)
     {
+        this->id = id;
     }
 
     /**
@@ -27,7 +132,7 @@ namespace svg
      */
     void Ellipse::draw(PNGImage &img) const
     {
-        img.draw_ellipse(center, radius, fill);
+        img.draw_ellipse(center, radius, fill, orientation);
     }
 
     /**
@@ -49,6 +154,7 @@ namespace svg
     void Ellipse::rotate(const Point &origin, int degrees)
     {
         center = center.rotate(origin, degrees);
+        orientation = (orientation + degrees) % 360;
     }
 
     /**
@@ -67,10 +173,76 @@ namespace svg
     /**
      * @brief Creates a copy of the Ellipse object.
      * 
-     * @return A pointer to the copied Ellipse object.
+     * @return An owning pointer to the copied Ellipse object.
+     */
+    std::unique_ptr<SVGElement> Ellipse::copy() const{
+        return std::unique_ptr<SVGElement>(new Ellipse(*this));
+    }
+
+    /**
+     * @brief Copies another ellipse (or an element derived from it) into this one.
+     *
+     * Point storage is reused when it is large enough.
+     *
+     * @param other The element to copy, of the same type as this one.
+     */
+    void Ellipse::assign(const SVGElement &other)
+    {
+        *this = static_cast<const Ellipse &>(other);
+    }
+
+    /**
+     * @brief Appends the ellipse to a scene file.
+     *
+     * @param out The scene being written.
+     */
+    void Ellipse::compile(SceneWriter &out) const
+    {
+        SceneRecord record = SceneRecord();
+        record.type = (uint8_t)SceneRecordType::Ellipse;
+        record.fill = fill;
+        record.center = center;
+        record.radius = radius;
+        record.orientation = orientation;
+        out.add(record, id);
+    }
+
+    /**
+     * @brief Adds the work of filling the ellipse on a canvas.
+     *
+     * @param canvas The pixels of the image.
+     * @param total The cost to increase.
+     */
+    void Ellipse::cost(const Box &canvas, RenderCost &total) const
+    {
+        total.pixels += coveredPixels(bounds(), canvas);
+    }
+
+    /**
+     * @brief Divides the center and radii of the ellipse, rounding down.
+     *
+     * @param v The divisor.
      */
-    SVGElement* Ellipse::copy() const{
-        return new Ellipse(fill,center,radius,id);
+    void Ellipse::shrink(int v)
+    {
+        center = center.shrink(v);
+        radius = {radius.x / v, radius.y / v};
+    }
+
+    /**
+     * @brief Computes the box enclosing the pixels of the ellipse.
+     *
+     * @return The bounding box (empty if the ellipse draws nothing).
+     */
+    Box Ellipse::bounds() const
+    {
+        int rx = std::abs(radius.x), ry = std::abs(radius.y);
+        if (orientation % 180 != 0)
+        {
+            // Rotated axes stay within the circle of the larger radius.
+            rx = ry = std::max(rx, ry);
+        }
+        return Box{{center.x - rx, center.y - ry}, {center.x + rx, center.y + ry}};
     }
 
     /**
@@ -86,22 +258,38 @@ namespace svg
     /**
      * @brief Creates a copy of the Circle object.
      * 
-     * @return A pointer to the copied Circle object.
+     * @return An owning pointer to the copied Circle object.
      */
-    SVGElement* Circle::copy() const{
-        return new Circle(fill,center,radius.x,id);
+    std::unique_ptr<SVGElement> Circle::copy() const{
+        return std::unique_ptr<SVGElement>(new Circle(*this));
+    }
+
+    /**
+     * @brief Appends the circle to a scene file (circles ignore their orientation).
+     *
+     * @param out The scene being written.
+     */
+    void Circle::compile(SceneWriter &out) const
+    {
+        SceneRecord record = SceneRecord();
+        record.type = (uint8_t)SceneRecordType::Ellipse;
+        record.fill = fill;
+        record.center = center;
+        record.radius = radius;
+        out.add(record, id);
     }
     /**
      * @brief Constructs a Polyline object with the specified points and stroke color.
      * 
-     * @param points The vector of points that define the polyline.
+     * @param points The points that define the polyline (taken over, not copied).
      * @param stroke The color of the polyline's stroke.
      */
-    Polyline::Polyline(const std::vector<Point> &points,
+    Polyline::Polyline(PointVector points,
                        const Color &stroke, 
                        const std::string &id)
-        : points(points), stroke(stroke)
+        : points(std::move(points)), stroke(stroke)
     {
+        this->id = id;
     }
 
     /**
@@ -111,7 +299,7 @@ namespace svg
      */
     void Polyline::draw(PNGImage &img) const
     {
-        for (size_t i = 0; i < points.size() - 1; i++)
+        for (size_t i = 0; i + 1 < points.size(); i++)
         {
             img.draw_line(points[i], points[i + 1], stroke);
         }
@@ -124,9 +312,7 @@ namespace svg
      */
     void Polyline::translate(const Point &t)
     {
-        for (size_t i = 0; i < points.size(); i++) {
-            points[i] = points[i].translate(t);
-        }
+        translatePoints(points.data(), points.size(), t);
     }
 
     /**
@@ -137,10 +323,7 @@ namespace svg
      */
     void Polyline::rotate(const Point &origin, int degrees)
     {
-        for (size_t i = 0; i < points.size(); i++)
-        {
-            points[i] = points[i].rotate(origin, degrees);
-        }
+        rotatePoints(points.data(), points.size(), origin, degrees);
     }
 
     /**
@@ -151,86 +334,232 @@ namespace svg
      */
     void Polyline::scale(const Point &origin, int v)
     {
-        for (size_t i = 0; i < points.size(); i++)
-        {
-            points[i] = points[i].scale(origin, v);
-        }
+        scalePoints(points.data(), points.size(), origin, v);
     }
 
     /**
      * @brief Creates a copy of the Polyline object.
      * 
-     * @return A pointer to the copied Polyline object.
+     * @return An owning pointer to the copied Polyline object.
      */
-    SVGElement* Polyline::copy() const{
-        return new Polyline(points,stroke,id);
+    std::unique_ptr<SVGElement> Polyline::copy() const{
+        return std::unique_ptr<SVGElement>(new Polyline(*this));
     }
 
     /**
-     * @brief Draws a line on the given PNGImage.
+     * @brief Copies another polyline (or an element derived from it) into this one.
      *
-     * @param img The PNGImage to draw the line on.
+     * Point storage is reused when it is large enough.
+     *
+     * @param other The element to copy, of the same type as this one.
      */
-    void Line::draw(PNGImage &img) const
+    void Polyline::assign(const SVGElement &other)
     {
-        img.draw_line(start, end, stroke);
+        *this = static_cast<const Polyline &>(other);
     }
 
     /**
-     * @brief Translates the points of the line by the given translation vector.
+     * @brief Appends the polyline to a scene file.
      *
-     * @param t The translation vector.
+     * @param out The scene being written.
      */
-    void Line::translate(const Point &t)
+    void Polyline::compile(SceneWriter &out) const
     {
-        start = start.translate(t);
-        end = end.translate(t);
+        SceneRecord record = SceneRecord();
+        record.type = (uint8_t)SceneRecordType::Polyline;
+        record.stroke = stroke;
+        out.add(record, id, points.data(), points.size());
     }
 
     /**
-     * @brief Rotates the line around a specified origin by a given number of degrees.
+     * @brief Adds the work of drawing the polyline on a canvas.
      *
-     * @param origin The origin point around which the line will be rotated.
-     * @param degrees The number of degrees by which the line will be rotated.
+     * @param canvas The pixels of the image.
+     * @param total The cost to increase.
      */
-    void Line::rotate(const Point &origin, int degrees)
+    void Polyline::cost(const Box &canvas, RenderCost &total) const
     {
-        start = start.rotate(origin, degrees);
-        end = end.rotate(origin, degrees);
+        addVertices(points, total);
+        addLines(points, false, canvas, total);
     }
 
     /**
-     * @brief Scales the line by a given factor around a specified origin point.
+     * @brief Divides the points of the polyline, rounding down.
      *
-     * @param origin The origin point around which the line will be scaled.
-     * @param v The scaling factor.
+     * @param v The divisor.
      */
-    void Line::scale(const Point &origin, int v)
+    void Polyline::shrink(int v)
     {
-        start = start.scale(origin, v);
-        end = end.scale(origin, v);
+        shrinkPoints(points, v);
+    }
+
+    /**
+     * @brief Computes the box enclosing the points of the polyline.
+     *
+     * @return The bounding box (empty if the polyline draws nothing).
+     */
+    Box Polyline::bounds() const
+    {
+        Box box;
+        extendBounds(points, box);
+        return box;
+    }
+
+    /**
+     * @brief Drops vertices that do not change the rendered polyline.
+     *
+     * @param tolerance Maximum distance, in pixels, of a dropped vertex.
+     */
+    void Polyline::simplify(double tolerance)
+    {
+        points = svg::simplify(points, tolerance, false);
+    }
+
+    /**
+     * @brief Checks if the polyline has no points.
+     *
+     * @return True if drawing the polyline has no effect.
+     */
+    bool Polyline::empty() const
+    {
+        return points.empty();
+    }
+
+    /**
+     * @brief Draws a line on the given PNGImage.
+     *
+     * @param img The PNGImage to draw the line on.
+     */
+    void Line::draw(PNGImage &img) const
+    {
+        img.draw_line(points[0], points[1], stroke);
     }
 
     /**
      * @brief Creates a copy of the Line object.
      * 
-     * @return A pointer to the copied Line object.
+     * @return An owning pointer to the copied Line object.
      */
-    SVGElement* Line::copy() const{
-        return new Line(start,end,stroke,id);
+    std::unique_ptr<SVGElement> Line::copy() const{
+        return std::unique_ptr<SVGElement>(new Line(*this));
     }
 
     /**
      * @brief Constructs a Polygon object with the specified points and fill color.
      * 
-     * @param points The vector of points that define the polygon.
+     * @param points The points that define the polygon (taken over, not copied).
      * @param fill The fill color of the polygon.
      */
-    Polygon::Polygon(const std::vector<Point> &points, 
+    Polygon::Polygon(PointVector points, 
                      const Color &fill, 
-                     const std::string &id)
-        : points(points), fill(fill)
+                     const std::string &id,
+                     FillRule rule)
+        : points(std::move(points)), fill(fill), rule(rule)
+    {
+        this->id = id;
+        classify();
+    }
+
+    /**
+     * @brief Checks if four points are the corners of a rectangle with sides parallel to the axes, in order.
+     *
+     * @param points The points.
+     * @param n The number of points.
+     * @return True for such a rectangle (which draw_rect fills from points[0] to points[2]).
+     */
+    bool isAxisRect(const Point *points, size_t n)
+    {
+        return n == 4 &&
+               ((points[0].y == points[1].y && points[1].x == points[2].x &&
+                 points[2].y == points[3].y && points[3].x == points[0].x) ||
+                (points[0].x == points[1].x && points[1].y == points[2].y &&
+                 points[2].x == points[3].x && points[3].y == points[0].y));
+    }
+
+    /**
+     * @brief Checks if a polygon can be filled with the two-edge walker of draw_convex_polygon.
+     *
+     * A polygon is convex when, ignoring repeated points, all its turns have
+     * the same direction, it never doubles back on itself, and its edges go
+     * down and up only once (which rules out star-shaped polygons).
+     *
+     * @param points The vertices of the polygon.
+     * @param n The number of vertices.
+     * @return True if the polygon is convex.
+     */
+    bool isConvex(const Point *points, size_t n)
     {
+        // Edges of zero length are skipped; the first pass finds the last edge.
+        size_t edges = 0;
+        Point last = {0, 0};
+        int last_dy = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            Point a = points[i];
+            Point b = points[(i + 1) % n];
+            if (a.x != b.x || a.y != b.y)
+            {
+                edges++;
+                last = {b.x - a.x, b.y - a.y};
+                if (last.y != 0)
+                {
+                    last_dy = last.y > 0 ? 1 : -1;
+                }
+            }
+        }
+        if (edges < 3)
+        {
+            return false;
+        }
+        int turn = 0;
+        int y_changes = 0;
+        Point e = last;
+        for (size_t i = 0; i < n; i++)
+        {
+            Point a = points[i];
+            Point b = points[(i + 1) % n];
+            if (a.x == b.x && a.y == b.y)
+            {
+                continue;
+            }
+            Point f = {b.x - a.x, b.y - a.y};
+            int64_t cross = (int64_t)e.x * f.y - (int64_t)e.y * f.x;
+            int64_t dot = (int64_t)e.x * f.x + (int64_t)e.y * f.y;
+            if (cross == 0 && dot < 0)
+            {
+                return false;
+            }
+            int side = cross > 0 ? 1 : (cross < 0 ? -1 : 0);
+            if (side != 0)
+            {
+                if (turn != 0 && side != turn)
+                {
+                    return false;
+                }
+                turn = side;
+            }
+            if (f.y != 0)
+            {
+                int dy = f.y > 0 ? 1 : -1;
+                if (dy != last_dy)
+                {
+                    y_changes++;
+                }
+                last_dy = dy;
+            }
+            e = f;
+        }
+        return y_changes <= 2;
+    }
+
+    /**
+     * @brief Chooses how the polygon is rasterized from its current points.
+     */
+    void Polygon::classify()
+    {
+        shape = isAxisRect(points.data(), points.size()) ? Shape::AxisRect
+                : isConvex(points.data(), points.size()) ? Shape::Convex
+                                                         : Shape::General;
     }
 
     /**
@@ -240,7 +569,18 @@ namespace svg
      */
     void Polygon::draw(PNGImage &img) const
     {
-        img.draw_polygon(points, fill);
+        switch (shape)
+        {
+        case Shape::AxisRect:
+            img.draw_rect(points[0], points[2], fill);
+            break;
+        case Shape::Convex:
+            img.draw_convex_polygon(points, fill);
+            break;
+        default:
+            img.draw_polygon(points, fill, rule);
+            break;
+        }
     }
 
     /**
@@ -250,10 +590,7 @@ namespace svg
      */
     void Polygon::translate(const Point &t)
     {
-        for (size_t i = 0; i < points.size(); i++)
-        {
-            points[i] = points[i].translate(t);
-        }
+        translatePoints(points.data(), points.size(), t);
     }
 
     /**
@@ -264,10 +601,8 @@ namespace svg
      */
     void Polygon::rotate(const Point &origin, int degrees)
     {
-        for (size_t i = 0; i < points.size(); i++)
-        {
-            points[i] = points[i].rotate(origin, degrees);
-        }
+        rotatePoints(points.data(), points.size(), origin, degrees);
+        classify();
     }
 
     /**
@@ -278,19 +613,110 @@ namespace svg
      */
     void Polygon::scale(const Point &origin, int v)
     {
-        for (size_t i = 0; i < points.size(); i++)
-        {
-            points[i] = points[i].scale(origin, v);
-        }
+        scalePoints(points.data(), points.size(), origin, v);
+        classify();
     }
 
     /**
      * @brief Creates a copy of the Polygon object.
      * 
-     * @return A pointer to the copied Ellipse object.
+     * @return An owning pointer to the copied Polygon object.
+     */
+    std::unique_ptr<SVGElement> Polygon::copy() const{
+        return std::unique_ptr<SVGElement>(new Polygon(*this));
+    }
+
+    /**
+     * @brief Copies another polygon (or an element derived from it) into this one.
+     *
+     * Point storage is reused when it is large enough.
+     *
+     * @param other The element to copy, of the same type as this one.
      */
-    SVGElement* Polygon::copy() const{
-        return new Polygon(points,fill,id);
+    void Polygon::assign(const SVGElement &other)
+    {
+        *this = static_cast<const Polygon &>(other);
+    }
+
+    /**
+     * @brief Appends the polygon, with its rasterization strategy, to a scene file.
+     *
+     * @param out The scene being written.
+     */
+    void Polygon::compile(SceneWriter &out) const
+    {
+        SceneRecord record = SceneRecord();
+        record.type = (uint8_t)SceneRecordType::Polygon;
+        record.flags = shape == Shape::AxisRect ? SCENE_AXIS_RECT
+                       : shape == Shape::Convex ? SCENE_CONVEX
+                                                : 0;
+        if (rule == FillRule::EvenOdd)
+        {
+            record.flags |= SCENE_EVEN_ODD;
+        }
+        record.fill = fill;
+        out.add(record, id, points.data(), points.size());
+    }
+
+    /**
+     * @brief Adds the work of filling the polygon on a canvas.
+     *
+     * @param canvas The pixels of the image.
+     * @param total The cost to increase.
+     */
+    void Polygon::cost(const Box &canvas, RenderCost &total) const
+    {
+        addVertices(points, total);
+        total.edges += points.size();
+        total.pixels += coveredPixels(bounds(), canvas);
+    }
+
+    /**
+     * @brief Divides the points of the polygon, rounding down.
+     *
+     * @param v The divisor.
+     */
+    void Polygon::shrink(int v)
+    {
+        shrinkPoints(points, v);
+        classify();
+    }
+
+    /**
+     * @brief Computes the box enclosing the points of the polygon.
+     *
+     * @return The bounding box (empty if the polygon draws nothing).
+     */
+    Box Polygon::bounds() const
+    {
+        Box box;
+        extendBounds(points, box);
+        return box;
+    }
+
+    /**
+     * @brief Drops vertices that do not change the rendered polygon.
+     *
+     * @param tolerance Maximum distance, in pixels, of a dropped vertex.
+     */
+    void Polygon::simplify(double tolerance)
+    {
+        if (shape == Shape::AxisRect)
+        {
+            return;
+        }
+        points = svg::simplify(points, tolerance, true);
+        classify();
+    }
+
+    /**
+     * @brief Checks if the polygon has no points.
+     *
+     * @return True if drawing the polygon has no effect.
+     */
+    bool Polygon::empty() const
+    {
+        return points.empty();
     }
 
     /**
@@ -300,16 +726,347 @@ namespace svg
      */
     void Rect::draw(PNGImage &img) const
     {
-        img.draw_polygon(points, fill);
+        Polygon::draw(img);
     }
 
     /**
      * @brief Creates a copy of the Rectangle object.
      * 
-     * @return A pointer to the copied Rectangle object.
+     * @return An owning pointer to the copied Rectangle object.
+     */
+    std::unique_ptr<SVGElement> Rect::copy() const {
+        return std::unique_ptr<SVGElement>(new Rect(*this));
+    }
+
+    /**
+     * @brief Absorbs a rectangle drawn right after this one, if the two
+     * have the same color and together form a single rectangle.
+     *
+     * Both rectangles must be aligned with the axes and either span the same
+     * rows and touch or overlap horizontally, or span the same columns and
+     * touch or overlap vertically. The block fill of the result covers
+     * exactly the pixels of both (anti-aliased rendering does not).
+     *
+     * @param other The rectangle drawn next.
+     * @return True if other was absorbed and no longer needs to be drawn.
+     */
+    bool Rect::merge(const Rect &other)
+    {
+        if (shape != Shape::AxisRect || other.shape != Shape::AxisRect ||
+            fill.red != other.fill.red || fill.green != other.fill.green ||
+            fill.blue != other.fill.blue)
+        {
+            return false;
+        }
+        int x0 = std::min(points[0].x, points[2].x), x1 = std::max(points[0].x, points[2].x);
+        int y0 = std::min(points[0].y, points[2].y), y1 = std::max(points[0].y, points[2].y);
+        int ox0 = std::min(other.points[0].x, other.points[2].x), ox1 = std::max(other.points[0].x, other.points[2].x);
+        int oy0 = std::min(other.points[0].y, other.points[2].y), oy1 = std::max(other.points[0].y, other.points[2].y);
+        bool rows = y0 == oy0 && y1 == oy1 && ox0 <= x1 + 1 && ox1 >= x0 - 1;
+        bool columns = x0 == ox0 && x1 == ox1 && oy0 <= y1 + 1 && oy1 >= y0 - 1;
+        if (!rows && !columns)
+        {
+            return false;
+        }
+        x0 = std::min(x0, ox0);
+        x1 = std::max(x1, ox1);
+        y0 = std::min(y0, oy0);
+        y1 = std::max(y1, oy1);
+        points = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+        classify();
+        return true;
+    }
+
+    /**
+     * @brief Constructs a Path object from its flattened subpaths.
+     * 
+     * @param exact The unrounded points of each subpath.
+     * @param closed Whether each subpath was closed.
+     * @param fill The fill color of the path.
+     * @param filled Whether the path is filled.
+     * @param rule The fill rule.
+     * @param stroke The stroke color of the path.
+     * @param stroked Whether the path is stroked.
+     */
+    Path::Path(std::vector<std::vector<PathPoint>> exact,
+               std::vector<bool> closed,
+               const Color &fill,
+               bool filled,
+               FillRule rule,
+               const Color &stroke,
+               bool stroked,
+               const std::string &id)
+        : exact(std::move(exact)), closed(std::move(closed)), fill(fill), filled(filled), rule(rule),
+          stroke(stroke), stroked(stroked)
+    {
+        this->id = id;
+        round();
+    }
+
+    /**
+     * @brief Rounds the unrounded points to the pixel grid.
+     *
+     * Consecutive points that round to the same position are merged.
+     */
+    void Path::round()
+    {
+        contours.assign(exact.size(), PointVector());
+        for (size_t k = 0; k < exact.size(); k++)
+        {
+            PointVector &contour = contours[k];
+            for (const PathPoint &p : exact[k])
+            {
+                Point q = {(int)std::lround(p.x), (int)std::lround(p.y)};
+                if (contour.empty() || contour.back().x != q.x || contour.back().y != q.y)
+                {
+                    contour.push_back(q);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Draws the path on the given PNGImage.
+     * 
+     * The interior is filled first (every subpath is implicitly closed),
+     * then the outline of each subpath is drawn if the path is stroked.
+     *
+     * @param img The PNGImage to draw the path on.
+     */
+    void Path::draw(PNGImage &img) const
+    {
+        if (filled)
+        {
+            img.draw_polygon(contours, fill, rule);
+        }
+        if (stroked)
+        {
+            for (size_t k = 0; k < contours.size(); k++)
+            {
+                const PointVector &points = contours[k];
+                for (size_t i = 0; i + 1 < points.size(); i++)
+                {
+                    img.draw_line(points[i], points[i + 1], stroke);
+                }
+                if (closed[k] && !points.empty())
+                {
+                    img.draw_line(points.back(), points.front(), stroke);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Translates the points of the path by the given translation vector.
+     *
+     * @param t The translation vector.
+     */
+    void Path::translate(const Point &t)
+    {
+        if (exact.empty())
+        {
+            for (PointVector &points : contours)
+            {
+                translatePoints(points.data(), points.size(), t);
+            }
+            return;
+        }
+        for (std::vector<PathPoint> &points : exact)
+        {
+            for (PathPoint &p : points)
+            {
+                p.x += t.x;
+                p.y += t.y;
+            }
+        }
+        round();
+    }
+
+    /**
+     * @brief Rotates the path around a specified origin by a given number of degrees.
+     *
+     * @param origin The origin point around which the path will be rotated.
+     * @param degrees The number of degrees by which the path will be rotated.
+     */
+    void Path::rotate(const Point &origin, int degrees)
+    {
+        if (exact.empty())
+        {
+            for (PointVector &points : contours)
+            {
+                rotatePoints(points.data(), points.size(), origin, degrees);
+            }
+            return;
+        }
+        double angle = M_PI * degrees / 180.0;
+        double s = std::sin(angle);
+        double c = std::cos(angle);
+        for (std::vector<PathPoint> &points : exact)
+        {
+            for (PathPoint &p : points)
+            {
+                double dx = p.x - origin.x;
+                double dy = p.y - origin.y;
+                p = {origin.x + c * dx - s * dy, origin.y + s * dx + c * dy};
+            }
+        }
+        round();
+    }
+
+    /**
+     * @brief Scales the path by a given factor around a specified origin point.
+     *
+     * @param origin The origin point around which the path will be scaled.
+     * @param v The scaling factor.
+     */
+    void Path::scale(const Point &origin, int v)
+    {
+        if (exact.empty())
+        {
+            for (PointVector &points : contours)
+            {
+                scalePoints(points.data(), points.size(), origin, v);
+            }
+            return;
+        }
+        for (std::vector<PathPoint> &points : exact)
+        {
+            for (PathPoint &p : points)
+            {
+                p = {origin.x + (p.x - origin.x) * v, origin.y + (p.y - origin.y) * v};
+            }
+        }
+        round();
+    }
+
+    /**
+     * @brief Creates a copy of the Path object.
+     * 
+     * @return An owning pointer to the copied Path object.
+     */
+    std::unique_ptr<SVGElement> Path::copy() const{
+        return std::unique_ptr<SVGElement>(new Path(*this));
+    }
+
+    /**
+     * @brief Copies another path (or an element derived from it) into this one.
+     *
+     * Point storage is reused when it is large enough.
+     *
+     * @param other The element to copy, of the same type as this one.
+     */
+    void Path::assign(const SVGElement &other)
+    {
+        *this = static_cast<const Path &>(other);
+    }
+
+    /**
+     * @brief Appends the path to a scene file.
+     *
+     * @param out The scene being written.
+     */
+    void Path::compile(SceneWriter &out) const
+    {
+        SceneRecord record = SceneRecord();
+        record.type = (uint8_t)SceneRecordType::Path;
+        record.flags = (filled ? SCENE_FILLED : 0) | (stroked ? SCENE_STROKED : 0) |
+                       (rule == FillRule::EvenOdd ? SCENE_EVEN_ODD : 0);
+        record.fill = fill;
+        record.stroke = stroke;
+        out.add(record, id, contours, closed);
+    }
+
+    /**
+     * @brief Adds the work of filling and stroking the path on a canvas.
+     *
+     * @param canvas The pixels of the image.
+     * @param total The cost to increase.
+     */
+    void Path::cost(const Box &canvas, RenderCost &total) const
+    {
+        for (size_t k = 0; k < contours.size(); k++)
+        {
+            addVertices(contours[k], total);
+            if (filled)
+            {
+                total.edges += contours[k].size();
+            }
+            if (stroked)
+            {
+                addLines(contours[k], closed[k], canvas, total);
+            }
+        }
+        if (filled)
+        {
+            total.pixels += coveredPixels(bounds(), canvas);
+        }
+    }
+
+    /**
+     * @brief Divides the points of the path, rounding down.
+     *
+     * @param v The divisor.
+     */
+    void Path::shrink(int v)
+    {
+        exact.clear();
+        for (PointVector &points : contours)
+        {
+            shrinkPoints(points, v);
+        }
+    }
+
+    /**
+     * @brief Computes the box enclosing the points of the path.
+     *
+     * @return The bounding box (empty if the path draws nothing).
+     */
+    Box Path::bounds() const
+    {
+        Box box;
+        if (!empty())
+        {
+            for (const PointVector &contour : contours)
+            {
+                extendBounds(contour, box);
+            }
+        }
+        return box;
+    }
+
+    /**
+     * @brief Drops subpath vertices that do not change the rendered path.
+     *
+     * @param tolerance Maximum distance, in pixels, of a dropped vertex.
      */
-    SVGElement* Rect::copy() const {
-        return new Rect(points, fill, id);
+    void Path::simplify(double tolerance)
+    {
+        exact.clear();
+        for (size_t i = 0; i < contours.size(); i++)
+        {
+            contours[i] = svg::simplify(contours[i], tolerance, closed[i] || (filled && !stroked));
+        }
+    }
+
+    /**
+     * @brief Checks if the path is neither filled nor stroked, or has no points.
+     *
+     * @return True if drawing the path has no effect.
+     */
+    bool Path::empty() const
+    {
+        if (!filled && !stroked)
+        {
+            return true;
+        }
+        for (const PointVector &contour : contours)
+        {
+            if (!contour.empty())
+            {
+                return false;
+            }
+        }
+        return true;
     }
 
     /**
@@ -319,7 +1076,7 @@ namespace svg
      */
     void Group::draw(PNGImage &img) const
     {
-        for (auto y : V ){
+        for (const auto &y : V ){
             y->draw(img);
         }
     }
@@ -331,7 +1088,7 @@ namespace svg
      */
     void Group::translate(const Point &t)
     {
-        for (auto y : V ){
+        for (const auto &y : V ){
             y->translate(t);
         }
     }
@@ -344,7 +1101,7 @@ namespace svg
      */
     void Group::rotate(const Point &origin, int degrees)
     {
-        for (auto y : V ){
+        for (const auto &y : V ){
             y->rotate(origin,degrees);
         }
     }
@@ -357,35 +1114,120 @@ namespace svg
      */
     void Group::scale(const Point &origin, int v)
     {
-        for (auto y : V ){
+        for (const auto &y : V ){
             y->scale(origin,v);
         }
     }
 
 
     /**
-     * @brief Destructor for the Group class.
+     * @brief Creates a deep copy of the Group object.
      * 
-     * This destructor is responsible for freeing the memory allocated for the objects
-     * stored in the `V` vector.
+     * @return An owning pointer to the newly created Group object.
      */
-    Group::~Group()
+    std::unique_ptr<SVGElement> Group::copy() const{
+        std::vector<std::unique_ptr<SVGElement>> temp;
+        temp.reserve(V.size());
+        for (const auto &y : V ){
+            temp.push_back(y->copy());
+        }
+        std::unique_ptr<SVGElement> g(new Group(std::move(temp)));
+        g->id = id;
+        return g;
+    }
+
+    /**
+     * @brief Copies another group with the same structure into this one, element by element.
+     *
+     * @param other The group to copy, built as a copy of this one.
+     */
+    void Group::assign(const SVGElement &other)
     {
-        for (auto y : V ){
-            delete y;
+        const Group &g = static_cast<const Group &>(other);
+        for (size_t i = 0; i < V.size(); i++)
+        {
+            V[i]->assign(*g.V[i]);
         }
+        id = g.id;
     }
 
     /**
-     * @brief Creates a deep copy of the Group object.
-     * 
-     * @return A pointer to the newly created Group object.
+     * @brief Computes the box enclosing all elements of the group.
+     *
+     * @return The bounding box (empty if the group draws nothing).
      */
-    SVGElement* Group::copy() const{
-        std::vector<SVGElement*> temp;
-        for (auto y : V ){
-            temp.push_back(y->copy());
+    Box Group::bounds() const
+    {
+        Box box;
+        for (const auto &y : V ){
+            box.extend(y->bounds());
+        }
+        return box;
+    }
+
+    /**
+     * @brief Appends the group and its elements to a scene file.
+     *
+     * @param out The scene being written.
+     */
+    void Group::compile(SceneWriter &out) const
+    {
+        out.begin_group(id);
+        for (const auto &y : V ){
+            y->compile(out);
+        }
+        out.end_group();
+    }
+
+    /**
+     * @brief Adds the work of drawing the elements of the group on a canvas.
+     *
+     * @param canvas The pixels of the image.
+     * @param total The cost to increase.
+     */
+    void Group::cost(const Box &canvas, RenderCost &total) const
+    {
+        for (const auto &y : V ){
+            y->cost(canvas, total);
+        }
+    }
+
+    /**
+     * @brief Divides the coordinates of the elements of the group, rounding down.
+     *
+     * @param v The divisor.
+     */
+    void Group::shrink(int v)
+    {
+        for (const auto &y : V ){
+            y->shrink(v);
+        }
+    }
+
+    /**
+     * @brief Simplifies every element of the group.
+     *
+     * @param tolerance Maximum distance, in pixels, of a dropped vertex.
+     */
+    void Group::simplify(double tolerance)
+    {
+        for (const auto &y : V ){
+            y->simplify(tolerance);
+        }
+    }
+
+    /**
+     * @brief Checks if the group only contains empty elements.
+     *
+     * @return True if drawing the group has no effect.
+     */
+    bool Group::empty() const
+    {
+        for (const auto &y : V ){
+            if (!y->empty()){
+                return false;
+            }
         }
-        return new Group(temp);
+        return true;
     }
-}
+}
\ No newline at end of file
@@ -3,32 +3,211 @@
 #define __svg_SVGElements_hpp__
 
 #include "Color.hpp"
+#include "MemoryStats.hpp"
 #include "Point.hpp"
 #include "PNGImage.hpp"
+#include "PointVector.hpp"
+
+#include <cstdint>
+#include <memory>
+
+namespace tinyxml2
+{
+    class XMLDocument;
+    class XMLElement;
+}
 
 namespace svg
 {
+    class SceneWriter;
+    struct RenderCost;
+
     class SVGElement
     {
 
     public:
         SVGElement();
+        SVGElement(const SVGElement &other) = default;
+        SVGElement(SVGElement &&other) = default;
+        SVGElement &operator=(const SVGElement &other) = default;
+        SVGElement &operator=(SVGElement &&other) = default;
         virtual ~SVGElement();
         virtual void draw(PNGImage &img) const = 0;                     // Declaration of the draw virtual pure function for each SVG element.
-        virtual void translate(const Point &t) = 0;                     // Declaration of the translate virtual pure function for each SVG element.
+        virtual void translate(const Point &t) = 0;                     // Declaration of the translate virtual pure function for each SVG element (an index holding the element then needs SpatialIndex::update()).
         virtual void rotate(const Point &origin, 
-                             int degrees) = 0;                          // Declaration of the rotate virtual pure function for each SVG element.
+                             int degrees) = 0;                          // Declaration of the rotate virtual pure function for each SVG element (then SpatialIndex::update()).
         virtual void scale(const Point &origin, 
-                            int v) = 0;                                 // Declaration of the scale virtual pure function for each SVG element.
-        virtual SVGElement* copy() const = 0;                           // Declaration of the translate virtual pure function for each SVG element.
+                            int v) = 0;                                 // Declaration of the scale virtual pure function for each SVG element (then SpatialIndex::update()).
+        virtual std::unique_ptr<SVGElement> copy() const = 0;           // Declaration of the copy virtual pure function for each SVG element.
+        virtual void assign(const SVGElement &other) = 0;               // Declaration of the assign virtual pure function (copies an element of the same type and structure, reusing storage; then SpatialIndex::update()).
+        virtual void simplify(double tolerance);                        // Declaration of the simplify virtual function (does nothing by default; then SpatialIndex::update()).
+        virtual bool empty() const;                                     // Declaration of the empty virtual function (true if drawing has no effect).
+        virtual Box bounds() const = 0;                                 // Declaration of the bounds virtual pure function (pixels the element may draw).
+        virtual void compile(SceneWriter &out) const = 0;               // Declaration of the compile virtual pure function (appends the element to a scene file).
+        virtual void cost(const Box &canvas,
+                          RenderCost &total) const = 0;                 // Declaration of the cost virtual pure function (adds the work of drawing the element on canvas).
+        virtual void shrink(int v) = 0;                                 // Declaration of the shrink virtual pure function (divides coordinates by v, rounding down; then SpatialIndex::update()).
         std::string id;
     };
 
+    //! Estimated work and memory of drawing a scene (see estimateCost()).
+    struct RenderCost
+    {
+        //! Pixels within the bounds of filled elements, plus the length of
+        //! lines, clipped to the image.
+        uint64_t pixels = 0;
+        //! Polygon, path and line segments.
+        uint64_t edges = 0;
+        //! Vertices stored by the scene.
+        uint64_t vertices = 0;
+        //! Memory for the image and the vertices (bytes).
+        uint64_t bytes = 0;
+    };
+
+    //! What to do with a document whose estimated cost exceeds its budget.
+    enum class BudgetPolicy
+    {
+        Reject,    // Throw BudgetExceeded without drawing.
+        Downscale, // Render at 1/2, 1/4, ... of the size until the cost fits.
+        Truncate   // Draw the elements that fit, then throw BudgetExceeded.
+    };
+
+    //! Limits on the estimated cost of a document (0: no limit).
+    struct RenderBudget
+    {
+        //! Limit on RenderCost::pixels.
+        uint64_t max_pixels = 0;
+        //! Limit on RenderCost::edges.
+        uint64_t max_edges = 0;
+        //! Limit on RenderCost::vertices.
+        uint64_t max_vertices = 0;
+        //! Limit on RenderCost::bytes.
+        uint64_t max_bytes = 0;
+        //! What to do when a limit is exceeded.
+        BudgetPolicy policy = BudgetPolicy::Reject;
+    };
+
+    //! Options that control how convert() renders a document.
+    struct RenderOptions
+    {
+        //! Use anti-aliased rendering for polygons and ellipses.
+        bool antialias = false;
+        //! Simplify the element tree with optimizeScene before drawing.
+        bool optimize = true;
+        //! Drop polyline, polygon and path vertices that do not change the
+        //! rendered result at the output resolution.
+        bool simplify = false;
+        //! Maximum distance (in output pixels) of a dropped vertex.
+        double simplify_tolerance = 0.5;
+        //! Collect the spans of all elements and write each pixel once
+        //! (ignored with anti-aliasing).
+        bool span_buffer = false;
+        //! Number of threads used to render several frames (0: one per core).
+        unsigned threads = 0;
+        //! Token checked between elements while parsing and between
+        //! scanlines while drawing (not owned; nullptr: never cancelled).
+        const CancellationToken *cancel = nullptr;
+        //! Limits checked after parsing, before the image is allocated
+        //! (scene files that exceed them are rejected whatever the policy).
+        RenderBudget budget;
+        //! Count the allocations of each phase of convert() and render()
+        //! into RenderStats::memory.
+        bool track_memory = false;
+    };
+
+    //! Transform applied to every frame rendered by renderFrames().
+    //! Frame k (counting from 0) is translated by k * translate, then rotated
+    //! by k * rotate degrees and, if scale is not 0, scaled by 1 + k * scale,
+    //! both around origin.
+    struct FrameTransform
+    {
+        //! Id of the elements to transform (empty for the whole document).
+        std::string id;
+        //! Translation per frame.
+        Point translate = {0, 0};
+        //! Rotation per frame, in degrees.
+        int rotate = 0;
+        //! Increase of the scaling factor per frame.
+        int scale = 0;
+        //! Origin of rotation and scaling.
+        Point origin = {0, 0};
+    };
+
+    //! Size of the element tree of a scene.
+    struct SceneStats
+    {
+        //! Number of groups.
+        size_t groups = 0;
+        //! Number of shapes (elements other than groups).
+        size_t shapes = 0;
+        //! Deepest nesting of groups.
+        size_t depth = 0;
+    };
+
+    //! Measurements taken while rendering a document.
+    struct RenderStats
+    {
+        //! Painted pixels per image pixel (only measured with a span buffer).
+        double overdraw = 0;
+        //! Scene as parsed.
+        SceneStats parsed;
+        //! Scene after optimizeScene (same as parsed if not optimized).
+        SceneStats optimized;
+        //! Estimated cost of the parsed document, at full size.
+        RenderCost cost;
+        //! Divisor of the output size chosen by BudgetPolicy::Downscale.
+        int downscale = 1;
+        //! Elements left out by BudgetPolicy::Truncate.
+        size_t truncated = 0;
+        //! Allocations per phase (only with RenderOptions::track_memory).
+        MemoryStats memory;
+    };
+
     void readSVG(const std::string &svg_file,
                  Point &dimensions,
-                 std::vector<SVGElement *> &svg_elements);              // Declaration of namespace function readSVG.
+                 std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                 const CancellationToken *cancel = nullptr);// Declaration of namespace function readSVG.
+    void readSVG(tinyxml2::XMLElement *root,
+                 Point &dimensions,
+                 std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                 const CancellationToken *cancel = nullptr);// Declaration of namespace function readSVG (for an already parsed document).
+    //! Largest size of a gzip-compressed document once inflated, by default (bytes).
+    const size_t MAX_INFLATED_SIZE = 256u << 20;
+    void loadXML(tinyxml2::XMLDocument &doc,
+                 const std::string &file,
+                 size_t max_inflated = MAX_INFLATED_SIZE);              // Declaration of namespace function loadXML (also reads gzip-compressed files, up to max_inflated bytes once inflated).
+    void parseXML(tinyxml2::XMLDocument &doc,
+                  const char *data,
+                  size_t size,
+                  const std::string &name,
+                  size_t max_inflated = MAX_INFLATED_SIZE);             // Declaration of namespace function parseXML (from memory, also gzip-compressed).
+    bool readsAsElement(const char *name);                              // Declaration of namespace function readsAsElement (true for the tags readSVG draws).
+    std::unique_ptr<SVGElement> readShape(const tinyxml2::XMLElement *elem,
+                                          int scale = 1);               // Declaration of namespace function readShape (one shape as readSVG creates it, null for groups and <use>).
+    void readTransform(SVGElement &element,
+                       const tinyxml2::XMLElement *elem);               // Declaration of namespace function readTransform (applies the transform attribute of elem).
+    int transformScale(const tinyxml2::XMLElement *elem);               // Declaration of namespace function transformScale (scaling factor of the transform attribute of elem).
+    bool isAxisRect(const Point *points, size_t n);                     // Declaration of namespace function isAxisRect (true for 4 corners of an axis-aligned rectangle, in order).
+    bool isConvex(const Point *points, size_t n);                       // Declaration of namespace function isConvex (true for polygons draw_convex_polygon fills).
+    void checkDimensions(const Point &dimensions,
+                         const std::string &name);                      // Declaration of namespace function checkDimensions (throws for sizes no image can be allocated with).
     void convert(const std::string &svg_file,
-                 const std::string &png_file);                          // Declaration of namespace function convert.
+                 const std::string &png_file,
+                 const RenderOptions &options = RenderOptions(),
+                 RenderStats *stats = nullptr);                         // Declaration of namespace function convert.
+    void render(const std::string &svg_file,
+                PNGImage &img,
+                const RenderOptions &options = RenderOptions(),
+                RenderStats *stats = nullptr);                          // Declaration of namespace function render (draws into an existing image or view).
+    void renderScene(std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                     PNGImage &img,
+                     const RenderOptions &options = RenderOptions(),
+                     RenderStats *stats = nullptr);                     // Declaration of namespace function renderScene (optimizes and draws parsed elements, replacing all pixels).
+    void renderFrames(const std::string &svg_file,
+                      const std::string &png_pattern,
+                      int frames,
+                      const std::vector<FrameTransform> &transforms,
+                      const RenderOptions &options = RenderOptions());  // Declaration of namespace function renderFrames (parses once, writes png_pattern with %d replaced by each frame number).
 
     /**
      * @class Ellipse
@@ -56,12 +235,19 @@ namespace svg
                      int degrees) override;                             // Declaration of the Ellipse's rotate function.
         void scale(const Point &origin, 
                     int v) override;                                    // Declaration of the Ellipse's scale function.
-        SVGElement* copy() const override;                              // Declaration of the Ellipse's copy function.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Ellipse's copy function.
+        void assign(const SVGElement &other) override;                  // Declaration of the Ellipse's assign function.
+        Box bounds() const override;                                    // Declaration of the Ellipse's bounds function.
+        void compile(SceneWriter &out) const override;                  // Declaration of the Ellipse's compile function.
+        void cost(const Box &canvas,
+                  RenderCost &total) const override;                    // Declaration of the Ellipse's cost function.
+        void shrink(int v) override;                                    // Declaration of the Ellipse's shrink function.
 
     protected:
         Color fill;     // The fill color of the ellipse.
         Point center;   // The center point of the ellipse.
         Point radius;   // The radius of the ellipse.
+        int orientation;// The rotation of the ellipse axes, in degrees.
     };
 
     /**
@@ -86,7 +272,8 @@ namespace svg
         : Ellipse(fill, center, {radius , radius}, id) { };
 
         void draw(PNGImage &img) const override;                        // Declaration of the Circle's draw function.
-        SVGElement* copy() const override;                              // Declaration of the Circle's copy function.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Circle's copy function.
+        void compile(SceneWriter &out) const override;                  // Declaration of the Circle's compile function.
     };
 
     /**
@@ -103,7 +290,7 @@ namespace svg
          * @param stroke The color of the polyline stroke.
          * @param id The id for the polyline.
          */
-        Polyline(const std::vector<Point> &points, 
+        Polyline(PointVector points, 
                  const Color &stroke, 
                  const std::string &id = "");
 
@@ -113,10 +300,18 @@ namespace svg
                      int degrees) override;                             // Declaration of the Polyline's rotate function.
         void scale(const Point &origin, 
                     int v) override;                                    // Declaration of the Polyline's scale function.
-        SVGElement* copy() const override;                              // Declaration of the Polyline's copy function.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Polyline's copy function.
+        void assign(const SVGElement &other) override;                  // Declaration of the Polyline's assign function.
+        Box bounds() const override;                                    // Declaration of the Polyline's bounds function.
+        void compile(SceneWriter &out) const override;                  // Declaration of the Polyline's compile function.
+        void cost(const Box &canvas,
+                  RenderCost &total) const override;                    // Declaration of the Polyline's cost function.
+        void shrink(int v) override;                                    // Declaration of the Polyline's shrink function.
+        void simplify(double tolerance) override;                       // Declaration of the Polyline's simplify function.
+        bool empty() const override;                                    // Declaration of the Polyline's empty function.
 
     protected:
-        std::vector<Point> points; // The vector of points that define the polyline.
+        PointVector points;        // The points that define the polyline.
         Color stroke;              // The color of the polyline stroke.
     };
 
@@ -139,19 +334,10 @@ namespace svg
              const Point &end, 
              const Color &stroke, 
              const std::string &id = "") 
-        : Polyline({start, end}, stroke, id), start(start), end(end) { };
+        : Polyline({start, end}, stroke, id) { };
 
         void draw(PNGImage &img) const override;                        // Declaration of the Line's draw function.
-        void translate(const Point &t) override;                        // Declaration of the Line's translate function.
-        void rotate(const Point &origin, 
-                     int degrees) override;                             // Declaration of the Line's rotate function.
-        void scale(const Point &origin, 
-                    int v) override;                                    // Declaration of the Line's scale function.
-        SVGElement* copy() const override;                              // Declaration of the Line's copy function.
-
-    private:
-        Point start;    // The starting point of the line.
-        Point end;      // The ending point of the line.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Line's copy function.
     };
 
     /**
@@ -167,10 +353,12 @@ namespace svg
          * @param points The vector of points that define the vertices of the polygon.
          * @param fill The fill color of the polygon.
          * @param id The id for the polygon.
+         * @param rule The fill rule for self-intersecting polygons.
          */
-        Polygon(const std::vector<Point> &points, 
+        Polygon(PointVector points, 
                 const Color &fill, 
-                const std::string &id = "");
+                const std::string &id = "",
+                FillRule rule = FillRule::EvenOdd);
 
         void draw(PNGImage &img) const override;                        // Declaration of the Polygon's draw function.
         void translate(const Point &t) override;                        // Declaration of the Polygon's translate function.
@@ -178,11 +366,33 @@ namespace svg
                      int degrees) override;                             // Declaration of the Polygon's rotate function.
         void scale(const Point &origin, 
                     int v) override;                                    // Declaration of the Polygon's scale function.
-        SVGElement* copy() const override;                              // Declaration of the Polygon's copy function.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Polygon's copy function.
+        void assign(const SVGElement &other) override;                  // Declaration of the Polygon's assign function.
+        Box bounds() const override;                                    // Declaration of the Polygon's bounds function.
+        void compile(SceneWriter &out) const override;                  // Declaration of the Polygon's compile function.
+        void cost(const Box &canvas,
+                  RenderCost &total) const override;                    // Declaration of the Polygon's cost function.
+        void shrink(int v) override;                                    // Declaration of the Polygon's shrink function.
+        void simplify(double tolerance) override;                       // Declaration of the Polygon's simplify function.
+        bool empty() const override;                                    // Declaration of the Polygon's empty function.
 
     protected:
-        std::vector<Point> points; // The vector of points that define the vertices of the polygon.
+        /**
+         * @brief Rasterization strategy for the points of a polygon.
+         */
+        enum class Shape
+        {
+            General,               // Any polygon, filled with the scanline under its fill rule.
+            Convex,                // Convex polygon, filled with a two-edge walker.
+            AxisRect               // Rectangle with sides parallel to the axes, filled as a block.
+        };
+
+        void classify();                                                // Declaration of the Polygon's classify function.
+
+        PointVector points;        // The points that define the vertices of the polygon.
         Color fill;                // The fill color of the polygon.
+        FillRule rule;             // The fill rule (matters only for self-intersecting polygons).
+        Shape shape;               // How the polygon is rasterized, updated whenever the points change.
     };
 
     /**
@@ -200,13 +410,93 @@ namespace svg
          * @param height The height of the rectangle.
          * @param fill The fill color of the rectangle.
          */
-        Rect(const std::vector<Point> &points, 
+        Rect(PointVector points, 
              const Color &fill, 
              const std::string &id = "") 
-        : Polygon(points, fill, id) { };
+        : Polygon(std::move(points), fill, id) { };
 
         void draw(PNGImage &img) const override;                        // Declaration of the Rectangle's draw function.
-        SVGElement* copy() const override;                              // Declaration of the Rectangle's copy function.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Rectangle's copy function.
+
+        /**
+         * @brief Absorbs a rectangle drawn right after this one, if the two
+         * have the same color and together form a single rectangle.
+         *
+         * @param other The rectangle drawn next.
+         * @return True if other was absorbed and no longer needs to be drawn.
+         */
+        bool merge(const Rect &other);
+    };
+
+    /**
+     * @struct PathPoint
+     * @brief A point with real coordinates, as produced by flattening path curves.
+     */
+    struct PathPoint
+    {
+        double x;
+        double y;
+    };
+
+    /**
+     * @class Path
+     * @brief Represents a path SVG element, flattened into line segments.
+     *
+     * The flattened points are kept unrounded while transforms are applied,
+     * so curves flattened for a scaled group stay smooth after scaling; the
+     * drawn contours are rounded from them after each transform.
+     */
+    class Path : public SVGElement
+    {
+    public:
+        /**
+         * @brief Constructs a Path object from its flattened subpaths.
+         * 
+         * @param exact The unrounded points of each subpath.
+         * @param closed Whether each subpath was closed.
+         * @param fill The fill color of the path.
+         * @param filled Whether the path is filled.
+         * @param rule The fill rule.
+         * @param stroke The stroke color of the path.
+         * @param stroked Whether the path is stroked.
+         * @param id The id of the path.
+         */
+        Path(std::vector<std::vector<PathPoint>> exact,
+             std::vector<bool> closed,
+             const Color &fill,
+             bool filled,
+             FillRule rule,
+             const Color &stroke,
+             bool stroked,
+             const std::string &id = "");
+
+        void draw(PNGImage &img) const override;                        // Declaration of the Path's draw function.
+        void translate(const Point &t) override;                        // Declaration of the Path's translate function.
+        void rotate(const Point &origin, 
+                     int degrees) override;                             // Declaration of the Path's rotate function.
+        void scale(const Point &origin, 
+                    int v) override;                                    // Declaration of the Path's scale function.
+        std::unique_ptr<SVGElement> copy() const override;              // Declaration of the Path's copy function.
+        void assign(const SVGElement &other) override;                  // Declaration of the Path's assign function.
+        Box bounds() const override;                                    // Declaration of the Path's bounds function.
+        void compile(SceneWriter &out) const override;                  // Declaration of the Path's compile function.
+        void cost(const Box &canvas,
+                  RenderCost &total) const override;                    // Declaration of the Path's cost function.
+        void shrink(int v) override;                                    // Declaration of the Path's shrink function.
+        void simplify(double tolerance) override;                       // Declaration of the Path's simplify function.
+        bool empty() const override;                                    // Declaration of the Path's empty function.
+
+    protected:
+        void round();                             // Rebuilds the contours from the unrounded points.
+
+        std::vector<std::vector<PathPoint>> exact; // The unrounded points of each subpath (empty once reduced).
+        std::vector<PointVector> contours;        // The points of each subpath, on the pixel grid.
+        std::vector<bool> closed;                 // Whether each subpath is closed.
+        Color fill;                               // The fill color of the path.
+        bool filled;                              // Whether the path is filled.
+        FillRule rule;                            // The fill rule of the path.
+        Color stroke;                             // The stroke color of the path.
+        bool stroked;                             // Whether the path is stroked.
     };
 
     /**
@@ -217,22 +507,36 @@ namespace svg
     {
     public:
     /**
-     * @brief Constructs a Group object with the given vector of SVGElement pointers.
+     * @brief Constructs a Group object that takes ownership of the given elements.
      * 
-     * @param VectorFigs The vector of SVGElement pointers to be stored in the Group.
+     * @param VectorFigs The elements to be stored in the Group.
+     */
+    Group(std::vector<std::unique_ptr<SVGElement>> VectorFigs) 
+    : V(std::move(VectorFigs)) {}
+    /**
+     * @brief Gets the elements of the group, in drawing order.
+     *
+     * @return The elements.
      */
-    Group(const std::vector<SVGElement*> &VectorFigs) 
-    : V(VectorFigs) {}
+    std::vector<std::unique_ptr<SVGElement>> &elements() { return V; }
+    const std::vector<std::unique_ptr<SVGElement>> &elements() const { return V; }
     void draw(PNGImage &img) const override;                            // Declaration of the Groups's draw function.
     void translate(const Point &t) override;                            // Declaration of the Groups's translate function.
     void rotate(const Point &origin,                                    
             int degrees) override;                                      // Declaration of the Groups's rotate function.
     void scale(const Point &origin, 
             int v) override;                                            // Declaration of the Groups's scale function.
-    ~Group();
-    SVGElement* copy() const override;                                  // Declaration of the Groups's copy function.
+    std::unique_ptr<SVGElement> copy() const override;                  // Declaration of the Groups's copy function.
+    void assign(const SVGElement &other) override;                      // Declaration of the Groups's assign function.
+    void simplify(double tolerance) override;                           // Declaration of the Groups's simplify function.
+    bool empty() const override;                                        // Declaration of the Groups's empty function.
+    Box bounds() const override;                                        // Declaration of the Groups's bounds function.
+    void compile(SceneWriter &out) const override;                      // Declaration of the Groups's compile function.
+    void cost(const Box &canvas,
+              RenderCost &total) const override;                        // Declaration of the Groups's cost function.
+    void shrink(int v) override;                                        // Declaration of the Groups's shrink function.
     private:
-        std::vector<SVGElement*> V;                    
+        std::vector<std::unique_ptr<SVGElement>> V;   // The elements of the group, in drawing order.
     };
 }
 #endif
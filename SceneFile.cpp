@@ -0,0 +1,431 @@
+//! @file SceneFile.cpp
+#include "SceneFile.hpp"
+#include "SceneOptimizer.hpp"
+#include "SVGElements.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace svg
+{
+    namespace
+    {
+        //! Start of every scene file.
+        struct SceneHeader
+        {
+            char magic[4];
+            uint32_t version;
+            int32_t width;
+            int32_t height;
+            uint32_t records;
+            uint32_t contours;
+            uint32_t vertices;
+            uint32_t strings;
+        };
+
+        const char SCENE_MAGIC[4] = {'S', 'V', 'G', 'S'};
+        const uint32_t SCENE_VERSION = 2;
+
+        static_assert(sizeof(SceneHeader) % 4 == 0 && sizeof(SceneRecord) % 4 == 0 &&
+                          sizeof(SceneContour) % 4 == 0,
+                      "scene file sections must keep 4-byte alignment");
+
+        /**
+         * @brief Counts the pixels of a box that lie on the canvas (as the element cost functions do).
+         */
+        uint64_t coveredPixels(const Box &box, const Box &canvas)
+        {
+            int64_t w = (int64_t)std::min(box.max.x, canvas.max.x) - std::max(box.min.x, canvas.min.x) + 1;
+            int64_t h = (int64_t)std::min(box.max.y, canvas.max.y) - std::max(box.min.y, canvas.min.y) + 1;
+            return w > 0 && h > 0 ? (uint64_t)w * (uint64_t)h : 0;
+        }
+
+        /**
+         * @brief Adds the cost of storing points and, if asked, of filling the box around them.
+         */
+        void addPoints(const Point *points, size_t n, bool fill, const Box &canvas, RenderCost &total)
+        {
+            total.vertices += n;
+            total.bytes += n * sizeof(Point);
+            if (fill)
+            {
+                Box box;
+                for (size_t i = 0; i < n; i++)
+                {
+                    box.extend(points[i]);
+                }
+                total.edges += n;
+                total.pixels += coveredPixels(box, canvas);
+            }
+        }
+
+        /**
+         * @brief Adds the cost of drawing the segments between consecutive points.
+         */
+        void addLines(const Point *points, size_t n, bool closed, const Box &canvas, RenderCost &total)
+        {
+            for (size_t i = 0; i + 1 < n || (closed && i + 1 == n && n > 1); i++)
+            {
+                const Point &a = points[i], &b = points[(i + 1) % n];
+                Box box;
+                box.extend(a);
+                box.extend(b);
+                int64_t length = std::max(std::llabs((int64_t)b.x - a.x), std::llabs((int64_t)b.y - a.y)) + 1;
+                total.pixels += std::min((uint64_t)length, coveredPixels(box, canvas));
+                total.edges++;
+            }
+        }
+    }
+
+    SceneWriter::SceneWriter()
+    {
+    }
+
+    uint32_t SceneWriter::intern(const std::string &s)
+    {
+        uint32_t offset = (uint32_t)strings_.size();
+        strings_ += s;
+        return offset;
+    }
+
+    void SceneWriter::add(SceneRecord record, const std::string &id, const Point *points, size_t n)
+    {
+        record.first = (uint32_t)vertices_.size();
+        record.count = (uint32_t)n;
+        record.id = intern(id);
+        record.id_length = (uint32_t)id.size();
+        vertices_.insert(vertices_.end(), points, points + n);
+        records_.push_back(record);
+    }
+
+    void SceneWriter::add(SceneRecord record, const std::string &id,
+                          const std::vector<PointVector> &contours, const std::vector<bool> &closed)
+    {
+        record.first = (uint32_t)contours_.size();
+        record.count = (uint32_t)contours.size();
+        record.id = intern(id);
+        record.id_length = (uint32_t)id.size();
+        for (size_t k = 0; k < contours.size(); k++)
+        {
+            contours_.push_back({(uint32_t)vertices_.size(), (uint32_t)contours[k].size(),
+                                 (uint32_t)(k < closed.size() && closed[k])});
+            vertices_.insert(vertices_.end(), contours[k].begin(), contours[k].end());
+        }
+        records_.push_back(record);
+    }
+
+    void SceneWriter::begin_group(const std::string &id)
+    {
+        SceneRecord record = SceneRecord();
+        record.type = (uint8_t)SceneRecordType::Group;
+        record.id = intern(id);
+        record.id_length = (uint32_t)id.size();
+        groups_.push_back(records_.size());
+        records_.push_back(record);
+    }
+
+    void SceneWriter::end_group()
+    {
+        size_t group = groups_.back();
+        groups_.pop_back();
+        records_[group].count = (uint32_t)(records_.size() - group - 1);
+    }
+
+    void SceneWriter::save(const std::string &scene_file, const Point &dimensions) const
+    {
+        SceneHeader header;
+        memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+        header.version = SCENE_VERSION;
+        header.width = dimensions.x;
+        header.height = dimensions.y;
+        header.records = (uint32_t)records_.size();
+        header.contours = (uint32_t)contours_.size();
+        header.vertices = (uint32_t)vertices_.size();
+        header.strings = (uint32_t)strings_.size();
+        std::ofstream out(scene_file, std::ios::binary);
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)records_.data(), records_.size() * sizeof(SceneRecord));
+        out.write((const char *)contours_.data(), contours_.size() * sizeof(SceneContour));
+        out.write((const char *)vertices_.data(), vertices_.size() * sizeof(Point));
+        out.write(strings_.data(), strings_.size());
+        if (!out)
+        {
+            throw std::runtime_error("Unable to write " + scene_file);
+        }
+    }
+
+    SceneFile::SceneFile(const std::string &scene_file)
+        : map_(MAP_FAILED), length_(0)
+    {
+        int fd = ::open(scene_file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Unable to load " + scene_file);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(SceneHeader))
+        {
+            length_ = (size_t)st.st_size;
+            map_ = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (map_ == MAP_FAILED)
+        {
+            throw std::runtime_error(scene_file + ": not a scene file");
+        }
+
+        const char *base = (const char *)map_;
+        const SceneHeader *header = (const SceneHeader *)base;
+        uint64_t records_at = sizeof(SceneHeader);
+        uint64_t contours_at = records_at + (uint64_t)header->records * sizeof(SceneRecord);
+        uint64_t vertices_at = contours_at + (uint64_t)header->contours * sizeof(SceneContour);
+        uint64_t strings_at = vertices_at + (uint64_t)header->vertices * sizeof(Point);
+        if (memcmp(header->magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0 ||
+            header->version != SCENE_VERSION ||
+            strings_at + header->strings != length_)
+        {
+            ::munmap(map_, length_);
+            throw std::runtime_error(scene_file + ": not a scene file");
+        }
+        dimensions_ = {header->width, header->height};
+        try
+        {
+            checkDimensions(dimensions_, scene_file);
+        }
+        catch (...)
+        {
+            ::munmap(map_, length_);
+            throw;
+        }
+        records_ = (const SceneRecord *)(base + records_at);
+        record_count_ = header->records;
+        contours_ = (const SceneContour *)(base + contours_at);
+        vertices_ = (const Point *)(base + vertices_at);
+        strings_ = base + strings_at;
+
+        // Check every range and rasterization flag once, so drawing needs no checks.
+        bool valid = true;
+        for (uint32_t k = 0; k < header->contours && valid; k++)
+        {
+            valid = (uint64_t)contours_[k].first + contours_[k].count <= header->vertices;
+        }
+        for (size_t i = 0; i < record_count_ && valid; i++)
+        {
+            const SceneRecord &r = records_[i];
+            uint64_t end = (uint64_t)r.first + r.count;
+            valid = (uint64_t)r.id + r.id_length <= header->strings;
+            switch ((SceneRecordType)r.type)
+            {
+            case SceneRecordType::Ellipse:
+                break;
+            case SceneRecordType::Polygon:
+                valid = valid && end <= header->vertices &&
+                        ((r.flags & SCENE_AXIS_RECT) == 0 || isAxisRect(vertices_ + r.first, r.count)) &&
+                        ((r.flags & SCENE_CONVEX) == 0 || isConvex(vertices_ + r.first, r.count));
+                break;
+            case SceneRecordType::Polyline:
+                valid = valid && end <= header->vertices;
+                break;
+            case SceneRecordType::Path:
+                valid = valid && end <= header->contours;
+                break;
+            case SceneRecordType::Group:
+                valid = valid && i + r.count < record_count_;
+                break;
+            default:
+                valid = false;
+                break;
+            }
+        }
+        if (!valid)
+        {
+            ::munmap(map_, length_);
+            throw std::runtime_error(scene_file + ": corrupt scene file");
+        }
+    }
+
+    SceneFile::~SceneFile()
+    {
+        ::munmap(map_, length_);
+    }
+
+    bool SceneFile::probe(const std::string &file)
+    {
+        char magic[sizeof(SCENE_MAGIC)] = {};
+        std::ifstream in(file, std::ios::binary);
+        in.read(magic, sizeof(magic));
+        return in && memcmp(magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) == 0;
+    }
+
+    Point SceneFile::dimensions() const
+    {
+        return dimensions_;
+    }
+
+    size_t SceneFile::size() const
+    {
+        return record_count_;
+    }
+
+    const SceneRecord &SceneFile::record(size_t i) const
+    {
+        return records_[i];
+    }
+
+    std::string SceneFile::id(size_t i) const
+    {
+        return std::string(strings_ + records_[i].id, records_[i].id_length);
+    }
+
+    void SceneFile::cost(const Box &canvas, RenderCost &total) const
+    {
+        for (size_t i = 0; i < record_count_; i++)
+        {
+            const SceneRecord &r = records_[i];
+            const Point *points = vertices_ + r.first;
+            switch ((SceneRecordType)r.type)
+            {
+            case SceneRecordType::Ellipse:
+            {
+                int rx = std::abs(r.radius.x), ry = std::abs(r.radius.y);
+                if (r.orientation % 180 != 0)
+                {
+                    rx = ry = std::max(rx, ry);
+                }
+                total.pixels += coveredPixels(Box{{r.center.x - rx, r.center.y - ry}, {r.center.x + rx, r.center.y + ry}},
+                                              canvas);
+                break;
+            }
+            case SceneRecordType::Polyline:
+                addPoints(points, r.count, false, canvas, total);
+                addLines(points, r.count, false, canvas, total);
+                break;
+            case SceneRecordType::Polygon:
+                addPoints(points, r.count, true, canvas, total);
+                break;
+            case SceneRecordType::Path:
+            {
+                const SceneContour *contours = contours_ + r.first;
+                Box box;
+                for (uint32_t k = 0; k < r.count; k++)
+                {
+                    const Point *p = vertices_ + contours[k].first;
+                    addPoints(p, contours[k].count, false, canvas, total);
+                    for (uint32_t j = 0; j < contours[k].count; j++)
+                    {
+                        box.extend(p[j]);
+                    }
+                    if (r.flags & SCENE_FILLED)
+                    {
+                        total.edges += contours[k].count;
+                    }
+                    if (r.flags & SCENE_STROKED)
+                    {
+                        addLines(p, contours[k].count, contours[k].closed != 0, canvas, total);
+                    }
+                }
+                if (r.flags & SCENE_FILLED)
+                {
+                    total.pixels += coveredPixels(box, canvas);
+                }
+                break;
+            }
+            case SceneRecordType::Group:
+                break;
+            }
+        }
+    }
+
+    void SceneFile::draw(PNGImage &img) const
+    {
+        std::vector<PointSpan> spans;
+        for (size_t i = 0; i < record_count_; i++)
+        {
+            const SceneRecord &r = records_[i];
+            const Point *points = vertices_ + r.first;
+            switch ((SceneRecordType)r.type)
+            {
+            case SceneRecordType::Ellipse:
+                img.draw_ellipse(r.center, r.radius, r.fill, r.orientation);
+                break;
+            case SceneRecordType::Polyline:
+                for (uint32_t k = 0; k + 1 < r.count; k++)
+                {
+                    img.draw_line(points[k], points[k + 1], r.stroke);
+                }
+                break;
+            case SceneRecordType::Polygon:
+                if (r.flags & SCENE_AXIS_RECT)
+                {
+                    img.draw_rect(points[0], points[2], r.fill);
+                }
+                else if (r.flags & SCENE_CONVEX)
+                {
+                    img.draw_convex_polygon(points, r.count, r.fill);
+                }
+                else
+                {
+                    img.draw_polygon(points, r.count, r.fill,
+                                     r.flags & SCENE_EVEN_ODD ? FillRule::EvenOdd : FillRule::NonZero);
+                }
+                break;
+            case SceneRecordType::Path:
+            {
+                const SceneContour *contours = contours_ + r.first;
+                if (r.flags & SCENE_FILLED)
+                {
+                    spans.clear();
+                    for (uint32_t k = 0; k < r.count; k++)
+                    {
+                        spans.push_back({vertices_ + contours[k].first, contours[k].count});
+                    }
+                    img.draw_polygon(spans.data(), spans.size(), r.fill,
+                                     r.flags & SCENE_EVEN_ODD ? FillRule::EvenOdd : FillRule::NonZero);
+                }
+                if (r.flags & SCENE_STROKED)
+                {
+                    for (uint32_t k = 0; k < r.count; k++)
+                    {
+                        const Point *p = vertices_ + contours[k].first;
+                        uint32_t n = contours[k].count;
+                        for (uint32_t j = 0; j + 1 < n; j++)
+                        {
+                            img.draw_line(p[j], p[j + 1], r.stroke);
+                        }
+                        if (contours[k].closed && n > 0)
+                        {
+                            img.draw_line(p[n - 1], p[0], r.stroke);
+                        }
+                    }
+                }
+                break;
+            }
+            case SceneRecordType::Group:
+                break; // Its elements follow and are drawn in order.
+            }
+        }
+    }
+
+    void compileScene(const std::string &svg_file, const std::string &scene_file)
+    {
+        Point dimensions;
+        std::vector<std::unique_ptr<SVGElement>> svg_elements;
+        readSVG(svg_file, dimensions, svg_elements);
+        // Rectangles are not merged: the scene may be drawn anti-aliased.
+        optimizeScene(svg_elements, true);
+        SceneWriter writer;
+        for (const std::unique_ptr<SVGElement> &e : svg_elements)
+        {
+            e->compile(writer);
+        }
+        writer.save(scene_file, dimensions);
+    }
+}
@@ -0,0 +1,197 @@
+//! @file SceneFile.hpp
+#ifndef __svg_SceneFile_hpp__
+#define __svg_SceneFile_hpp__
+
+#include "Color.hpp"
+#include "Point.hpp"
+#include "PointVector.hpp"
+#include "PNGImage.hpp"
+#include "SVGElements.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Kind of element stored in a scene file.
+    enum class SceneRecordType : uint8_t
+    {
+        Ellipse,
+        Polyline,
+        Polygon,
+        Path,
+        Group
+    };
+
+    //! Polygon flag: convex, drawn with draw_convex_polygon.
+    const uint8_t SCENE_CONVEX = 1;
+    //! Polygon flag: rectangle aligned with the axes, drawn with draw_rect.
+    const uint8_t SCENE_AXIS_RECT = 2;
+    //! Path flag: the path is filled.
+    const uint8_t SCENE_FILLED = 1;
+    //! Path flag: the path is stroked.
+    const uint8_t SCENE_STROKED = 2;
+    //! Path and polygon flag: filled with the even-odd rule (nonzero otherwise).
+    const uint8_t SCENE_EVEN_ODD = 4;
+
+    //! Element of a scene file, with its geometry after all transforms.
+    //! Records are stored in drawing order; a group record is followed by
+    //! the records of its elements.
+    struct SceneRecord
+    {
+        //! Kind of element (a SceneRecordType).
+        uint8_t type;
+        //! SCENE_* flags of polygons and paths.
+        uint8_t flags;
+        //! Fill color.
+        Color fill;
+        //! Stroke color.
+        Color stroke;
+        //! Ellipse center.
+        Point center;
+        //! Ellipse radius.
+        Point radius;
+        //! Ellipse orientation, in degrees.
+        int32_t orientation;
+        //! First vertex (polylines, polygons) or contour (paths).
+        uint32_t first;
+        //! Number of vertices, contours, or records in a group.
+        uint32_t count;
+        //! Offset of the id in the string table.
+        uint32_t id;
+        //! Length of the id (0 if none).
+        uint32_t id_length;
+    };
+
+    //! Subpath of a path record.
+    struct SceneContour
+    {
+        //! First vertex.
+        uint32_t first;
+        //! Number of vertices.
+        uint32_t count;
+        //! Whether the subpath is closed.
+        uint32_t closed;
+    };
+
+    //! Collects the records of a scene and writes them to a file.
+    class SceneWriter
+    {
+    public:
+        //! Constructor of an empty scene.
+        SceneWriter();
+        //! Append an element.
+        //! @param record Element record (first, count and id are filled in).
+        //! @param id Element id.
+        //! @param points Vertices of the element.
+        //! @param n Number of vertices.
+        void add(SceneRecord record, const std::string &id, const Point *points = nullptr, size_t n = 0);
+        //! Append a path.
+        //! @param record Path record (first, count and id are filled in).
+        //! @param id Path id.
+        //! @param contours Vertices of each subpath.
+        //! @param closed Whether each subpath is closed.
+        void add(SceneRecord record, const std::string &id,
+                 const std::vector<PointVector> &contours, const std::vector<bool> &closed);
+        //! Start a group: elements added until end_group() belong to it.
+        //! @param id Group id.
+        void begin_group(const std::string &id);
+        //! End the innermost group.
+        void end_group();
+        //! Write the scene to a file.
+        //! @param scene_file File name.
+        //! @param dimensions Image width and height.
+        void save(const std::string &scene_file, const Point &dimensions) const;
+
+    private:
+        //! Add a string to the string table.
+        uint32_t intern(const std::string &s);
+
+        //! Records in drawing order.
+        std::vector<SceneRecord> records_;
+        //! Path subpaths.
+        std::vector<SceneContour> contours_;
+        //! Vertices of all elements.
+        std::vector<Point> vertices_;
+        //! String table.
+        std::string strings_;
+        //! Records of the groups that are still open.
+        std::vector<size_t> groups_;
+    };
+
+    //! Scene file mapped into memory, drawn without parsing.
+    class SceneFile
+    {
+    public:
+        //! Map a scene file, checking its image size, its ranges and the
+        //! rasterization flags of its polygons (throws std::runtime_error if
+        //! any of them is wrong).
+        //! @param scene_file File name.
+        explicit SceneFile(const std::string &scene_file);
+        SceneFile(const SceneFile &) = delete;
+        SceneFile &operator=(const SceneFile &) = delete;
+        //! Destructor (unmaps the file).
+        ~SceneFile();
+        //! Check if a file starts like a scene file.
+        //! @param file File name.
+        //! @return True if the file has the scene file signature.
+        static bool probe(const std::string &file);
+        //! Get the image dimensions.
+        //! @return Width and height.
+        Point dimensions() const;
+        //! Get the number of records.
+        //! @return The number of records.
+        size_t size() const;
+        //! Get a record.
+        //! @param i Index.
+        //! @return The record.
+        const SceneRecord &record(size_t i) const;
+        //! Get the id of a record.
+        //! @param i Index.
+        //! @return The id (empty if none).
+        std::string id(size_t i) const;
+        //! Add the work of drawing the scene, estimated like
+        //! SVGElement::cost() does for each element.
+        //! @param canvas Pixels of the image.
+        //! @param total Cost to increase.
+        void cost(const Box &canvas, RenderCost &total) const;
+        //! Draw the scene.
+        //! @param img Image to draw on.
+        void draw(PNGImage &img) const;
+
+    private:
+        //! Mapped file.
+        void *map_;
+        //! Length of the mapping.
+        size_t length_;
+        //! Image dimensions.
+        Point dimensions_;
+        //! Records.
+        const SceneRecord *records_;
+        //! Number of records.
+        size_t record_count_;
+        //! Path subpaths.
+        const SceneContour *contours_;
+        //! Vertices.
+        const Point *vertices_;
+        //! String table.
+        const char *strings_;
+    };
+
+    //! Draw a scene file into an image, replacing all of its pixels.
+    //! @param scene Scene.
+    //! @param img Image to draw on.
+    //! @param options Rendering options.
+    //! @param stats Where to store rendering measurements (may be null).
+    void renderScene(const SceneFile &scene, PNGImage &img,
+                     const RenderOptions &options = RenderOptions(),
+                     RenderStats *stats = nullptr);
+
+    //! Parse an SVG file and save it as a scene file.
+    //! @param svg_file SVG file name.
+    //! @param scene_file Scene file name.
+    void compileScene(const std::string &svg_file, const std::string &scene_file);
+}
+#endif
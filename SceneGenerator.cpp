@@ -0,0 +1,239 @@
+//! @file SceneGenerator.cpp
+#include "SceneGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace svg
+{
+    namespace
+    {
+        /**
+         * @brief Small pseudo-random generator (xorshift32), identical on every platform.
+         */
+        class Random
+        {
+        public:
+            explicit Random(uint32_t seed) : state_(seed != 0 ? seed : 0x9E3779B9u) {}
+            /**
+             * @brief Gets the next 32 random bits.
+             */
+            uint32_t next()
+            {
+                state_ ^= state_ << 13;
+                state_ ^= state_ >> 17;
+                state_ ^= state_ << 5;
+                return state_;
+            }
+            /**
+             * @brief Gets a number in [lo, hi].
+             */
+            int range(int lo, int hi)
+            {
+                return hi <= lo ? lo : lo + (int)(next() % (uint32_t)(hi - lo + 1));
+            }
+
+        private:
+            uint32_t state_;
+        };
+
+        /**
+         * @brief Gets a random "#rrggbb" color.
+         */
+        std::string color(Random &random)
+        {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "#%06x", random.next() & 0xFFFFFF);
+            return buffer;
+        }
+
+        /**
+         * @brief Writes the vertices of a random star-shaped polygon, "x,y x,y ...".
+         *
+         * @param out Where to write.
+         * @param random The random numbers.
+         * @param cx The center x coordinate.
+         * @param cy The center y coordinate.
+         * @param size The largest distance of a vertex from the center.
+         * @param n The number of vertices.
+         */
+        void writeStar(std::ostream &out, Random &random, int cx, int cy, int size, unsigned n)
+        {
+            for (unsigned i = 0; i < n; i++)
+            {
+                double angle = 2 * M_PI * i / n;
+                int r = random.range(size / 4, size);
+                out << (i == 0 ? "" : " ") << cx + (int)std::lround(r * std::cos(angle)) << ','
+                    << cy + (int)std::lround(r * std::sin(angle));
+            }
+        }
+
+        /**
+         * @brief Writes the vertices of a random walk, "x,y x,y ...".
+         */
+        void writeWalk(std::ostream &out, Random &random, int x, int y, int step, unsigned n)
+        {
+            for (unsigned i = 0; i < n; i++)
+            {
+                out << (i == 0 ? "" : " ") << x << ',' << y;
+                x += random.range(-step, step);
+                y += random.range(-step, step);
+            }
+        }
+
+        /**
+         * @brief Writes one random shape.
+         *
+         * @param out Where to write.
+         * @param random The random numbers.
+         * @param options The document parameters.
+         * @param id The id of the shape ("" for none).
+         */
+        void writeShape(std::ostream &out, Random &random, const GeneratorOptions &options, const std::string &id)
+        {
+            const unsigned weights[] = {options.rects, options.circles, options.ellipses, options.lines,
+                                        options.polylines, options.polygons, options.paths};
+            unsigned total = 0;
+            for (unsigned w : weights)
+            {
+                total += w;
+            }
+            unsigned pick = total != 0 ? random.next() % total : 0;
+            unsigned type = 0;
+            while (type + 1 < 7 && pick >= weights[type])
+            {
+                pick -= weights[type++];
+            }
+
+            int size = std::max(2, std::min(options.width, options.height) / 10);
+            int x = random.range(0, options.width - 1), y = random.range(0, options.height - 1);
+            unsigned n = std::max(2u, options.vertices);
+            std::string attr_id = id.empty() ? "" : " id=\"" + id + "\"";
+            switch (type)
+            {
+            case 0:
+                out << "<rect" << attr_id << " x=\"" << x << "\" y=\"" << y << "\" width=\"" << random.range(1, size)
+                    << "\" height=\"" << random.range(1, size) << "\" fill=\"" << color(random) << "\"/>\n";
+                break;
+            case 1:
+                out << "<circle" << attr_id << " cx=\"" << x << "\" cy=\"" << y << "\" r=\"" << random.range(1, size / 2)
+                    << "\" fill=\"" << color(random) << "\"/>\n";
+                break;
+            case 2:
+                out << "<ellipse" << attr_id << " cx=\"" << x << "\" cy=\"" << y << "\" rx=\"" << random.range(1, size / 2)
+                    << "\" ry=\"" << random.range(1, size / 2) << "\" fill=\"" << color(random) << "\"/>\n";
+                break;
+            case 3:
+                out << "<line" << attr_id << " x1=\"" << x << "\" y1=\"" << y << "\" x2=\"" << x + random.range(-size, size)
+                    << "\" y2=\"" << y + random.range(-size, size) << "\" stroke=\"" << color(random) << "\"/>\n";
+                break;
+            case 4:
+                out << "<polyline" << attr_id << " points=\"";
+                writeWalk(out, random, x, y, std::max(1, size / 4), n);
+                out << "\" stroke=\"" << color(random) << "\"/>\n";
+                break;
+            case 5:
+                out << "<polygon" << attr_id << " points=\"";
+                writeStar(out, random, x, y, size / 2, std::max(3u, n));
+                out << "\" fill=\"" << color(random) << "\"/>\n";
+                break;
+            default:
+            {
+                out << "<path" << attr_id << " d=\"M" << x << ',' << y;
+                for (unsigned i = 0; i < n; i++)
+                {
+                    int step = std::max(1, size / 4);
+                    if (i % 2 == 0)
+                    {
+                        x += random.range(-step, step);
+                        y += random.range(-step, step);
+                        out << " L" << x << ',' << y;
+                    }
+                    else
+                    {
+                        out << " C" << x + random.range(-step, step) << ',' << y + random.range(-step, step) << ' '
+                            << x + random.range(-step, step) << ',' << y + random.range(-step, step) << ' ';
+                        x += random.range(-step, step);
+                        y += random.range(-step, step);
+                        out << x << ',' << y;
+                    }
+                }
+                out << " Z\" fill=\"" << color(random) << "\" stroke=\"" << color(random) << "\"/>\n";
+                break;
+            }
+            }
+        }
+    }
+
+    void generateSVG(std::ostream &out, const GeneratorOptions &options)
+    {
+        Random random(options.seed);
+        unsigned group_size = std::max(1u, options.group_size);
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\""
+            << options.width << "\" height=\"" << options.height << "\">\n";
+        for (unsigned first = 0, block = 0; first < options.elements; first += group_size, block++)
+        {
+            for (unsigned d = 0; d < options.depth; d++)
+            {
+                out << "<g transform=\"translate(" << random.range(-5, 5) << ' ' << random.range(-5, 5) << ")\">\n";
+            }
+            unsigned last = std::min(options.elements, first + group_size);
+            for (unsigned i = first; i < last; i++)
+            {
+                bool referenced = i == first && options.uses > 0;
+                std::string id = referenced ? "s" + std::to_string(block) : "";
+                writeShape(out, random, options, id);
+                for (unsigned k = 0; referenced && k < options.uses; k++)
+                {
+                    out << "<use href=\"#" << id << "\" transform=\"translate(" << random.range(-50, 50) << ' '
+                        << random.range(-50, 50) << ")\"/>\n";
+                }
+            }
+            for (unsigned d = 0; d < options.depth; d++)
+            {
+                out << "</g>\n";
+            }
+        }
+        out << "</svg>\n";
+    }
+
+    bool parseGeneratorOption(const std::string &option, GeneratorOptions &options)
+    {
+        size_t eq = option.find('=');
+        if (option.compare(0, 2, "--") != 0 || eq == std::string::npos)
+        {
+            return false;
+        }
+        std::string name = option.substr(2, eq - 2);
+        const char *value = option.c_str() + eq + 1;
+        unsigned *field = name == "elements"     ? &options.elements
+                          : name == "vertices"   ? &options.vertices
+                          : name == "depth"      ? &options.depth
+                          : name == "group-size" ? &options.group_size
+                          : name == "uses"       ? &options.uses
+                          : nullptr;
+        if (field != nullptr)
+        {
+            *field = (unsigned)std::strtoul(value, nullptr, 10);
+            return true;
+        }
+        if (name == "seed")
+        {
+            options.seed = (uint32_t)std::strtoul(value, nullptr, 10);
+            return true;
+        }
+        if (name == "size")
+        {
+            return std::sscanf(value, "%dx%d", &options.width, &options.height) == 2;
+        }
+        if (name == "mix")
+        {
+            return std::sscanf(value, "%u:%u:%u:%u:%u:%u:%u", &options.rects, &options.circles, &options.ellipses,
+                               &options.lines, &options.polylines, &options.polygons, &options.paths) == 7;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,46 @@
+//! @file SceneGenerator.hpp
+#ifndef __svg_SceneGenerator_hpp__
+#define __svg_SceneGenerator_hpp__
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace svg
+{
+    //! Parameters of a synthetic document written by generateSVG().
+    struct GeneratorOptions
+    {
+        //! Number of shapes (not counting groups and <use> copies).
+        unsigned elements = 1000;
+        //! Relative frequency of each shape type.
+        unsigned rects = 1, circles = 1, ellipses = 1, lines = 1, polylines = 1, polygons = 1, paths = 1;
+        //! Vertices of each polyline and polygon, and segments of each path.
+        unsigned vertices = 8;
+        //! Nesting depth of the groups around each block of shapes.
+        unsigned depth = 1;
+        //! Shapes per innermost group.
+        unsigned group_size = 100;
+        //! <use> copies of the first shape of each innermost group.
+        unsigned uses = 0;
+        //! Canvas size.
+        int width = 1000, height = 1000;
+        //! Seed of the pseudo-random numbers (same seed, same document).
+        uint32_t seed = 1;
+    };
+
+    //! Write a deterministic SVG document of random shapes. The output only
+    //! depends on the options, not on the platform or the standard library.
+    //! @param out Where to write the document.
+    //! @param options Document parameters.
+    void generateSVG(std::ostream &out, const GeneratorOptions &options);
+
+    //! Read one command-line option of the generator: --elements=N,
+    //! --mix=rects:circles:ellipses:lines:polylines:polygons:paths,
+    //! --vertices=N, --depth=N, --group-size=N, --uses=N, --size=WxH or --seed=N.
+    //! @param option Command-line argument.
+    //! @param options Parameters to update.
+    //! @return False if the argument is not a generator option.
+    bool parseGeneratorOption(const std::string &option, GeneratorOptions &options);
+}
+#endif
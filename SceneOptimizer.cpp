@@ -0,0 +1,96 @@
+//! @file SceneOptimizer.cpp
+#include "SceneOptimizer.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace svg
+{
+    namespace
+    {
+        /**
+         * @brief Adds the groups and shapes of a list of elements to a count.
+         *
+         * @param svg_elements The elements.
+         * @param depth The nesting depth of the elements.
+         * @param stats The counts to update.
+         */
+        void count(const std::vector<std::unique_ptr<SVGElement>> &svg_elements, size_t depth,
+                   SceneStats &stats)
+        {
+            for (const std::unique_ptr<SVGElement> &e : svg_elements)
+            {
+                const Group *g = dynamic_cast<const Group *>(e.get());
+                if (g != nullptr)
+                {
+                    stats.groups++;
+                    stats.depth = std::max(stats.depth, depth + 1);
+                    count(g->elements(), depth + 1, stats);
+                }
+                else
+                {
+                    stats.shapes++;
+                }
+            }
+        }
+
+        /**
+         * @brief Moves the optimized form of a list of elements to the end of another.
+         *
+         * @param svg_elements The elements, in drawing order (left empty).
+         * @param out Where the remaining elements are appended.
+         * @param merge_rects Whether consecutive rectangles may be merged.
+         */
+        void flatten(std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                     std::vector<std::unique_ptr<SVGElement>> &out, bool merge_rects)
+        {
+            for (std::unique_ptr<SVGElement> &e : svg_elements)
+            {
+                Group *g = dynamic_cast<Group *>(e.get());
+                if (g != nullptr)
+                {
+                    if (g->id.empty())
+                    {
+                        // Transforms are applied when parsing, so the group
+                        // adds nothing but its drawing order.
+                        flatten(g->elements(), out, merge_rects);
+                        continue;
+                    }
+                    std::vector<std::unique_ptr<SVGElement>> inner;
+                    flatten(g->elements(), inner, merge_rects);
+                    g->elements() = std::move(inner);
+                }
+                else if (e->id.empty())
+                {
+                    if (e->empty())
+                    {
+                        continue;
+                    }
+                    Rect *r = dynamic_cast<Rect *>(e.get());
+                    Rect *last = out.empty() ? nullptr : dynamic_cast<Rect *>(out.back().get());
+                    if (merge_rects && r != nullptr && last != nullptr && last->id.empty() &&
+                        last->merge(*r))
+                    {
+                        continue;
+                    }
+                }
+                out.push_back(std::move(e));
+            }
+            svg_elements.clear();
+        }
+    }
+
+    SceneStats sceneStats(const std::vector<std::unique_ptr<SVGElement>> &svg_elements)
+    {
+        SceneStats stats;
+        count(svg_elements, 0, stats);
+        return stats;
+    }
+
+    void optimizeScene(std::vector<std::unique_ptr<SVGElement>> &svg_elements, bool antialias)
+    {
+        std::vector<std::unique_ptr<SVGElement>> out;
+        flatten(svg_elements, out, !antialias);
+        svg_elements = std::move(out);
+    }
+}
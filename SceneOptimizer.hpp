@@ -0,0 +1,26 @@
+//! @file SceneOptimizer.hpp
+#ifndef __svg_SceneOptimizer_hpp__
+#define __svg_SceneOptimizer_hpp__
+
+#include "SVGElements.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace svg
+{
+    //! Count the groups and shapes of a scene.
+    //! @param svg_elements Top-level elements of the scene.
+    //! @return The counts.
+    SceneStats sceneStats(const std::vector<std::unique_ptr<SVGElement>> &svg_elements);
+
+    //! Simplify the element tree of a parsed scene without changing how it is drawn.
+    //! Groups without an id are replaced by their elements, elements without
+    //! an id that draw nothing are removed and, for aliased rendering,
+    //! consecutive rectangles of the same color that form a single rectangle
+    //! are merged. Elements with an id are kept so they can still be found.
+    //! @param svg_elements Top-level elements of the scene (updated).
+    //! @param antialias Whether the scene will be drawn with anti-aliasing.
+    void optimizeScene(std::vector<std::unique_ptr<SVGElement>> &svg_elements, bool antialias);
+}
+#endif
@@ -0,0 +1,308 @@
+//! @file SceneProfile.cpp
+#include "SceneProfile.hpp"
+#include "Budget.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+namespace svg
+{
+    namespace
+    {
+        /**
+         * @brief What an element draws once its <use> references are expanded.
+         *
+         * The counts, covered pixels and image bounds are those of the
+         * image; the bounds are in the coordinates of the element's parent,
+         * as readSVG holds the element until the groups around it apply
+         * their transforms.
+         */
+        struct ElementCounts
+        {
+            size_t shapes = 0;
+            uint64_t vertices = 0;
+            uint64_t max_vertices = 0;
+            RenderCost cost;
+            Box bounds;
+            Box image_bounds;
+            //! True for groups and copies of groups.
+            bool group = false;
+
+            void add(const ElementCounts &other)
+            {
+                shapes += other.shapes;
+                vertices += other.vertices;
+                max_vertices = std::max(max_vertices, other.max_vertices);
+                cost.pixels += other.cost.pixels;
+                cost.edges += other.cost.edges;
+                cost.vertices += other.cost.vertices;
+                cost.bytes += other.cost.bytes;
+                bounds.extend(other.bounds);
+                image_bounds.extend(other.image_bounds);
+            }
+        };
+
+        /**
+         * @brief An element mapped for <use>.
+         */
+        struct MappedElement
+        {
+            ElementCounts counts;
+            //! Number of the groups enclosing the element that are still open.
+            size_t open = 0;
+        };
+
+        /**
+         * @brief The state of one walk over the XML tree of a document.
+         */
+        struct ProfileWalk
+        {
+            SceneProfile &profile;
+            Box canvas;
+            //! The groups enclosing the element being counted, outermost first.
+            std::vector<const tinyxml2::XMLElement *> ancestors;
+            //! Counts of the elements with an identifier seen so far, as readSVG maps them for <use>.
+            std::map<std::string, MappedElement> ids;
+            //! The identifiers defined within each enclosing group.
+            std::vector<std::vector<std::string>> defined;
+        };
+
+        /**
+         * @brief Applies the transform of an XML element to a box, transformed as a rectangle.
+         *
+         * @param elem The XML element carrying the transform.
+         * @param box The box to transform.
+         */
+        void transformBounds(const tinyxml2::XMLElement *elem, Box &box)
+        {
+            if (elem->Attribute("transform") == nullptr || box.empty())
+            {
+                return;
+            }
+            Polygon corners(PointVector{{box.min.x, box.min.y}, {box.max.x, box.min.y},
+                                        {box.max.x, box.max.y}, {box.min.x, box.max.y}},
+                            Color{0, 0, 0});
+            readTransform(corners, elem);
+            box = corners.bounds();
+        }
+
+        /**
+         * @brief Counts the elements below an XML element in one pass, without building <use> copies.
+         *
+         * Only the elements readSVG draws are counted, walking the same
+         * containers it does: elements it skips (title, desc, defs, ...) are
+         * not counted, and neither is anything inside them. Shapes are
+         * created one at a time, with the transforms of their groups, and
+         * dropped once counted. A <use> adds the counts of the element it
+         * references instead of copying it, with the covered pixels scaled
+         * by its transforms.
+         *
+         * @param parent The element whose children are counted.
+         * @param scale The scaling applied to the children by their ancestors' transforms.
+         * @param walk Where to add the counts.
+         * @return The counts of everything the children draw.
+         */
+        ElementCounts countElements(const tinyxml2::XMLElement *parent, int scale, ProfileWalk &walk)
+        {
+            SceneProfile &profile = walk.profile;
+            bool top = walk.ancestors.empty();
+            ElementCounts total;
+            size_t index = 0;
+            for (const tinyxml2::XMLElement *child = parent->FirstChildElement(); child != nullptr;
+                 child = child->NextSiblingElement())
+            {
+                if (!readsAsElement(child->Name()))
+                {
+                    continue;
+                }
+                std::string tag = child->Name();
+                profile.tags[tag]++;
+                std::string id = child->Attribute("id") ? child->Attribute("id") : "";
+                ElementCounts counts;
+                if (tag == "g")
+                {
+                    walk.ancestors.push_back(child);
+                    walk.defined.emplace_back();
+                    profile.depth = std::max(profile.depth, walk.ancestors.size());
+                    counts = countElements(child, scale * transformScale(child), walk);
+                    counts.group = true;
+                    // Closing the group transforms its elements, and so the ones mapped for <use>.
+                    transformBounds(child, counts.bounds);
+                    std::vector<std::string> inner = std::move(walk.defined.back());
+                    walk.defined.pop_back();
+                    walk.ancestors.pop_back();
+                    for (const std::string &name : inner)
+                    {
+                        MappedElement &mapped = walk.ids[name];
+                        transformBounds(child, mapped.counts.bounds);
+                        mapped.open = walk.ancestors.size();
+                    }
+                    if (!walk.defined.empty())
+                    {
+                        walk.defined.back().insert(walk.defined.back().end(), inner.begin(), inner.end());
+                    }
+                }
+                else if (tag == "use")
+                {
+                    const char *href = child->Attribute("href");
+                    if (href == nullptr)
+                    {
+                        href = child->Attribute("xlink:href");
+                    }
+                    std::string ident = href && href[0] == '#' ? href + 1 : "";
+                    auto it = walk.ids.find(ident);
+                    if (it == walk.ids.end())
+                    {
+                        throw std::runtime_error("Unknown reference in <use>: " + ident);
+                    }
+                    // The copy gets the transforms of the <use> and of the groups opened since
+                    // the element was mapped; the other groups apply to both.
+                    counts = it->second.counts;
+                    transformBounds(child, counts.bounds);
+                    counts.image_bounds = counts.bounds;
+                    uint64_t copy_scale = transformScale(child);
+                    for (size_t k = walk.ancestors.size(); k-- > 0;)
+                    {
+                        transformBounds(walk.ancestors[k], counts.image_bounds);
+                        if (k >= it->second.open)
+                        {
+                            copy_scale *= transformScale(walk.ancestors[k]);
+                        }
+                    }
+                    counts.cost.pixels *= copy_scale * copy_scale;
+                    if (id.empty())
+                    {
+                        id = ident;
+                    }
+                }
+                else
+                {
+                    profile.shapes++;
+                    std::unique_ptr<SVGElement> shape = readShape(child, scale);
+                    counts.bounds = shape->bounds();
+                    for (auto a = walk.ancestors.rbegin(); a != walk.ancestors.rend(); ++a)
+                    {
+                        readTransform(*shape, *a);
+                    }
+                    shape->cost(walk.canvas, counts.cost);
+                    counts.image_bounds = shape->bounds();
+                    counts.shapes = 1;
+                    counts.vertices = counts.max_vertices = counts.cost.vertices;
+                }
+                if (top && counts.group)
+                {
+                    GroupProfile group;
+                    group.index = index;
+                    group.id = id;
+                    group.bounds = counts.image_bounds;
+                    profile.groups.push_back(group);
+                }
+                if (child->Attribute("id") != nullptr)
+                {
+                    walk.ids[child->Attribute("id")] = MappedElement{counts, walk.ancestors.size()};
+                    if (!walk.defined.empty())
+                    {
+                        walk.defined.back().push_back(child->Attribute("id"));
+                    }
+                }
+                total.add(counts);
+                index++;
+            }
+            return total;
+        }
+
+        /**
+         * @brief Writes a string as a JSON string literal.
+         */
+        void writeString(std::ostream &out, const std::string &text)
+        {
+            out << '"';
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out << '\\' << c;
+                }
+                else if ((unsigned char)c < 0x20)
+                {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", (unsigned)c);
+                    out << escape;
+                }
+                else
+                {
+                    out << c;
+                }
+            }
+            out << '"';
+        }
+    }
+
+    SceneProfile profileSVG(const std::string &svg_file)
+    {
+        tinyxml2::XMLDocument doc;
+        loadXML(doc, svg_file);
+        if (doc.RootElement() == nullptr)
+        {
+            throw std::runtime_error("Unable to load " + svg_file);
+        }
+        SceneProfile profile;
+        profile.dimensions = {doc.RootElement()->IntAttribute("width"), doc.RootElement()->IntAttribute("height")};
+        checkDimensions(profile.dimensions, svg_file);
+        ProfileWalk walk{profile, {{0, 0}, {profile.dimensions.x - 1, profile.dimensions.y - 1}}, {}, {}, {}};
+        ElementCounts counts = countElements(doc.RootElement(), 1, walk);
+        profile.expanded_shapes = counts.shapes;
+        profile.vertices = counts.vertices;
+        profile.max_vertices = counts.max_vertices;
+        profile.cost = counts.cost;
+        // The image itself, as estimated for a scene without elements.
+        profile.cost.bytes += estimateCost(std::vector<std::unique_ptr<SVGElement>>(), profile.dimensions).bytes;
+        return profile;
+    }
+
+    void writeJSON(std::ostream &out, const SceneProfile &profile)
+    {
+        double area = (double)profile.dimensions.x * profile.dimensions.y;
+        out << "{\n  \"width\": " << profile.dimensions.x << ",\n  \"height\": " << profile.dimensions.y
+            << ",\n  \"tags\": {";
+        bool first = true;
+        for (const auto &tag : profile.tags)
+        {
+            out << (first ? "" : ", ");
+            writeString(out, tag.first);
+            out << ": " << tag.second;
+            first = false;
+        }
+        out << "},\n  \"shapes\": " << profile.shapes
+            << ",\n  \"expanded_shapes\": " << profile.expanded_shapes
+            << ",\n  \"use_expansion\": " << (profile.shapes > 0 ? (double)profile.expanded_shapes / profile.shapes : 1.0)
+            << ",\n  \"depth\": " << profile.depth
+            << ",\n  \"vertices\": {\"total\": " << profile.vertices << ", \"max\": " << profile.max_vertices << "}"
+            << ",\n  \"edges\": " << profile.cost.edges
+            << ",\n  \"covered_pixels\": " << profile.cost.pixels
+            << ",\n  \"overdraw\": " << (area > 0 ? profile.cost.pixels / area : 0.0)
+            << ",\n  \"estimated_bytes\": " << profile.cost.bytes
+            << ",\n  \"groups\": [";
+        for (size_t i = 0; i < profile.groups.size(); i++)
+        {
+            const GroupProfile &g = profile.groups[i];
+            out << (i == 0 ? "\n" : ",\n") << "    {\"index\": " << g.index << ", \"id\": ";
+            writeString(out, g.id);
+            out << ", \"bounds\": ";
+            if (g.bounds.empty())
+            {
+                out << "null";
+            }
+            else
+            {
+                out << '[' << g.bounds.min.x << ", " << g.bounds.min.y << ", " << g.bounds.max.x << ", "
+                    << g.bounds.max.y << ']';
+            }
+            out << '}';
+        }
+        out << (profile.groups.empty() ? "]\n}\n" : "\n  ]\n}\n");
+    }
+}
@@ -0,0 +1,63 @@
+//! @file SceneProfile.hpp
+#ifndef __svg_SceneProfile_hpp__
+#define __svg_SceneProfile_hpp__
+
+#include "Point.hpp"
+#include "SVGElements.hpp"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Bounds of one group at the top level of a document.
+    struct GroupProfile
+    {
+        //! Position among the top-level elements.
+        size_t index = 0;
+        //! Id of the group ("" if none).
+        std::string id;
+        //! Bounds, after transforms (empty if the group draws nothing).
+        Box bounds;
+    };
+
+    //! Why a document is expensive, measured without drawing it.
+    struct SceneProfile
+    {
+        //! Image size.
+        Point dimensions = {0, 0};
+        //! Number of XML elements of each tag, as written (only the tags
+        //! that are drawn, outside of elements that are not).
+        std::map<std::string, size_t> tags;
+        //! Shapes as written (not counting <use> and groups).
+        size_t shapes = 0;
+        //! Shapes after expanding every <use>.
+        size_t expanded_shapes = 0;
+        //! Deepest nesting of <g> elements.
+        size_t depth = 0;
+        //! Vertices of all shapes, after expansion and path flattening.
+        uint64_t vertices = 0;
+        //! Vertices of the largest shape.
+        uint64_t max_vertices = 0;
+        //! Estimated cost of drawing the document.
+        RenderCost cost;
+        //! Groups at the top level of the document, in order.
+        std::vector<GroupProfile> groups;
+    };
+
+    //! Profile a document in one pass over its XML tree, without allocating
+    //! an image or drawing anything. Shapes are created one at a time, and a
+    //! <use> is counted from the element it references without copying it.
+    //! @param svg_file SVG file.
+    //! @return Profile.
+    SceneProfile profileSVG(const std::string &svg_file);
+
+    //! Write a profile as a JSON object.
+    //! @param out Where to write.
+    //! @param profile Profile.
+    void writeJSON(std::ostream &out, const SceneProfile &profile);
+}
+#endif
@@ -0,0 +1,635 @@
+//! @file Server.cpp
+#include "Server.hpp"
+#include "Budget.hpp"
+#include "SceneFile.hpp"
+#include "ThreadPool.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace svg
+{
+    namespace
+    {
+        //! How often blocked waits check the stop token (milliseconds).
+        const int STOP_CHECK_MS = 200;
+        //! Longest header line ("FILE 123456789\n" fits easily).
+        const size_t MAX_HEADER = 64;
+        //! Bytes read from a socket at a time.
+        const size_t READ_CHUNK = 64 << 10;
+
+        /**
+         * @brief Fills in the address of a socket path.
+         */
+        sockaddr_un socketAddress(const std::string &socket_path)
+        {
+            sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (socket_path.size() >= sizeof(address.sun_path))
+            {
+                throw std::invalid_argument("Socket path too long: " + socket_path);
+            }
+            std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+            return address;
+        }
+
+        /**
+         * @brief Closes a file descriptor when leaving a scope.
+         */
+        struct Descriptor
+        {
+            int fd;
+            ~Descriptor()
+            {
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                }
+            }
+        };
+
+        /**
+         * @brief Waits until a socket has data, checking the stop token meanwhile.
+         *
+         * @return False if the token was cancelled first.
+         */
+        bool waitReadable(int fd, const CancellationToken *stop)
+        {
+            while (stop == nullptr || !stop->cancelled())
+            {
+                pollfd events{fd, POLLIN, 0};
+                int r = ::poll(&events, 1, stop == nullptr ? -1 : STOP_CHECK_MS);
+                if (r > 0)
+                {
+                    return true;
+                }
+                if (r < 0 && errno != EINTR)
+                {
+                    throw std::runtime_error(std::string("poll: ") + std::strerror(errno));
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Sends a whole buffer.
+         */
+        void sendAll(int fd, const char *data, size_t size)
+        {
+            while (size > 0)
+            {
+                ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    throw std::runtime_error(std::string("Connection lost: ") + std::strerror(errno));
+                }
+                data += n;
+                size -= (size_t)n;
+            }
+        }
+
+        /**
+         * @brief Receives exactly size bytes.
+         */
+        void receiveAll(int fd, char *data, size_t size, const CancellationToken *stop)
+        {
+            while (size > 0)
+            {
+                if (!waitReadable(fd, stop))
+                {
+                    throw Cancelled();
+                }
+                ssize_t n = ::recv(fd, data, size, 0);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    throw std::runtime_error("Connection lost");
+                }
+                data += n;
+                size -= (size_t)n;
+            }
+        }
+
+        /**
+         * @brief Sends a header line and its payload.
+         */
+        void sendMessage(int fd, const char *verb, const std::string &payload)
+        {
+            std::string header = std::string(verb) + " " + std::to_string(payload.size()) + "\n";
+            sendAll(fd, header.data(), header.size());
+            sendAll(fd, payload.data(), payload.size());
+        }
+
+        /**
+         * @brief Splits a header line into its verb and payload size.
+         *
+         * @param header The header line, without its line feed.
+         * @param verb Receives the first word of the header.
+         * @param max_size Largest accepted payload.
+         * @return The payload size.
+         */
+        size_t parseHeader(const std::string &header, std::string &verb, size_t max_size)
+        {
+            size_t space = header.find(' ');
+            char *end = nullptr;
+            unsigned long long size =
+                space == std::string::npos ? 0 : std::strtoull(header.c_str() + space + 1, &end, 10);
+            if (space == std::string::npos || end == header.c_str() + space + 1 || *end != '\0')
+            {
+                throw std::runtime_error("Malformed message header: " + header);
+            }
+            if (size > max_size)
+            {
+                throw std::runtime_error("Message too large: " + std::to_string(size) + " bytes");
+            }
+            verb = header.substr(0, space);
+            return (size_t)size;
+        }
+
+        /**
+         * @brief Receives a header line and its payload.
+         *
+         * The payload grows as its bytes arrive, so a large announced size
+         * does not reserve memory by itself.
+         *
+         * @param fd The socket.
+         * @param verb Receives the first word of the header.
+         * @param payload Receives the payload.
+         * @param max_size Largest accepted payload.
+         * @param stop Token checked while waiting (may be null).
+         * @return False if the peer closed the connection before a new message.
+         */
+        bool receiveMessage(int fd, std::string &verb, std::string &payload, size_t max_size,
+                            const CancellationToken *stop)
+        {
+            std::string header;
+            char c;
+            for (;;)
+            {
+                if (!waitReadable(fd, stop))
+                {
+                    return false;
+                }
+                ssize_t n = ::recv(fd, &c, 1, 0);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    if (header.empty())
+                    {
+                        return false;
+                    }
+                    throw std::runtime_error("Connection lost");
+                }
+                if (c == '\n')
+                {
+                    break;
+                }
+                header += c;
+                if (header.size() > MAX_HEADER)
+                {
+                    throw std::runtime_error("Malformed message header");
+                }
+            }
+            size_t size = parseHeader(header, verb, max_size);
+            payload.clear();
+            while (payload.size() < size)
+            {
+                size_t chunk = std::min(size - payload.size(), READ_CHUNK);
+                size_t done = payload.size();
+                payload.resize(done + chunk);
+                receiveAll(fd, &payload[done], chunk, stop);
+            }
+            return true;
+        }
+
+        /**
+         * @brief Connection of a server, with the bytes of its next request.
+         */
+        struct Connection
+        {
+            //! Socket.
+            int fd;
+            //! Bytes received and not yet taken as a request.
+            std::string received;
+            //! When the first byte of the incomplete request was received.
+            std::chrono::steady_clock::time_point started;
+            //! Type of the request being answered.
+            std::string verb;
+            //! Payload of the request being answered.
+            std::string payload;
+        };
+
+        /**
+         * @brief Reads what a connection has sent so far, without blocking.
+         *
+         * At most one chunk is read per call, so connections sending large
+         * requests take turns with the others.
+         *
+         * @return False if the peer closed the connection.
+         */
+        bool receiveAvailable(Connection &connection)
+        {
+            for (;;)
+            {
+                size_t done = connection.received.size();
+                connection.received.resize(done + READ_CHUNK);
+                ssize_t n = ::recv(connection.fd, &connection.received[done], READ_CHUNK, MSG_DONTWAIT);
+                connection.received.resize(done + (n > 0 ? (size_t)n : 0));
+                if (n > 0)
+                {
+                    if (done == 0)
+                    {
+                        connection.started = std::chrono::steady_clock::now();
+                    }
+                    return true;
+                }
+                if (n == 0)
+                {
+                    return false;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    return true;
+                }
+                if (errno != EINTR)
+                {
+                    throw std::runtime_error("Connection lost");
+                }
+            }
+        }
+
+        /**
+         * @brief Moves the next request of a connection out of its received bytes.
+         *
+         * @param connection The connection; its verb and payload receive the request.
+         * @param max_size Largest accepted payload.
+         * @return False if the request has not been received in full yet.
+         */
+        bool takeRequest(Connection &connection, size_t max_size)
+        {
+            std::string &received = connection.received;
+            size_t line = received.find('\n');
+            if (line == std::string::npos)
+            {
+                if (received.size() > MAX_HEADER)
+                {
+                    throw std::runtime_error("Malformed message header");
+                }
+                return false;
+            }
+            size_t size = parseHeader(received.substr(0, line), connection.verb, max_size);
+            size_t end = line + 1 + size;
+            if (received.size() < end)
+            {
+                return false;
+            }
+            if (received.size() == end)
+            {
+                received.erase(0, line + 1);
+                connection.payload.swap(received);
+                received.clear();
+            }
+            else
+            {
+                // Pipelined requests: keep the bytes of the next one.
+                connection.payload.assign(received, line + 1, size);
+                received.erase(0, end);
+                connection.started = std::chrono::steady_clock::now();
+            }
+            return true;
+        }
+
+        /**
+         * @brief Draws a parsed document into the canvas kept by the calling worker.
+         *
+         * @param doc The document.
+         * @param options The rendering options.
+         * @return The canvas, valid until the next call on the same thread.
+         */
+        PNGImage &renderDocument(tinyxml2::XMLDocument &doc, const RenderOptions &options)
+        {
+            thread_local std::unique_ptr<PNGImage> canvas;
+            Point dimensions;
+            std::vector<std::unique_ptr<SVGElement>> svg_elements;
+            readSVG(doc.RootElement(), dimensions, svg_elements, options.cancel);
+            RenderStats stats;
+            enforceBudget(svg_elements, dimensions, options, stats);
+            if (!canvas || canvas->width() != dimensions.x || canvas->height() != dimensions.y)
+            {
+                canvas.reset();
+                canvas.reset(new PNGImage(dimensions.x, dimensions.y, false));
+            }
+            renderScene(svg_elements, *canvas, options, &stats);
+            throwIfTruncated(stats, options);
+            return *canvas;
+        }
+
+        /**
+         * @brief Answers one request.
+         *
+         * @param verb The request type.
+         * @param payload The request payload.
+         * @param options The server options (rendering options and size limit).
+         * @return The answer payload.
+         */
+        std::string answer(const std::string &verb, const std::string &payload, const ServerOptions &options)
+        {
+            tinyxml2::XMLDocument doc;
+            // A compressed document may not inflate beyond the largest uncompressed request.
+            if (verb == "SVG")
+            {
+                parseXML(doc, payload.data(), payload.size(), "request", options.max_request);
+                return renderDocument(doc, options.render).encode();
+            }
+            if (verb == "FILE")
+            {
+                size_t split = payload.find('\0');
+                if (split == std::string::npos)
+                {
+                    throw std::invalid_argument("FILE request needs two file names");
+                }
+                std::string svg_file = payload.substr(0, split);
+                std::string png_file = payload.substr(split + 1);
+                if (SceneFile::probe(svg_file))
+                {
+                    convert(svg_file, png_file, options.render);
+                }
+                else
+                {
+                    loadXML(doc, svg_file, options.max_request);
+                    renderDocument(doc, options.render).save(png_file);
+                }
+                return std::string();
+            }
+            throw std::invalid_argument("Unknown request: " + verb);
+        }
+
+        /**
+         * @brief Answers the request taken from a connection.
+         *
+         * @return False if the answer could not be sent (the connection is then closed).
+         */
+        bool answerRequest(Connection &connection, const ServerOptions &options,
+                           std::atomic<uint64_t> &requests, std::atomic<uint64_t> &errors)
+        {
+            std::string result;
+            bool ok = true;
+            try
+            {
+                result = answer(connection.verb, connection.payload, options);
+            }
+            catch (const std::exception &e)
+            {
+                result = e.what();
+                ok = false;
+                errors++;
+            }
+            std::string().swap(connection.payload);
+            requests++;
+            try
+            {
+                sendMessage(connection.fd, ok ? "OK" : "ERROR", result);
+                return true;
+            }
+            catch (const std::exception &)
+            {
+                // Broken connection, or the client stopped reading its answers.
+                errors++;
+            }
+            ::close(connection.fd);
+            return false;
+        }
+    }
+
+    ServerOptions::ServerOptions()
+    {
+        render.budget.max_bytes = SERVER_MAX_BYTES;
+        render.budget.max_pixels = SERVER_MAX_PIXELS;
+    }
+
+    ServerStats serve(const std::string &socket_path, const ServerOptions &options, const CancellationToken *stop)
+    {
+        sockaddr_un address = socketAddress(socket_path);
+        Descriptor listener{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        if (listener.fd < 0)
+        {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        // Replace a socket left behind by an earlier server, but never another kind of file.
+        struct stat existing;
+        if (::lstat(socket_path.c_str(), &existing) == 0)
+        {
+            if (!S_ISSOCK(existing.st_mode))
+            {
+                throw std::runtime_error("Unable to listen on " + socket_path + ": not a socket");
+            }
+            ::unlink(socket_path.c_str());
+        }
+        if (::bind(listener.fd, (const sockaddr *)&address, sizeof(address)) < 0 || ::listen(listener.fd, 64) < 0)
+        {
+            throw std::runtime_error("Unable to listen on " + socket_path + ": " + std::strerror(errno));
+        }
+        // Workers hand connections back through this pipe once they have answered a request.
+        int wake[2];
+        if (::pipe2(wake, O_CLOEXEC | O_NONBLOCK) < 0)
+        {
+            throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+        }
+        Descriptor wake_read{wake[0]}, wake_write{wake[1]};
+
+        ServerOptions task_options = options;
+        if (task_options.render.cancel == nullptr)
+        {
+            task_options.render.cancel = stop;
+        }
+        std::atomic<uint64_t> connections(0), requests(0), errors(0);
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Connection>> returned;
+        // Connections receiving their next request, read by this thread so
+        // that workers only ever answer complete requests.
+        std::vector<std::shared_ptr<Connection>> idle;
+        const std::chrono::milliseconds timeout(options.timeout_ms);
+        {
+            // Declared last: its destructor waits for the requests in progress.
+            ThreadPool workers(options.workers);
+            std::vector<pollfd> events;
+            while (stop == nullptr || !stop->cancelled())
+            {
+                events.assign({{listener.fd, POLLIN, 0}, {wake_read.fd, POLLIN, 0}});
+                bool partial = false;
+                for (const std::shared_ptr<Connection> &connection : idle)
+                {
+                    events.push_back({connection->fd, POLLIN, 0});
+                    partial = partial || !connection->received.empty();
+                }
+                size_t polled = idle.size();
+                if (::poll(events.data(), events.size(), stop == nullptr && !partial ? -1 : STOP_CHECK_MS) < 0 &&
+                    errno != EINTR)
+                {
+                    throw std::runtime_error(std::string("poll: ") + std::strerror(errno));
+                }
+                if (events[1].revents != 0)
+                {
+                    char buffer[256];
+                    while (::read(wake_read.fd, buffer, sizeof(buffer)) > 0)
+                    {
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    idle.insert(idle.end(), returned.begin(), returned.end());
+                    returned.clear();
+                }
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                std::vector<std::shared_ptr<Connection>> waiting;
+                for (size_t i = 0; i < idle.size(); i++)
+                {
+                    std::shared_ptr<Connection> connection = idle[i];
+                    bool open = true;
+                    try
+                    {
+                        if (i < polled && events[i + 2].revents != 0 && !receiveAvailable(*connection))
+                        {
+                            // A request cut short is an error; a closed idle connection is not.
+                            errors += connection->received.empty() ? 0 : 1;
+                            open = false;
+                        }
+                        else if (takeRequest(*connection, options.max_request))
+                        {
+                            workers.submit([connection, &task_options, &requests, &errors, &mutex, &returned, &wake_write]()
+                                           {
+                                               if (answerRequest(*connection, task_options, requests, errors))
+                                               {
+                                                   std::lock_guard<std::mutex> lock(mutex);
+                                                   returned.push_back(connection);
+                                                   char c = 0;
+                                                   (void)!::write(wake_write.fd, &c, 1);
+                                               }
+                                           });
+                            continue;
+                        }
+                        else if (!connection->received.empty() && now - connection->started > timeout)
+                        {
+                            // Too slow to send its request: do not let it hold memory forever.
+                            errors++;
+                            open = false;
+                        }
+                    }
+                    catch (const std::exception &)
+                    {
+                        // Broken or malformed connection: drop it.
+                        errors++;
+                        open = false;
+                    }
+                    if (open)
+                    {
+                        waiting.push_back(connection);
+                    }
+                    else
+                    {
+                        ::close(connection->fd);
+                    }
+                }
+                idle.swap(waiting);
+                if (events[0].revents != 0)
+                {
+                    int fd = ::accept4(listener.fd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd >= 0)
+                    {
+                        // Answers to a client that stops reading fail after the timeout.
+                        timeval send_timeout = {(time_t)(options.timeout_ms / 1000),
+                                                (suseconds_t)(options.timeout_ms % 1000 * 1000)};
+                        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+                        connections++;
+                        idle.push_back(std::make_shared<Connection>());
+                        idle.back()->fd = fd;
+                    }
+                }
+            }
+        }
+        for (const std::shared_ptr<Connection> &connection : idle)
+        {
+            ::close(connection->fd);
+        }
+        for (const std::shared_ptr<Connection> &connection : returned)
+        {
+            ::close(connection->fd);
+        }
+        ::unlink(socket_path.c_str());
+        ServerStats stats;
+        stats.connections = connections;
+        stats.requests = requests;
+        stats.errors = errors;
+        return stats;
+    }
+
+    ConversionClient::ConversionClient(const std::string &socket_path)
+        : fd_(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0))
+    {
+        if (fd_ < 0)
+        {
+            throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+        }
+        sockaddr_un address = socketAddress(socket_path);
+        if (::connect(fd_, (const sockaddr *)&address, sizeof(address)) < 0)
+        {
+            int error = errno;
+            ::close(fd_);
+            throw std::runtime_error("Unable to connect to " + socket_path + ": " + std::strerror(error));
+        }
+    }
+
+    ConversionClient::~ConversionClient()
+    {
+        ::close(fd_);
+    }
+
+    std::string ConversionClient::request(const char *verb, const std::string &payload)
+    {
+        sendMessage(fd_, verb, payload);
+        std::string status, result;
+        if (!receiveMessage(fd_, status, result, (size_t)-1, nullptr))
+        {
+            throw std::runtime_error("Connection closed by the server");
+        }
+        if (status != "OK")
+        {
+            throw std::runtime_error(result);
+        }
+        return result;
+    }
+
+    std::string ConversionClient::convertData(const std::string &svg_data)
+    {
+        return request("SVG", svg_data);
+    }
+
+    void ConversionClient::convertFile(const std::string &svg_file, const std::string &png_file)
+    {
+        request("FILE", svg_file + '\0' + png_file);
+    }
+}
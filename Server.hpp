@@ -0,0 +1,102 @@
+//! @file Server.hpp
+#ifndef __svg_Server_hpp__
+#define __svg_Server_hpp__
+
+#include "Cancellation.hpp"
+#include "SVGElements.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace svg
+{
+    //! Default limit on the image and vertex memory of a request (bytes).
+    const uint64_t SERVER_MAX_BYTES = 512u << 20;
+    //! Default limit on the pixels covered by the elements of a request.
+    const uint64_t SERVER_MAX_PIXELS = 1u << 30;
+
+    //! Options of serve().
+    struct ServerOptions
+    {
+        //! Constructor: limits each request to SERVER_MAX_BYTES and
+        //! SERVER_MAX_PIXELS, rejecting the documents that do not fit.
+        ServerOptions();
+        //! Rendering options applied to every request.
+        RenderOptions render;
+        //! Worker threads, each answering one request at a time (0: one per core).
+        unsigned workers = 0;
+        //! Largest accepted request payload, and largest size of a
+        //! compressed document once inflated (bytes).
+        size_t max_request = 256u << 20;
+        //! Longest time a client may take to send a request once it has
+        //! started, or to take in an answer, before it is disconnected
+        //! (milliseconds).
+        unsigned timeout_ms = 10000;
+    };
+
+    //! Counters of a server, returned when it stops.
+    struct ServerStats
+    {
+        //! Accepted connections.
+        uint64_t connections = 0;
+        //! Answered requests.
+        uint64_t requests = 0;
+        //! Requests answered with an error.
+        uint64_t errors = 0;
+    };
+
+    //! Serve conversions on a Unix domain socket until a token is cancelled.
+    //!
+    //! Each connection carries any number of requests, answered in order.
+    //! A request is a line "SVG <n>" or "FILE <n>" followed by n bytes:
+    //! an SVG document (possibly gzip-compressed) to convert to PNG bytes,
+    //! or an SVG file and a PNG file name (as seen by the server) separated
+    //! by a null byte. The answer is a line "OK <n>" followed by the PNG
+    //! bytes (none for FILE requests), or "ERROR <n>" followed by a message.
+    //!
+    //! Requests are read by the calling thread and answered by a pool of
+    //! workers that stays up between requests. A worker is only taken once
+    //! a request has been received in full, so idle or slow clients never
+    //! hold one, and any number of clients may stay connected. Each worker
+    //! keeps its canvas while the image size does not change.
+    //! @param socket_path Path of the socket (an existing socket there is
+    //! replaced; any other file makes serve() throw).
+    //! @param options Server options.
+    //! @param stop Token checked a few times per second; it also cancels the
+    //! conversions in progress (nullptr: serve forever).
+    //! @return Counters.
+    ServerStats serve(const std::string &socket_path, const ServerOptions &options,
+                      const CancellationToken *stop = nullptr);
+
+    //! Connection to a server started with serve().
+    class ConversionClient
+    {
+    public:
+        //! Constructor: connects to the server.
+        //! @param socket_path Path of the server socket.
+        explicit ConversionClient(const std::string &socket_path);
+        //! Destructor: closes the connection.
+        ~ConversionClient();
+        ConversionClient(const ConversionClient &) = delete;
+        ConversionClient &operator=(const ConversionClient &) = delete;
+        //! Convert a document held in memory.
+        //! @param svg_data SVG document (possibly gzip-compressed).
+        //! @return Contents of the PNG file.
+        std::string convertData(const std::string &svg_data);
+        //! Have the server convert a file and write the result.
+        //! @param svg_file SVG (or scene) file, as seen by the server.
+        //! @param png_file PNG file to write, as seen by the server.
+        void convertFile(const std::string &svg_file, const std::string &png_file);
+
+    private:
+        //! Send a request and wait for its answer.
+        //! @param verb Request type.
+        //! @param payload Request payload.
+        //! @return Answer payload (throws the server's error message).
+        std::string request(const char *verb, const std::string &payload);
+        //! Socket.
+        int fd_;
+    };
+}
+#endif
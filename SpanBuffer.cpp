@@ -0,0 +1,144 @@
+//! @file SpanBuffer.cpp
+#include "SpanBuffer.hpp"
+#include "PNGImage.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace svg
+{
+    SpanBuffer::SpanBuffer()
+        : width_(0), height_(0), spans_(0), painted_(0)
+    {
+    }
+
+    void SpanBuffer::reset(int w, int h)
+    {
+        width_ = w;
+        height_ = h;
+        if (rows_.size() < (size_t)h)
+        {
+            rows_.resize(h);
+        }
+        for (std::vector<Span> &r : rows_)
+        {
+            r.clear();
+        }
+        spans_ = 0;
+        painted_ = 0;
+    }
+
+    int SpanBuffer::width() const
+    {
+        return width_;
+    }
+
+    int SpanBuffer::height() const
+    {
+        return height_;
+    }
+
+    void SpanBuffer::add(int y, int x0, int x1, const Color &c)
+    {
+        if (y < 0 || y >= height_)
+        {
+            return;
+        }
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width_ - 1);
+        if (x0 > x1)
+        {
+            return;
+        }
+        painted_ += x1 - x0 + 1;
+        std::vector<Span> &r = rows_[y];
+        // Outlines arrive one pixel at a time; extend the last span when
+        // the new one continues it with the same color.
+        if (!r.empty())
+        {
+            Span &last = r.back();
+            if (last.c.red == c.red && last.c.green == c.green && last.c.blue == c.blue &&
+                x0 <= last.x1 + 1 && x1 >= last.x0 - 1)
+            {
+                last.x0 = std::min(last.x0, x0);
+                last.x1 = std::max(last.x1, x1);
+                return;
+            }
+        }
+        r.push_back({x0, x1, c});
+        spans_++;
+    }
+
+    int SpanBuffer::uncovered(int x)
+    {
+        while (next_[x] != x)
+        {
+            next_[x] = next_[next_[x]];
+            x = next_[x];
+        }
+        return x;
+    }
+
+    void SpanBuffer::resolve(PNGImage &img, const Color &background)
+    {
+        assert(img.width() == width_ && img.height() == height_);
+        next_.resize(width_ + 1);
+        for (int y = 0; y < height_; y++)
+        {
+            Color *pixel_row = img.row(y);
+            for (int x = 0; x <= width_; x++)
+            {
+                next_[x] = x;
+            }
+            int left = width_;
+            const std::vector<Span> &r = rows_[y];
+            for (size_t i = r.size(); i-- > 0 && left > 0;)
+            {
+                const Span &s = r[i];
+                for (int x = uncovered(s.x0); x <= s.x1; x = uncovered(x))
+                {
+                    int end = x;
+                    while (end <= s.x1 && next_[end] == end)
+                    {
+                        end++;
+                    }
+                    for (int k = x; k < end; k++)
+                    {
+                        pixel_row[k] = s.c;
+                        next_[k] = end;
+                    }
+                    left -= end - x;
+                }
+            }
+            if (left > 0)
+            {
+                for (int x = 0; x < width_; x++)
+                {
+                    if (next_[x] == x)
+                    {
+                        pixel_row[x] = background;
+                    }
+                }
+            }
+        }
+    }
+
+    size_t SpanBuffer::span_count() const
+    {
+        return spans_;
+    }
+
+    uint64_t SpanBuffer::painted() const
+    {
+        return painted_;
+    }
+
+    double SpanBuffer::overdraw() const
+    {
+        if (width_ <= 0 || height_ <= 0)
+        {
+            return 0;
+        }
+        return (double)painted_ / ((double)width_ * height_);
+    }
+}
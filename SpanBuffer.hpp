@@ -0,0 +1,82 @@
+//! @file SpanBuffer.hpp
+#ifndef __svg_SpanBuffer_hpp__
+#define __svg_SpanBuffer_hpp__
+
+#include "Color.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace svg
+{
+    class PNGImage;
+
+    //! Row-by-row record of the horizontal runs painted by a scene.
+    //! Spans are kept in painting order and resolved front to back, so
+    //! every pixel of the image is written exactly once, no matter how many
+    //! elements cover it.
+    class SpanBuffer
+    {
+    public:
+        //! Constructor of an empty buffer.
+        SpanBuffer();
+        //! Discard all spans and set the size of the area they cover.
+        //! Memory used by previous scenes is kept for reuse.
+        //! @param w Width.
+        //! @param h Height.
+        void reset(int w, int h);
+        //! Get the width of the covered area.
+        //! @return The width.
+        int width() const;
+        //! Get the height of the covered area.
+        //! @return The height.
+        int height() const;
+        //! Record a span painted on top of all previous ones.
+        //! Spans are clipped to the covered area.
+        //! @param y Row.
+        //! @param x0 First column.
+        //! @param x1 Last column (inclusive).
+        //! @param c Color of the span.
+        void add(int y, int x0, int x1, const Color &c);
+        //! Write the visible color of every pixel to an image.
+        //! Pixels covered by no span are set to the background.
+        //! @param img Image of the same size as the buffer.
+        //! @param background Color of uncovered pixels (white by default).
+        void resolve(PNGImage &img, const Color &background = Color{255, 255, 255});
+        //! Get the number of recorded spans.
+        //! @return The number of spans (after merging adjacent ones).
+        size_t span_count() const;
+        //! Get the number of pixels painted by all spans.
+        //! @return The painted pixel count, including hidden pixels.
+        uint64_t painted() const;
+        //! Get the overdraw ratio.
+        //! @return Painted pixels per image pixel.
+        double overdraw() const;
+
+    private:
+        //! Horizontal run of one color.
+        struct Span
+        {
+            int x0, x1;
+            Color c;
+        };
+
+        //! Find the first pixel of the row at or after x that is not yet written.
+        int uncovered(int x);
+
+        //! Width.
+        int width_;
+        //! Height.
+        int height_;
+        //! Spans of each row, in painting order.
+        std::vector<std::vector<Span>> rows_;
+        //! Per-column link to the next unwritten pixel (used by resolve).
+        std::vector<int> next_;
+        //! Number of spans.
+        size_t spans_;
+        //! Number of painted pixels.
+        uint64_t painted_;
+    };
+}
+#endif
@@ -0,0 +1,258 @@
+//! @file SpatialIndex.cpp
+#include "SpatialIndex.hpp"
+#include "PNGImage.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace svg
+{
+    namespace
+    {
+        //! Elements covering more cells than this are kept out of the grid.
+        const int64_t MAX_CELLS_PER_ELEMENT = 64;
+
+        /**
+         * @brief Checks if drawing an element sets a pixel.
+         *
+         * @param element The element.
+         * @param probe An image containing the pixel, clipped to it.
+         * @param p The pixel.
+         * @return True if the element draws p.
+         */
+        bool drawsPixel(const SVGElement &element, PNGImage &probe, const Point &p)
+        {
+            // An element of the background color leaves it as it is, so two backgrounds are tried.
+            const Color backgrounds[] = {{0, 0, 0}, {255, 255, 255}};
+            for (const Color &background : backgrounds)
+            {
+                probe.at(p.x, p.y) = background;
+                element.draw(probe);
+                Color c = probe.at(p.x, p.y);
+                if (c.red != background.red || c.green != background.green || c.blue != background.blue)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    SpatialIndex::SpatialIndex()
+        : cell_size_(1), columns_(0), rows_(0)
+    {
+    }
+
+    void SpatialIndex::build(const std::vector<std::unique_ptr<SVGElement>> &svg_elements)
+    {
+        entries_.clear();
+        order_.clear();
+        cells_.clear();
+        large_.clear();
+        area_ = Box();
+        std::vector<int> extents;
+        for (const std::unique_ptr<SVGElement> &e : svg_elements)
+        {
+            add(*e, extents);
+        }
+        if (extents.empty())
+        {
+            columns_ = rows_ = 0;
+            return;
+        }
+
+        // Cells about as large as a typical element, but no more than
+        // about two per element so the grid stays proportional to the scene.
+        std::nth_element(extents.begin(), extents.begin() + extents.size() / 2, extents.end());
+        double width = (double)area_.max.x - area_.min.x + 1;
+        double height = (double)area_.max.y - area_.min.y + 1;
+        double min_cell = std::sqrt(width * height / (2.0 * extents.size()));
+        cell_size_ = (int)std::max(1.0, std::ceil(std::max(min_cell, (double)extents[extents.size() / 2])));
+        columns_ = (int)std::ceil(width / cell_size_);
+        rows_ = (int)std::ceil(height / cell_size_);
+        cells_.resize((size_t)columns_ * rows_);
+        for (uint32_t i = 0; i < entries_.size(); i++)
+        {
+            insert(i);
+        }
+    }
+
+    void SpatialIndex::add(SVGElement &element, std::vector<int> &extents)
+    {
+        if (Group *g = dynamic_cast<Group *>(&element))
+        {
+            for (const std::unique_ptr<SVGElement> &e : g->elements())
+            {
+                add(*e, extents);
+            }
+            return;
+        }
+        Box bounds = element.bounds();
+        order_[&element] = (uint32_t)entries_.size();
+        entries_.push_back({&element, bounds});
+        if (!bounds.empty())
+        {
+            area_.extend(bounds);
+            extents.push_back(std::max(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y) + 1);
+        }
+    }
+
+    void SpatialIndex::cells(const Box &box, int &c0, int &r0, int &c1, int &r1) const
+    {
+        // Positions outside the grid area share its border cells.
+        auto column = [this](int x)
+        {
+            int64_t c = ((int64_t)x - area_.min.x) / cell_size_;
+            return (int)std::max<int64_t>(0, std::min<int64_t>(columns_ - 1, c));
+        };
+        auto row = [this](int y)
+        {
+            int64_t r = ((int64_t)y - area_.min.y) / cell_size_;
+            return (int)std::max<int64_t>(0, std::min<int64_t>(rows_ - 1, r));
+        };
+        c0 = column(box.min.x);
+        c1 = column(box.max.x);
+        r0 = row(box.min.y);
+        r1 = row(box.max.y);
+    }
+
+    void SpatialIndex::insert(uint32_t i)
+    {
+        const Box &bounds = entries_[i].bounds;
+        if (bounds.empty() || cells_.empty())
+        {
+            return;
+        }
+        int c0, r0, c1, r1;
+        cells(bounds, c0, r0, c1, r1);
+        if ((int64_t)(c1 - c0 + 1) * (r1 - r0 + 1) > MAX_CELLS_PER_ELEMENT)
+        {
+            large_.insert(std::lower_bound(large_.begin(), large_.end(), i), i);
+            return;
+        }
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                std::vector<uint32_t> &cell = cells_[(size_t)r * columns_ + c];
+                cell.insert(std::lower_bound(cell.begin(), cell.end(), i), i);
+            }
+        }
+    }
+
+    void SpatialIndex::erase(uint32_t i)
+    {
+        const Box &bounds = entries_[i].bounds;
+        if (bounds.empty() || cells_.empty())
+        {
+            return;
+        }
+        int c0, r0, c1, r1;
+        cells(bounds, c0, r0, c1, r1);
+        if ((int64_t)(c1 - c0 + 1) * (r1 - r0 + 1) > MAX_CELLS_PER_ELEMENT)
+        {
+            large_.erase(std::lower_bound(large_.begin(), large_.end(), i));
+            return;
+        }
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                std::vector<uint32_t> &cell = cells_[(size_t)r * columns_ + c];
+                cell.erase(std::lower_bound(cell.begin(), cell.end(), i));
+            }
+        }
+    }
+
+    void SpatialIndex::update(const SVGElement &element)
+    {
+        if (const Group *g = dynamic_cast<const Group *>(&element))
+        {
+            for (const std::unique_ptr<SVGElement> &e : g->elements())
+            {
+                update(*e);
+            }
+            return;
+        }
+        std::unordered_map<const SVGElement *, uint32_t>::const_iterator it = order_.find(&element);
+        if (it == order_.end())
+        {
+            return;
+        }
+        Box bounds = element.bounds();
+        if (cells_.empty() && !bounds.empty())
+        {
+            // The grid was built without any visible element.
+            area_ = bounds;
+            cell_size_ = std::max(bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y) + 1;
+            columns_ = rows_ = 1;
+            cells_.resize(1);
+        }
+        erase(it->second);
+        entries_[it->second].bounds = bounds;
+        insert(it->second);
+    }
+
+    std::vector<SVGElement *> SpatialIndex::collect(std::vector<uint32_t> &found, const Box &region) const
+    {
+        std::sort(found.begin(), found.end());
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        std::vector<SVGElement *> result;
+        for (size_t k = found.size(); k-- > 0;)
+        {
+            const Entry &e = entries_[found[k]];
+            if (e.bounds.intersects(region))
+            {
+                result.push_back(e.element);
+            }
+        }
+        return result;
+    }
+
+    std::vector<SVGElement *> SpatialIndex::at(const Point &p) const
+    {
+        // The bounds of curved and slanted shapes have corners they do not draw.
+        std::vector<SVGElement *> found = in(Box{p, p});
+        if (found.empty())
+        {
+            return found;
+        }
+        if (p.x < 0 || p.y < 0 || (int64_t)(p.x + 1) * (p.y + 1) > INT_MAX / (int64_t)sizeof(Color))
+        {
+            return {}; // No image has this pixel.
+        }
+        // Each candidate is drawn where it is, clipped to the pixel: the rest
+        // of the image is never written, nor its memory touched.
+        PNGImage probe(p.x + 1, p.y + 1, false);
+        probe.set_clip(Box{p, p});
+        found.erase(std::remove_if(found.begin(), found.end(),
+                                   [&probe, &p](const SVGElement *e) { return !drawsPixel(*e, probe, p); }),
+                    found.end());
+        return found;
+    }
+
+    std::vector<SVGElement *> SpatialIndex::in(const Box &region) const
+    {
+        std::vector<uint32_t> found(large_);
+        if (!cells_.empty() && !region.empty())
+        {
+            int c0, r0, c1, r1;
+            cells(region, c0, r0, c1, r1);
+            for (int r = r0; r <= r1; r++)
+            {
+                for (int c = c0; c <= c1; c++)
+                {
+                    const std::vector<uint32_t> &cell = cells_[(size_t)r * columns_ + c];
+                    found.insert(found.end(), cell.begin(), cell.end());
+                }
+            }
+        }
+        return collect(found, region);
+    }
+
+    size_t SpatialIndex::size() const
+    {
+        return entries_.size();
+    }
+}
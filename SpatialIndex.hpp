@@ -0,0 +1,86 @@
+//! @file SpatialIndex.hpp
+#ifndef __svg_SpatialIndex_hpp__
+#define __svg_SpatialIndex_hpp__
+
+#include "SVGElements.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace svg
+{
+    //! Uniform grid over the bounding boxes of the shapes of a scene,
+    //! answering which shapes draw at a pixel or may draw within a region.
+    //! Groups are entered, so results are the shapes inside them (never a
+    //! group), ordered topmost first (the reverse of drawing order).
+    //! The index does not observe its shapes: after a shape (or a group
+    //! holding it) is changed with translate(), rotate(), scale(), shrink(),
+    //! simplify() or assign(), update() must be called before the next query.
+    class SpatialIndex
+    {
+    public:
+        //! Constructor of an empty index.
+        SpatialIndex();
+        //! Index the shapes of a list of elements, replacing the previous
+        //! contents. The elements are not owned and must outlive their use
+        //! in the index.
+        //! @param svg_elements Elements, in drawing order.
+        void build(const std::vector<std::unique_ptr<SVGElement>> &svg_elements);
+        //! Refresh the position of a shape after it was transformed.
+        //! @param element An indexed shape, or a group whose shapes are all
+        //! refreshed (e.g. after transforming the whole group).
+        void update(const SVGElement &element);
+        //! Find the elements that draw a pixel. Candidates are found by
+        //! their bounds, then drawn clipped to the pixel, so a pixel near the
+        //! corner of a circle's bounds is not reported for the circle.
+        //! @param p Pixel.
+        //! @return The elements, topmost first.
+        std::vector<SVGElement *> at(const Point &p) const;
+        //! Find the elements whose bounds overlap a region.
+        //! @param region Region (both corners included).
+        //! @return The elements, topmost first.
+        std::vector<SVGElement *> in(const Box &region) const;
+        //! Get the number of indexed shapes.
+        //! @return The number of shapes.
+        size_t size() const;
+
+    private:
+        //! Indexed element.
+        struct Entry
+        {
+            SVGElement *element;
+            Box bounds;
+        };
+
+        //! Append the shapes of an element to entries_, in drawing order.
+        void add(SVGElement &element, std::vector<int> &extents);
+        //! Get the range of cells covered by a box (clamped to the grid).
+        void cells(const Box &box, int &c0, int &r0, int &c1, int &r1) const;
+        //! Add an entry to the cells covered by its bounds.
+        void insert(uint32_t i);
+        //! Remove an entry from the cells covered by its bounds.
+        void erase(uint32_t i);
+        //! Keep the entries of a candidate list that overlap a region.
+        std::vector<SVGElement *> collect(std::vector<uint32_t> &found, const Box &region) const;
+
+        //! Shapes in drawing order.
+        std::vector<Entry> entries_;
+        //! Position of each shape in entries_.
+        std::unordered_map<const SVGElement *, uint32_t> order_;
+        //! Area covered by the grid.
+        Box area_;
+        //! Side of a cell, in pixels.
+        int cell_size_;
+        //! Number of columns.
+        int columns_;
+        //! Number of rows.
+        int rows_;
+        //! Entries of each cell, in drawing order.
+        std::vector<std::vector<uint32_t>> cells_;
+        //! Entries covering too many cells, checked on every query.
+        std::vector<uint32_t> large_;
+    };
+}
+#endif
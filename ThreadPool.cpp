@@ -0,0 +1,124 @@
+//! @file ThreadPool.cpp
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace svg
+{
+    namespace
+    {
+        //! Pool and index of the worker running on this thread, if any.
+        thread_local const ThreadPool *current_pool = nullptr;
+        thread_local unsigned current_worker = 0;
+    }
+
+    ThreadPool::ThreadPool(unsigned threads)
+        : pending_(0), stopping_(false), next_queue_(0)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 0; i < threads; i++)
+        {
+            queues_.emplace_back(new Queue);
+        }
+        for (unsigned i = 0; i < threads; i++)
+        {
+            threads_.emplace_back(&ThreadPool::run, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread &t : threads_)
+        {
+            t.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> task)
+    {
+        unsigned target = current_pool == this ? current_worker : next_queue_++ % size();
+        {
+            // Hold mutex_ while queueing so that pending_ is counted before
+            // any worker can take the task and count it down.
+            std::lock_guard<std::mutex> lock(mutex_);
+            {
+                std::lock_guard<std::mutex> queue_lock(queues_[target]->mutex);
+                queues_[target]->tasks.push_back(std::move(task));
+            }
+            pending_++;
+        }
+        wake_.notify_one();
+    }
+
+    unsigned ThreadPool::size() const
+    {
+        return (unsigned)queues_.size();
+    }
+
+    ThreadPool &ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    bool ThreadPool::take(unsigned self, std::function<void()> &task)
+    {
+        {
+            Queue &own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned k = 1; k < size(); k++)
+        {
+            Queue &other = *queues_[(self + k) % size()];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks.empty())
+            {
+                task = std::move(other.tasks.front());
+                other.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::run(unsigned self)
+    {
+        current_pool = this;
+        current_worker = self;
+        std::function<void()> task;
+        for (;;)
+        {
+            if (take(self, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pending_--;
+                }
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+            if (stopping_ && pending_ == 0)
+            {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+//! @file ThreadPool.hpp
+#ifndef __svg_ThreadPool_hpp__
+#define __svg_ThreadPool_hpp__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace svg
+{
+    //! Fixed set of worker threads running submitted tasks. Each worker has
+    //! its own task queue; an idle worker takes work from the others, so
+    //! long conversions do not hold up the tasks queued behind them.
+    class ThreadPool
+    {
+    public:
+        //! Constructor.
+        //! @param threads Number of workers (0: one per core).
+        explicit ThreadPool(unsigned threads = 0);
+        //! Destructor: runs the tasks still queued, then stops the workers.
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        //! Queue a task. Tasks submitted by a worker go to its own queue.
+        //! @param task Task to run; it must not throw.
+        void submit(std::function<void()> task);
+        //! Get the number of workers.
+        //! @return Number of workers.
+        unsigned size() const;
+        //! Get the pool shared by the asynchronous conversion functions.
+        //! @return Pool with one worker per core.
+        static ThreadPool &shared();
+
+    private:
+        //! Task queue of one worker.
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+        //! Take a task: the newest of the worker's own queue, else the
+        //! oldest of another worker's queue.
+        //! @param self Worker index.
+        //! @param task Where to store the task.
+        //! @return False if all queues are empty.
+        bool take(unsigned self, std::function<void()> &task);
+        //! Worker loop.
+        //! @param self Worker index.
+        void run(unsigned self);
+
+        //! One queue per worker.
+        std::vector<std::unique_ptr<Queue>> queues_;
+        //! Workers.
+        std::vector<std::thread> threads_;
+        //! Protects pending_ and stopping_.
+        std::mutex mutex_;
+        //! Signalled when a task is queued or the pool stops.
+        std::condition_variable wake_;
+        //! Number of queued tasks.
+        size_t pending_;
+        //! Set by the destructor.
+        bool stopping_;
+        //! Queue receiving the next task submitted from outside the pool.
+        std::atomic<unsigned> next_queue_;
+    };
+}
+#endif
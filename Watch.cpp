@@ -0,0 +1,293 @@
+//! @file Watch.cpp
+#include "Watch.hpp"
+#include "Budget.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace svg
+{
+    namespace
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        //! Extra pixels redrawn around a changed area (anti-aliased edges
+        //! may reach just past the bounds of an element).
+        const int DIRTY_MARGIN = 2;
+
+        /**
+         * @brief Checks if a file name ends with ".svg" or ".svgz".
+         */
+        bool isSVG(const std::string &name)
+        {
+            return (name.size() > 4 && name.compare(name.size() - 4, 4, ".svg") == 0) ||
+                   (name.size() > 5 && name.compare(name.size() - 5, 5, ".svgz") == 0);
+        }
+
+        /**
+         * @brief Gets the output file of an input file name.
+         */
+        std::string outputFile(const std::string &output_dir, const std::string &name)
+        {
+            return output_dir + "/" + name.substr(0, name.rfind('.')) + ".png";
+        }
+    }
+
+    struct IncrementalRenderer::Entry
+    {
+        //! Image as last written.
+        std::unique_ptr<PNGImage> canvas;
+        //! XML of each top-level element that readSVG draws, in order.
+        std::vector<std::string> xml;
+        //! Bounds of the same elements.
+        std::vector<Box> bounds;
+    };
+
+    IncrementalRenderer::IncrementalRenderer(const RenderOptions &options)
+        : options_(options)
+    {
+    }
+
+    IncrementalRenderer::~IncrementalRenderer()
+    {
+    }
+
+    void IncrementalRenderer::forget(const std::string &svg_file)
+    {
+        entries_.erase(svg_file);
+    }
+
+    RenderUpdate IncrementalRenderer::update(const std::string &svg_file, const std::string &png_file)
+    {
+        Clock::time_point start = Clock::now();
+        RenderUpdate result;
+        result.svg_file = svg_file;
+        result.png_file = png_file;
+        try
+        {
+            tinyxml2::XMLDocument doc;
+            loadXML(doc, svg_file);
+            if (doc.RootElement() == nullptr)
+            {
+                throw std::runtime_error("Unable to load " + svg_file);
+            }
+            std::unique_ptr<Entry> next(new Entry);
+            bool uses = false;
+            for (const tinyxml2::XMLElement *child = doc.RootElement()->FirstChildElement(); child != nullptr;
+                 child = child->NextSiblingElement())
+            {
+                if (readsAsElement(child->Name()))
+                {
+                    tinyxml2::XMLPrinter printer(nullptr, true);
+                    child->Accept(&printer);
+                    next->xml.push_back(printer.CStr());
+                    uses = uses || next->xml.back().find("<use") != std::string::npos;
+                }
+            }
+            Point dimensions;
+            std::vector<std::unique_ptr<SVGElement>> svg_elements;
+            readSVG(doc.RootElement(), dimensions, svg_elements, options_.cancel);
+            // A truncated scene has fewer top-level elements than the XML,
+            // so it is always redrawn in full.
+            RenderStats stats;
+            enforceBudget(svg_elements, dimensions, options_, stats);
+            const std::vector<std::unique_ptr<SVGElement>> &top = dynamic_cast<Group &>(*svg_elements.front()).elements();
+            for (const std::unique_ptr<SVGElement> &e : top)
+            {
+                next->bounds.push_back(e->bounds());
+            }
+
+            std::unique_ptr<Entry> &entry = entries_[svg_file];
+            bool reuse = entry && entry->canvas->width() == dimensions.x && entry->canvas->height() == dimensions.y &&
+                         !uses && next->bounds.size() == next->xml.size() && !options_.span_buffer;
+            if (reuse)
+            {
+                // The elements before the first difference and after the last
+                // one are unchanged; the rest covered or now covers the dirty area.
+                const Entry &old = *entry;
+                size_t prefix = 0, suffix = 0;
+                size_t n_old = old.xml.size(), n_new = next->xml.size();
+                while (prefix < n_old && prefix < n_new && old.xml[prefix] == next->xml[prefix])
+                {
+                    prefix++;
+                }
+                while (suffix < n_old - prefix && suffix < n_new - prefix &&
+                       old.xml[n_old - 1 - suffix] == next->xml[n_new - 1 - suffix])
+                {
+                    suffix++;
+                }
+                Box dirty;
+                for (size_t i = prefix; i < n_old - suffix; i++)
+                {
+                    dirty.extend(old.bounds[i]);
+                }
+                for (size_t i = prefix; i < n_new - suffix; i++)
+                {
+                    dirty.extend(next->bounds[i]);
+                }
+                PNGImage &img = *entry->canvas;
+                if (!dirty.empty())
+                {
+                    dirty.min = {std::max(dirty.min.x - DIRTY_MARGIN, 0), std::max(dirty.min.y - DIRTY_MARGIN, 0)};
+                    dirty.max = {std::min(dirty.max.x + DIRTY_MARGIN, img.width() - 1),
+                                 std::min(dirty.max.y + DIRTY_MARGIN, img.height() - 1)};
+                }
+                result.incremental = true;
+                if (!dirty.empty())
+                {
+                    img.set_clip(dirty);
+                    img.set_antialiasing(false);
+                    img.draw_rect(dirty.min, dirty.max, {255, 255, 255});
+                    img.set_antialiasing(options_.antialias);
+                    img.set_cancellation(options_.cancel);
+                    try
+                    {
+                        for (size_t i = 0; i < top.size(); i++)
+                        {
+                            if (next->bounds[i].intersects(dirty))
+                            {
+                                // Same pass as renderScene applies to a full redraw.
+                                if (options_.simplify)
+                                {
+                                    top[i]->simplify(options_.simplify_tolerance);
+                                }
+                                top[i]->draw(img);
+                            }
+                        }
+                    }
+                    catch (...)
+                    {
+                        img.set_clip(Box());
+                        img.set_cancellation(nullptr);
+                        entries_.erase(svg_file);
+                        throw;
+                    }
+                    img.set_clip(Box());
+                    img.set_cancellation(nullptr);
+                    img.save(png_file);
+                    result.region = dirty;
+                }
+                next->canvas = std::move(entry->canvas);
+            }
+            else
+            {
+                next->canvas.reset(new PNGImage(dimensions.x, dimensions.y, false));
+                renderScene(svg_elements, *next->canvas, options_);
+                next->canvas->save(png_file);
+                result.region = Box{{0, 0}, {dimensions.x - 1, dimensions.y - 1}};
+            }
+            entry = std::move(next);
+            throwIfTruncated(stats, options_);
+        }
+        catch (const std::exception &e)
+        {
+            entries_.erase(svg_file);
+            result.error = e.what();
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        return result;
+    }
+
+    void watchDirectory(const std::string &input_dir, const std::string &output_dir, const WatchOptions &options,
+                        const std::function<void(const RenderUpdate &)> &report, const CancellationToken *stop)
+    {
+        int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("inotify_init1: ") + std::strerror(errno));
+        }
+        struct Closer
+        {
+            int fd;
+            ~Closer() { ::close(fd); }
+        } closer{fd};
+        // Editors either rewrite a file in place or rename a new file over it.
+        if (::inotify_add_watch(fd, input_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0)
+        {
+            throw std::runtime_error("Unable to watch " + input_dir + ": " + std::strerror(errno));
+        }
+
+        IncrementalRenderer renderer(options.render);
+        DIR *dir = ::opendir(input_dir.c_str());
+        if (dir == nullptr)
+        {
+            throw std::runtime_error("Unable to read " + input_dir);
+        }
+        std::vector<std::string> names;
+        while (const dirent *d = ::readdir(dir))
+        {
+            if (isSVG(d->d_name))
+            {
+                names.push_back(d->d_name);
+            }
+        }
+        ::closedir(dir);
+        std::sort(names.begin(), names.end());
+        for (const std::string &name : names)
+        {
+            report(renderer.update(input_dir + "/" + name, outputFile(output_dir, name)));
+        }
+
+        // Changed files and the time of their last event; a file is converted
+        // once it has been quiet for the debounce time.
+        std::map<std::string, Clock::time_point> pending;
+        const std::chrono::milliseconds debounce(options.debounce_ms);
+        alignas(inotify_event) char buffer[16 * 1024];
+        while (stop == nullptr || !stop->cancelled())
+        {
+            int timeout = 200;
+            Clock::time_point now = Clock::now();
+            for (const auto &p : pending)
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(p.second + debounce - now).count();
+                timeout = std::min(timeout, (int)std::max<long long>(0, left));
+            }
+            pollfd events{fd, POLLIN, 0};
+            if (::poll(&events, 1, timeout) > 0)
+            {
+                ssize_t length;
+                while ((length = ::read(fd, buffer, sizeof(buffer))) > 0)
+                {
+                    for (char *p = buffer; p < buffer + length;)
+                    {
+                        const inotify_event *event = (const inotify_event *)p;
+                        p += sizeof(inotify_event) + event->len;
+                        std::string name = event->len > 0 ? event->name : "";
+                        if (!isSVG(name))
+                        {
+                            continue;
+                        }
+                        if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                        {
+                            pending.erase(name);
+                            renderer.forget(input_dir + "/" + name);
+                        }
+                        else
+                        {
+                            pending[name] = Clock::now();
+                        }
+                    }
+                }
+            }
+            now = Clock::now();
+            for (auto it = pending.begin(); it != pending.end();)
+            {
+                if (now - it->second < debounce)
+                {
+                    ++it;
+                    continue;
+                }
+                report(renderer.update(input_dir + "/" + it->first, outputFile(output_dir, it->first)));
+                it = pending.erase(it);
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+//! @file Watch.hpp
+#ifndef __svg_Watch_hpp__
+#define __svg_Watch_hpp__
+
+#include "SVGElements.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Result of IncrementalRenderer::update().
+    struct RenderUpdate
+    {
+        //! Converted file.
+        std::string svg_file;
+        //! Written file.
+        std::string png_file;
+        //! Whether only part of the cached image was redrawn.
+        bool incremental = false;
+        //! Redrawn pixels (the whole image if not incremental; empty if
+        //! nothing visible changed and the image was not written).
+        Box region;
+        //! Time taken (seconds).
+        double seconds = 0;
+        //! Error message, "" on success.
+        std::string error;
+    };
+
+    //! Converts files repeatedly, keeping the image and the layout of the
+    //! top-level elements of each file. When a file changes, the top-level
+    //! elements that differ are found by comparing their XML, and only the
+    //! area they covered before and cover now is redrawn.
+    class IncrementalRenderer
+    {
+    public:
+        //! Constructor.
+        //! @param options Rendering options (span buffering only applies to
+        //! full redraws; simplification and budgets apply to both kinds).
+        explicit IncrementalRenderer(const RenderOptions &options = RenderOptions());
+        ~IncrementalRenderer();
+        //! Convert a file, redrawing only what changed since its last conversion.
+        //! @param svg_file SVG file.
+        //! @param png_file PNG file to write.
+        //! @return What was redrawn; errors are reported, not thrown.
+        RenderUpdate update(const std::string &svg_file, const std::string &png_file);
+        //! Drop what is kept for a file.
+        //! @param svg_file SVG file.
+        void forget(const std::string &svg_file);
+
+    private:
+        //! What is kept for one file.
+        struct Entry;
+        //! Options.
+        RenderOptions options_;
+        //! Kept state, by SVG file name.
+        std::map<std::string, std::unique_ptr<Entry>> entries_;
+    };
+
+    //! Options of watchDirectory().
+    struct WatchOptions
+    {
+        //! Rendering options.
+        RenderOptions render;
+        //! Time without new events on a file before it is converted (milliseconds).
+        int debounce_ms = 50;
+    };
+
+    //! Convert every .svg and .svgz file of a directory, then convert each file
+    //! again whenever it is written (Linux inotify), redrawing only what changed.
+    //! @param input_dir Directory of SVG files.
+    //! @param output_dir Directory receiving name.png for each name.svg or name.svgz.
+    //! @param options Rendering and debouncing options.
+    //! @param report Called after each conversion.
+    //! @param stop Token checked a few times per second; watching ends when it
+    //! is cancelled (nullptr: watch forever).
+    void watchDirectory(const std::string &input_dir, const std::string &output_dir, const WatchOptions &options,
+                        const std::function<void(const RenderUpdate &)> &report,
+                        const CancellationToken *stop = nullptr);
+}
+#endif
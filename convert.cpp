@@ -1,23 +1,404 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
+#include "Budget.hpp"
 #include "SVGElements.hpp"
+#include "SceneFile.hpp"
+#include "SceneOptimizer.hpp"
 
 namespace svg
 {
-    void convert(const std::string &svg_file, const std::string &png_file)
+    namespace
     {
+        /**
+         * @brief Draws a scene into an image, replacing all of its pixels.
+         *
+         * @param img The image to draw on.
+         * @param options The rendering options.
+         * @param stats Where to store rendering measurements (may be null).
+         * @param draw_scene Draws every element of the scene on an image.
+         */
+        template <typename DrawScene>
+        void paint(PNGImage &img, const RenderOptions &options, RenderStats *stats,
+                   const DrawScene &draw_scene)
+        {
+            checkCancelled(options.cancel);
+            img.set_antialiasing(options.antialias);
+            img.set_cancellation(options.cancel);
+            try
+            {
+                if (options.span_buffer && !options.antialias)
+                {
+                    SpanBuffer spans;
+                    spans.reset(img.width(), img.height());
+                    img.set_span_buffer(&spans);
+                    draw_scene(img);
+                    img.set_span_buffer(nullptr);
+                    spans.resolve(img);
+                    if (stats != nullptr)
+                    {
+                        stats->overdraw = spans.overdraw();
+                    }
+                }
+                else
+                {
+                    img.clear();
+                    draw_scene(img);
+                }
+            }
+            catch (...)
+            {
+                // Do not leave the image pointing at the local span buffer.
+                img.set_span_buffer(nullptr);
+                img.set_cancellation(nullptr);
+                throw;
+            }
+            img.set_cancellation(nullptr);
+        }
+
+        /**
+         * @brief Counts the allocations of the calling thread while in scope,
+         * if the options ask for it and no enclosing call already does.
+         */
+        class MemoryTracking
+        {
+        public:
+            MemoryTracking(const RenderOptions &options, RenderStats &stats)
+                : stats_(stats), started_(options.track_memory && !memoryTracking())
+            {
+                if (started_)
+                {
+                    startMemoryTracking();
+                }
+            }
+            ~MemoryTracking()
+            {
+                if (started_)
+                {
+                    stats_.memory = stopMemoryTracking();
+                }
+            }
+
+        private:
+            RenderStats &stats_;
+            bool started_;
+        };
+
+        /**
+         * @brief Allocates the image a document is drawn on.
+         *
+         * @param dimensions The image size.
+         * @return The image, with undefined pixels.
+         */
+        std::unique_ptr<PNGImage> allocateCanvas(const Point &dimensions)
+        {
+            MemoryPhaseScope phase(MemoryPhase::Canvas);
+            return std::unique_ptr<PNGImage>(new PNGImage(dimensions.x, dimensions.y, false));
+        }
+
+        /**
+         * @brief Applies a transform to every element with the given id.
+         *
+         * Elements inside a matching group are transformed with the group.
+         *
+         * @param svg_elements The elements to search.
+         * @param id The id to look for.
+         * @param transform What to apply to each match.
+         * @return The number of matching elements.
+         */
+        template <typename Transform>
+        size_t transformById(std::vector<std::unique_ptr<SVGElement>> &svg_elements,
+                             const std::string &id, const Transform &transform)
+        {
+            size_t matches = 0;
+            for (const std::unique_ptr<SVGElement> &e : svg_elements)
+            {
+                if (e->id == id)
+                {
+                    transform(*e);
+                    matches++;
+                    continue;
+                }
+                Group *g = dynamic_cast<Group *>(e.get());
+                if (g != nullptr)
+                {
+                    matches += transformById(g->elements(), id, transform);
+                }
+            }
+            return matches;
+        }
+
+        /**
+         * @brief Builds the output file name of a frame.
+         *
+         * @param pattern The file name pattern, with one "%d" (optionally
+         * with a zero-padded width, as in "%03d").
+         * @param frame The frame number.
+         * @return The file name.
+         */
+        std::string frameFileName(const std::string &pattern, int frame)
+        {
+            size_t at = pattern.find('%');
+            size_t end = at;
+            if (at != std::string::npos)
+            {
+                end++;
+                while (end < pattern.size() && isdigit((unsigned char)pattern[end]))
+                {
+                    end++;
+                }
+            }
+            if (at == std::string::npos || end >= pattern.size() || pattern[end] != 'd' ||
+                pattern.find('%', end) != std::string::npos)
+            {
+                throw std::invalid_argument("Frame file name needs one %d: " + pattern);
+            }
+            size_t width = at + 1 < end ? (size_t)std::stoi(pattern.substr(at + 1, end - at - 1)) : 0;
+            std::string number = std::to_string(frame);
+            if (number.size() < width)
+            {
+                number.insert(0, width - number.size(), '0');
+            }
+            return pattern.substr(0, at) + number + pattern.substr(end + 1);
+        }
+    }
+
+    /**
+     * @brief Draws parsed elements into an image, replacing all of its pixels.
+     *
+     * @param svg_elements The elements, in painting order.
+     * @param img The image to draw on.
+     * @param options The rendering options.
+     * @param stats Where to store rendering measurements (may be null).
+     */
+    void renderScene(std::vector<std::unique_ptr<SVGElement>> &svg_elements, PNGImage &img,
+                     const RenderOptions &options, RenderStats *stats)
+    {
+        if (stats != nullptr)
+        {
+            stats->parsed = sceneStats(svg_elements);
+        }
+        MemoryPhaseScope optimize_phase(MemoryPhase::Optimize);
+        if (options.optimize)
+        {
+            optimizeScene(svg_elements, options.antialias);
+        }
+        if (stats != nullptr)
+        {
+            stats->optimized = sceneStats(svg_elements);
+        }
+        if (options.simplify)
+        {
+            for (const std::unique_ptr<SVGElement> &e : svg_elements)
+            {
+                e->simplify(options.simplify_tolerance);
+            }
+        }
+        MemoryPhaseScope draw_phase(MemoryPhase::Draw);
+        paint(img, options, stats, [&svg_elements](PNGImage &target)
+              {
+                  for (const std::unique_ptr<SVGElement> &e : svg_elements)
+                  {
+                      e->draw(target);
+                  }
+              });
+    }
+
+    void renderScene(const SceneFile &scene, PNGImage &img,
+                     const RenderOptions &options, RenderStats *stats)
+    {
+        MemoryPhaseScope draw_phase(MemoryPhase::Draw);
+        paint(img, options, stats, [&scene](PNGImage &target) { scene.draw(target); });
+    }
+
+    void convert(const std::string &svg_file, const std::string &png_file,
+                 const RenderOptions &options, RenderStats *stats)
+    {
+        RenderStats measured;
+        {
+            MemoryTracking tracking(options, measured);
+            if (SceneFile::probe(svg_file))
+            {
+                SceneFile scene(svg_file);
+                enforceBudget(scene, scene.dimensions(), options, measured);
+                std::unique_ptr<PNGImage> img = allocateCanvas(scene.dimensions());
+                renderScene(scene, *img, options, &measured);
+                MemoryPhaseScope phase(MemoryPhase::Encode);
+                img->save(png_file);
+            }
+            else
+            {
+                Point dimensions;
+                std::vector<std::unique_ptr<SVGElement>> svg_elements;
+                readSVG(svg_file, dimensions, svg_elements, options.cancel);
+                {
+                    MemoryPhaseScope phase(MemoryPhase::Optimize);
+                    enforceBudget(svg_elements, dimensions, options, measured);
+                }
+                std::unique_ptr<PNGImage> img = allocateCanvas(dimensions);
+                renderScene(svg_elements, *img, options, &measured);
+                MemoryPhaseScope phase(MemoryPhase::Encode);
+                img->save(png_file);
+            }
+        }
+        if (stats != nullptr)
+        {
+            *stats = measured;
+        }
+        throwIfTruncated(measured, options);
+    }
+
+    void render(const std::string &svg_file, PNGImage &img,
+                const RenderOptions &options, RenderStats *stats)
+    {
+        RenderStats measured;
+        {
+            MemoryTracking tracking(options, measured);
+            if (SceneFile::probe(svg_file))
+            {
+                SceneFile scene(svg_file);
+                enforceBudget(scene, {img.width(), img.height()}, options, measured);
+                renderScene(scene, img, options, &measured);
+            }
+            else
+            {
+                Point dimensions;
+                std::vector<std::unique_ptr<SVGElement>> svg_elements;
+                readSVG(svg_file, dimensions, svg_elements, options.cancel);
+                // The image size is fixed: a downscaled scene is drawn in its top-left part.
+                dimensions = {img.width(), img.height()};
+                {
+                    MemoryPhaseScope phase(MemoryPhase::Optimize);
+                    enforceBudget(svg_elements, dimensions, options, measured);
+                }
+                renderScene(svg_elements, img, options, &measured);
+            }
+        }
+        if (stats != nullptr)
+        {
+            *stats = measured;
+        }
+        throwIfTruncated(measured, options);
+    }
+
+    void renderFrames(const std::string &svg_file, const std::string &png_pattern, int frames,
+                      const std::vector<FrameTransform> &transforms, const RenderOptions &options)
+    {
+        frameFileName(png_pattern, 0); // Reject bad patterns before rendering.
         Point dimensions;
-        std::vector<SVGElement *> svg_elements;
-        readSVG(svg_file, dimensions, svg_elements);
-        PNGImage img(dimensions.x, dimensions.y);
-        for (SVGElement* e : svg_elements)
+        std::vector<std::unique_ptr<SVGElement>> scene;
+        readSVG(svg_file, dimensions, scene, options.cancel);
+        for (const FrameTransform &t : transforms)
+        {
+            if (!t.id.empty() && transformById(scene, t.id, [](SVGElement &) {}) == 0)
+            {
+                throw std::runtime_error("Unknown id in frame transform: " + t.id);
+            }
+        }
+
+        // The budget and the optimizer see the scene once, as drawn in the first frame.
+        RenderStats measured;
+        enforceBudget(scene, dimensions, options, measured);
+        if (options.optimize)
+        {
+            // Rectangles merged before a rotation or scaling would not draw
+            // like the separate ones, so they are only merged for translations.
+            bool translations = std::all_of(transforms.begin(), transforms.end(), [](const FrameTransform &t)
+                                            { return t.rotate == 0 && t.scale == 0; });
+            optimizeScene(scene, options.antialias || !translations);
+        }
+        RenderOptions frame_options = options;
+        frame_options.optimize = false;
+
+        unsigned threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+        threads = std::max(1u, std::min(threads, (unsigned)std::max(frames, 1)));
+        std::atomic<int> next_frame(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&]()
+        {
+            try
+            {
+                // One image and one copy of the scene per thread, reset for each of its frames.
+                PNGImage img(dimensions.x, dimensions.y, false);
+                std::vector<std::unique_ptr<SVGElement>> frame;
+                frame.reserve(scene.size());
+                for (const std::unique_ptr<SVGElement> &e : scene)
+                {
+                    frame.push_back(e->copy());
+                }
+                for (int k = next_frame++; k < frames; k = next_frame++)
+                {
+                    for (size_t i = 0; i < scene.size(); i++)
+                    {
+                        frame[i]->assign(*scene[i]);
+                    }
+                    for (const FrameTransform &t : transforms)
+                    {
+                        // A downscaled scene moves by the downscaled steps.
+                        Point translate = Point{k * t.translate.x, k * t.translate.y}.shrink(measured.downscale);
+                        Point origin = t.origin.shrink(measured.downscale);
+                        auto apply = [&t, k, translate, origin](SVGElement &e)
+                        {
+                            if (translate.x != 0 || translate.y != 0)
+                            {
+                                e.translate(translate);
+                            }
+                            if (t.rotate != 0)
+                            {
+                                e.rotate(origin, k * t.rotate);
+                            }
+                            if (t.scale != 0)
+                            {
+                                e.scale(origin, 1 + k * t.scale);
+                            }
+                        };
+                        if (t.id.empty())
+                        {
+                            for (const std::unique_ptr<SVGElement> &e : frame)
+                            {
+                                apply(*e);
+                            }
+                        }
+                        else
+                        {
+                            transformById(frame, t.id, apply);
+                        }
+                    }
+                    renderScene(frame, img, frame_options, nullptr);
+                    img.save(frameFileName(png_pattern, k));
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+                next_frame = frames;
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; i++)
+        {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &t : pool)
         {
-            e->draw(img);
+            t.join();
         }
-        img.save(png_file);
-        for (SVGElement* e  : svg_elements)
+        if (error)
         {
-            delete e;
+            std::rethrow_exception(error);
         }
+        throwIfTruncated(measured, options);
     }
-}
\ No newline at end of file
+}
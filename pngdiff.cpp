@@ -0,0 +1,70 @@
+#include "ImageDiff.hpp"
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    int tolerance = 0;
+    std::string heatmap_file;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+        std::string opt = argv[arg];
+        if (opt.compare(0, 12, "--tolerance=") == 0)
+        {
+            tolerance = std::atoi(opt.c_str() + 12);
+        }
+        else if (opt.compare(0, 10, "--heatmap=") == 0)
+        {
+            heatmap_file = opt.substr(10);
+        }
+        else
+        {
+            std::cout << "Unknown option: " << opt << std::endl;
+            return 2;
+        }
+    }
+    if (argc - arg != 2)
+    {
+        std::cout << "Usage: pngdiff [--tolerance=N] [--heatmap=out.png] expected.png actual.png" << std::endl;
+        return 2;
+    }
+    try
+    {
+        svg::PNGImage expected(argv[arg]), actual(argv[arg + 1]);
+        std::unique_ptr<svg::PNGImage> heatmap;
+        if (!heatmap_file.empty() && expected.width() == actual.width() && expected.height() == actual.height())
+        {
+            heatmap.reset(new svg::PNGImage(expected.width(), expected.height(), false));
+        }
+        svg::DiffResult diff = svg::diffImages(expected, actual, tolerance, heatmap.get());
+        if (!diff.same_size)
+        {
+            std::cout << "Images have different dimensions: " << expected.width() << "x" << expected.height()
+                      << " != " << actual.width() << "x" << actual.height() << std::endl;
+            return 1;
+        }
+        if (heatmap)
+        {
+            heatmap->save(heatmap_file);
+        }
+        if (diff.pixels == 0)
+        {
+            std::cout << "Images are identical" << (tolerance > 0 ? " within tolerance" : "") << std::endl;
+            return 0;
+        }
+        double total = (double)expected.width() * expected.height();
+        std::cout << diff.pixels << " pixels differ (" << 100.0 * diff.pixels / total << "%) in ("
+                  << diff.box.min.x << ' ' << diff.box.min.y << ")-(" << diff.box.max.x << ' ' << diff.box.max.y
+                  << "), largest channel difference " << diff.max_difference << std::endl;
+        return 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -3,16 +3,24 @@
 #include "SVGElements.hpp"
 #include "Color.hpp"
 #include "external/tinyxml2/tinyxml2.h"
+#include "external/stb/stb_image.h"
 #include <sstream>
 #include <map>
+#include <memory>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <algorithm>
 
 using namespace std;
 using namespace tinyxml2;
 
 namespace svg
 {
-    map<string, SVGElement *> mapa_use;
-
     /**
      * @brief Transforms all the commas in a string to spaces.
      *
@@ -84,155 +92,792 @@ namespace svg
      * @param element The SVG element to apply the transformation.
      * @param transformAttribute The type of transformation.
      * @param transformOrigin The origin point of the transformation.
-     * @return A Point object representing the translation, with x and y coordinates.
      */
-    void parseTransform(SVGElement *element, const char *transformAttribute, const char *transformOrigin)
+    void parseTransform(SVGElement &element, const char *transformAttribute, const char *transformOrigin)
     {
         if (transformAttribute && strstr(transformAttribute, "translate") != nullptr)
         {
             string transform_str(transformAttribute);
             Point translate = parseTranslate(transform_str);
-            element->translate(translate);
+            if (translate.x != 0 || translate.y != 0)
+            {
+                element.translate(translate);
+            }
         }
         else if (transformAttribute && strstr(transformAttribute, "scale") != nullptr)
         {
             string transform_str(transformAttribute);
             int scale = parseScaleOrRotate(transform_str);
+            if (scale == 1)
+            {
+                return; // Identity, nothing to apply to the points.
+            }
             if (transformOrigin)
             {
                 Point transformOriginPoint = parsePoint(transformOrigin);
-                element->scale(transformOriginPoint, scale);
+                element.scale(transformOriginPoint, scale);
             }
             else
             {
-                element->scale({0, 0}, scale);
+                element.scale({0, 0}, scale);
             }
         }
         else if (transformAttribute && strstr(transformAttribute, "rotate") != nullptr)
         {
             string transform_str(transformAttribute);
             int rotate = parseScaleOrRotate(transform_str);
+            if (rotate == 0)
+            {
+                return; // Identity, nothing to apply to the points.
+            }
             if (transformOrigin)
             {
                 Point transformOriginPoint = parsePoint(transformOrigin);
-                element->rotate(transformOriginPoint, rotate);
+                element.rotate(transformOriginPoint, rotate);
             }
             else
             {
-                element->rotate({0, 0}, rotate);
+                element.rotate({0, 0}, rotate);
             }
         }
     }
 
     /**
-     * @brief Recursively parses an XML element and creates corresponding SVG elements.
-     * @param pParent The parent XML element to parse.
-     * @return A pointer to the created SVG element.
+     * @brief Gets the scaling factor of a transform attribute.
+     *
+     * @param transformAttribute The transform attribute (may be null).
+     * @return The scaling factor, or 1 if the transform does not scale.
      */
-    SVGElement *recursive(XMLElement *pParent)
+    int transformScale(const char *transformAttribute)
     {
-        vector<SVGElement *> figsofgrupos;
-        for (XMLElement *child = pParent->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
+        if (transformAttribute && strstr(transformAttribute, "scale") != nullptr)
         {
-            SVGElement *p;
-            // Check which element to add to figsofgrupos.
-            if (strcmp(child->Name(), "ellipse") == 0)
+            int v = abs(parseScaleOrRotate(transformAttribute));
+            return v > 0 ? v : 1;
+        }
+        return 1;
+    }
+
+    /**
+     * @brief Appends a path point to a contour.
+     *
+     * Points are kept unrounded so transforms applied later stay exact;
+     * repeated points are merged.
+     *
+     * @param contour The contour to extend.
+     * @param p The point to append.
+     */
+    void emitPathPoint(vector<PathPoint> &contour, const PathPoint &p)
+    {
+        if (contour.empty() || contour.back().x != p.x || contour.back().y != p.y)
+        {
+            contour.push_back(p);
+        }
+    }
+
+    /**
+     * @brief Computes the distance from a point to the line through two other points.
+     */
+    double chordDistance(const PathPoint &p, const PathPoint &a, const PathPoint &b)
+    {
+        double dx = b.x - a.x, dy = b.y - a.y;
+        double len = sqrt(dx * dx + dy * dy);
+        if (len == 0)
+        {
+            return sqrt((p.x - a.x) * (p.x - a.x) + (p.y - a.y) * (p.y - a.y));
+        }
+        return fabs((p.x - a.x) * dy - (p.y - a.y) * dx) / len;
+    }
+
+    /**
+     * @brief Flattens a cubic Bézier curve by adaptive subdivision.
+     *
+     * The curve is split in half until both control points lie within the
+     * tolerance of the chord, so flat parts produce few segments and tight
+     * bends produce many. The start point is assumed to be already emitted.
+     *
+     * @param contour The contour receiving the points.
+     * @param p Control points of the curve.
+     * @param tolerance Maximum distance between the curve and its segments.
+     * @param depth Remaining subdivision depth.
+     */
+    void flattenCubic(vector<PathPoint> &contour, const PathPoint p[4], double tolerance, int depth)
+    {
+        if (depth == 0 ||
+            (chordDistance(p[1], p[0], p[3]) <= tolerance &&
+             chordDistance(p[2], p[0], p[3]) <= tolerance))
+        {
+            emitPathPoint(contour, p[3]);
+            return;
+        }
+        PathPoint p01 = {(p[0].x + p[1].x) / 2, (p[0].y + p[1].y) / 2};
+        PathPoint p12 = {(p[1].x + p[2].x) / 2, (p[1].y + p[2].y) / 2};
+        PathPoint p23 = {(p[2].x + p[3].x) / 2, (p[2].y + p[3].y) / 2};
+        PathPoint p012 = {(p01.x + p12.x) / 2, (p01.y + p12.y) / 2};
+        PathPoint p123 = {(p12.x + p23.x) / 2, (p12.y + p23.y) / 2};
+        PathPoint mid = {(p012.x + p123.x) / 2, (p012.y + p123.y) / 2};
+        PathPoint left[4] = {p[0], p01, p012, mid};
+        PathPoint right[4] = {mid, p123, p23, p[3]};
+        flattenCubic(contour, left, tolerance, depth - 1);
+        flattenCubic(contour, right, tolerance, depth - 1);
+    }
+
+    /**
+     * @brief Flattens an elliptical arc given in SVG endpoint parameterization.
+     *
+     * @param contour The contour receiving the points.
+     * @param from The start point of the arc.
+     * @param rx The X radius.
+     * @param ry The Y radius.
+     * @param degrees The rotation of the ellipse X axis.
+     * @param large_arc The large-arc flag.
+     * @param sweep The sweep flag.
+     * @param to The end point of the arc.
+     * @param tolerance Maximum distance between the arc and its segments.
+     */
+    void flattenArc(vector<PathPoint> &contour, const PathPoint &from, double rx, double ry, double degrees,
+                    bool large_arc, bool sweep, const PathPoint &to, double tolerance)
+    {
+        rx = fabs(rx);
+        ry = fabs(ry);
+        if (rx == 0 || ry == 0 || (from.x == to.x && from.y == to.y))
+        {
+            emitPathPoint(contour, to);
+            return;
+        }
+        // Conversion to center parameterization (SVG 1.1, appendix F.6.5).
+        double phi = M_PI * degrees / 180.0;
+        double c = cos(phi), s = sin(phi);
+        double dx2 = (from.x - to.x) / 2, dy2 = (from.y - to.y) / 2;
+        double x1p = c * dx2 + s * dy2;
+        double y1p = -s * dx2 + c * dy2;
+        double lambda = (x1p * x1p) / (rx * rx) + (y1p * y1p) / (ry * ry);
+        if (lambda > 1)
+        {
+            rx *= sqrt(lambda);
+            ry *= sqrt(lambda);
+        }
+        double num = rx * rx * ry * ry - rx * rx * y1p * y1p - ry * ry * x1p * x1p;
+        double den = rx * rx * y1p * y1p + ry * ry * x1p * x1p;
+        double coef = sqrt(max(0.0, num / den)) * (large_arc == sweep ? -1 : 1);
+        double cxp = coef * rx * y1p / ry;
+        double cyp = -coef * ry * x1p / rx;
+        double cx = c * cxp - s * cyp + (from.x + to.x) / 2;
+        double cy = s * cxp + c * cyp + (from.y + to.y) / 2;
+        double ux = (x1p - cxp) / rx, uy = (y1p - cyp) / ry;
+        double vx = (-x1p - cxp) / rx, vy = (-y1p - cyp) / ry;
+        double theta = atan2(uy, ux);
+        double delta = atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+        if (!sweep && delta > 0)
+        {
+            delta -= 2 * M_PI;
+        }
+        else if (sweep && delta < 0)
+        {
+            delta += 2 * M_PI;
+        }
+        // Largest angular step whose chord stays within the tolerance.
+        double r = max(rx, ry);
+        double step = tolerance < r ? 2 * acos(1 - tolerance / r) : M_PI / 2;
+        int n = max(1, (int)ceil(fabs(delta) / step));
+        for (int i = 1; i < n; i++)
+        {
+            double t = theta + delta * i / n;
+            double ex = rx * cos(t), ey = ry * sin(t);
+            emitPathPoint(contour, {cx + c * ex - s * ey, cy + s * ex + c * ey});
+        }
+        emitPathPoint(contour, to);
+    }
+
+    /**
+     * @brief Skips whitespace and commas in path data.
+     *
+     * @param d The current position in the path data.
+     */
+    void skipPathSeparators(const char *&d)
+    {
+        while (*d == ',' || isspace((unsigned char)*d))
+        {
+            d++;
+        }
+    }
+
+    /**
+     * @brief Reads a number from path data.
+     *
+     * @param d The current position in the path data.
+     * @return The number read.
+     */
+    double readPathNumber(const char *&d)
+    {
+        skipPathSeparators(d);
+        char *end;
+        double v = strtod(d, &end);
+        if (end == d)
+        {
+            throw runtime_error(string("Invalid path data near: ") + d);
+        }
+        d = end;
+        return v;
+    }
+
+    /**
+     * @brief Reads an arc flag (a single '0' or '1') from path data.
+     *
+     * @param d The current position in the path data.
+     * @return The flag read.
+     */
+    bool readPathFlag(const char *&d)
+    {
+        skipPathSeparators(d);
+        if (*d != '0' && *d != '1')
+        {
+            throw runtime_error(string("Invalid path flag near: ") + d);
+        }
+        return *d++ == '1';
+    }
+
+    /**
+     * @brief Parses path data and flattens it into contours.
+     *
+     * Supports the M, L, H, V, C, S, Q, T, A and Z commands, both absolute
+     * (uppercase) and relative (lowercase), including implicit repetition.
+     *
+     * @param d The path data (the "d" attribute).
+     * @param tolerance Maximum distance between curves and their segments, in user units.
+     * @param closed Receives whether each contour was closed.
+     * @return The flattened contours, unrounded.
+     */
+    vector<vector<PathPoint>> parsePath(const char *d, double tolerance, vector<bool> &closed)
+    {
+        vector<vector<PathPoint>> contours;
+        vector<PathPoint> contour;
+        PathPoint current = {0, 0}, start = {0, 0}, control = {0, 0};
+        char cmd = 0, prev = 0;
+        skipPathSeparators(d);
+        while (*d)
+        {
+            if (isalpha((unsigned char)*d))
+            {
+                cmd = *d++;
+            }
+            else if (cmd == 0 || toupper(cmd) == 'Z')
             {
-                p = new Ellipse(parse_color(child->Attribute("fill")), {child->IntAttribute("cx"), child->IntAttribute("cy")}, {child->IntAttribute("rx"), child->IntAttribute("ry")});
+                throw runtime_error(string("Invalid path data near: ") + d);
             }
-            else if (strcmp(child->Name(), "circle") == 0)
+            bool rel = islower((unsigned char)cmd);
+            double ox = rel ? current.x : 0, oy = rel ? current.y : 0;
+            char op = (char)toupper(cmd);
+            if (op != 'M' && op != 'Z' && contour.empty())
             {
-                p = new Circle(parse_color(child->Attribute("fill")), {child->IntAttribute("cx"), child->IntAttribute("cy")}, child->IntAttribute("r"));
+                // Drawing after Z continues from the start of the last subpath.
+                emitPathPoint(contour, current);
             }
-            else if (strcmp(child->Name(), "polyline") == 0)
+            switch (op)
             {
-                string pontos = child->Attribute("points");
-                transformcomma(pontos);
-                istringstream iss(pontos);
-                vector<Point> polypontos;
-                Point temp;
-                // Get coordinates (x, y) from input.
-                while (iss >> temp.x)
+            case 'M':
+            {
+                if (!contour.empty())
                 {
-                    iss >> temp.y;
-                    polypontos.push_back(temp);
+                    contours.push_back(std::move(contour));
+                    closed.push_back(false);
+                    contour.clear();
                 }
-                p = new Polyline(polypontos, parse_color(child->Attribute("stroke")));
+                current.x = ox + readPathNumber(d);
+                current.y = oy + readPathNumber(d);
+                start = current;
+                emitPathPoint(contour, current);
+                // Further coordinate pairs are implicit line commands.
+                cmd = rel ? 'l' : 'L';
+                break;
             }
-            else if (strcmp(child->Name(), "line") == 0)
+            case 'L':
+                current.x = ox + readPathNumber(d);
+                current.y = oy + readPathNumber(d);
+                emitPathPoint(contour, current);
+                break;
+            case 'H':
+                current.x = ox + readPathNumber(d);
+                emitPathPoint(contour, current);
+                break;
+            case 'V':
+                current.y = oy + readPathNumber(d);
+                emitPathPoint(contour, current);
+                break;
+            case 'C':
+            case 'S':
+            case 'Q':
+            case 'T':
             {
-                p = new Line({child->IntAttribute("x1"), child->IntAttribute("y1")}, {child->IntAttribute("x2"), child->IntAttribute("y2")}, parse_color(child->Attribute("stroke")));
+                PathPoint p[4];
+                p[0] = current;
+                if (op == 'C' || op == 'Q')
+                {
+                    p[1].x = ox + readPathNumber(d);
+                    p[1].y = oy + readPathNumber(d);
+                }
+                else
+                {
+                    // Reflection of the previous control point, if any.
+                    bool smooth = op == 'S' ? (prev == 'C' || prev == 'S') : (prev == 'Q' || prev == 'T');
+                    p[1] = smooth ? PathPoint{2 * current.x - control.x, 2 * current.y - control.y} : current;
+                }
+                if (op == 'C' || op == 'S')
+                {
+                    p[2].x = ox + readPathNumber(d);
+                    p[2].y = oy + readPathNumber(d);
+                    control = p[2];
+                }
+                p[3].x = ox + readPathNumber(d);
+                p[3].y = oy + readPathNumber(d);
+                if (op == 'Q' || op == 'T')
+                {
+                    // Degree elevation of the quadratic curve.
+                    control = p[1];
+                    p[2] = {p[3].x + 2 * (p[1].x - p[3].x) / 3, p[3].y + 2 * (p[1].y - p[3].y) / 3};
+                    p[1] = {p[0].x + 2 * (p[1].x - p[0].x) / 3, p[0].y + 2 * (p[1].y - p[0].y) / 3};
+                }
+                flattenCubic(contour, p, tolerance, 16);
+                current = p[3];
+                break;
             }
-            else if (strcmp(child->Name(), "polygon") == 0)
+            case 'A':
             {
-                string pontos = child->Attribute("points");
-                transformcomma(pontos);
-                istringstream iss(pontos);
-                vector<Point> polypontos;
-                Point temp;
-                // Get coordinates (x, y) from input.
-                while (iss >> temp.x)
+                double rx = readPathNumber(d);
+                double ry = readPathNumber(d);
+                double angle = readPathNumber(d);
+                bool large_arc = readPathFlag(d);
+                bool sweep = readPathFlag(d);
+                PathPoint to;
+                to.x = ox + readPathNumber(d);
+                to.y = oy + readPathNumber(d);
+                flattenArc(contour, current, rx, ry, angle, large_arc, sweep, to, tolerance);
+                current = to;
+                break;
+            }
+            case 'Z':
+                if (!contour.empty())
                 {
-                    iss >> temp.y;
-                    polypontos.push_back(temp);
+                    contours.push_back(std::move(contour));
+                    closed.push_back(true);
+                    contour.clear();
                 }
-                p = new Polygon(polypontos, parse_color(child->Attribute("fill")));
+                current = start;
+                break;
+            default:
+                throw runtime_error(string("Unsupported path command: ") + cmd);
+            }
+            prev = op;
+            skipPathSeparators(d);
+        }
+        if (!contour.empty())
+        {
+            contours.push_back(std::move(contour));
+            closed.push_back(false);
+        }
+        return contours;
+    }
+
+    /**
+     * @brief Computes the FNV-1a hash of a tag or attribute name.
+     *
+     * @param name The name to hash.
+     * @return The hash value (usable as a case label).
+     */
+    constexpr uint32_t nameHash(const char *name)
+    {
+        uint32_t h = 2166136261u;
+        for (; *name != '\0'; name++)
+        {
+            h ^= (unsigned char)*name;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    /**
+     * @brief The element tags understood by the reader.
+     */
+    enum class Tag
+    {
+        Unknown,
+        Ellipse,
+        Circle,
+        Polyline,
+        Line,
+        Polygon,
+        Rect,
+        Path,
+        Group,
+        Use
+    };
+
+    /**
+     * @brief Identifies the tag of an element with a single hash and one confirming comparison.
+     *
+     * @param name The element name.
+     * @return The corresponding tag, or Tag::Unknown.
+     */
+    Tag tagOf(const char *name)
+    {
+        Tag tag;
+        const char *expected;
+        switch (nameHash(name))
+        {
+        case nameHash("ellipse"): tag = Tag::Ellipse; expected = "ellipse"; break;
+        case nameHash("circle"): tag = Tag::Circle; expected = "circle"; break;
+        case nameHash("polyline"): tag = Tag::Polyline; expected = "polyline"; break;
+        case nameHash("line"): tag = Tag::Line; expected = "line"; break;
+        case nameHash("polygon"): tag = Tag::Polygon; expected = "polygon"; break;
+        case nameHash("rect"): tag = Tag::Rect; expected = "rect"; break;
+        case nameHash("path"): tag = Tag::Path; expected = "path"; break;
+        case nameHash("g"): tag = Tag::Group; expected = "g"; break;
+        case nameHash("use"): tag = Tag::Use; expected = "use"; break;
+        default: return Tag::Unknown;
+        }
+        return strcmp(name, expected) == 0 ? tag : Tag::Unknown;
+    }
+
+    /**
+     * @brief The attributes of an element that the reader uses, decoded in one pass.
+     */
+    struct ElementAttributes
+    {
+        int cx = 0, cy = 0, r = 0, rx = 0, ry = 0;
+        int x = 0, y = 0, width = 0, height = 0;
+        int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+        const char *fill = nullptr;
+        const char *stroke = nullptr;
+        const char *fill_rule = nullptr;
+        const char *points = nullptr;
+        const char *d = nullptr;
+        const char *id = nullptr;
+        const char *href = nullptr;
+        const char *transform = nullptr;
+        const char *transform_origin = nullptr;
+    };
+
+    /**
+     * @brief Walks the attribute list of an element once and fills an attribute record.
+     *
+     * @param elem The XML element.
+     * @param attrs The record to fill.
+     */
+    void readAttributes(const XMLElement *elem, ElementAttributes &attrs)
+    {
+        for (const XMLAttribute *a = elem->FirstAttribute(); a != nullptr; a = a->Next())
+        {
+            const char *name = a->Name();
+            int *number = nullptr;
+            const char **text = nullptr;
+            const char *expected;
+            switch (nameHash(name))
+            {
+            case nameHash("cx"): number = &attrs.cx; expected = "cx"; break;
+            case nameHash("cy"): number = &attrs.cy; expected = "cy"; break;
+            case nameHash("r"): number = &attrs.r; expected = "r"; break;
+            case nameHash("rx"): number = &attrs.rx; expected = "rx"; break;
+            case nameHash("ry"): number = &attrs.ry; expected = "ry"; break;
+            case nameHash("x"): number = &attrs.x; expected = "x"; break;
+            case nameHash("y"): number = &attrs.y; expected = "y"; break;
+            case nameHash("width"): number = &attrs.width; expected = "width"; break;
+            case nameHash("height"): number = &attrs.height; expected = "height"; break;
+            case nameHash("x1"): number = &attrs.x1; expected = "x1"; break;
+            case nameHash("y1"): number = &attrs.y1; expected = "y1"; break;
+            case nameHash("x2"): number = &attrs.x2; expected = "x2"; break;
+            case nameHash("y2"): number = &attrs.y2; expected = "y2"; break;
+            case nameHash("fill"): text = &attrs.fill; expected = "fill"; break;
+            case nameHash("stroke"): text = &attrs.stroke; expected = "stroke"; break;
+            case nameHash("fill-rule"): text = &attrs.fill_rule; expected = "fill-rule"; break;
+            case nameHash("points"): text = &attrs.points; expected = "points"; break;
+            case nameHash("d"): text = &attrs.d; expected = "d"; break;
+            case nameHash("id"): text = &attrs.id; expected = "id"; break;
+            case nameHash("href"): text = &attrs.href; expected = "href"; break;
+            case nameHash("xlink:href"): text = &attrs.href; expected = "xlink:href"; break;
+            case nameHash("transform"): text = &attrs.transform; expected = "transform"; break;
+            case nameHash("transform-origin"): text = &attrs.transform_origin; expected = "transform-origin"; break;
+            default: continue;
             }
-            else if (strcmp(child->Name(), "rect") == 0)
+            if (strcmp(name, expected) != 0)
             {
-                int x = child->IntAttribute("x");
-                int y = child->IntAttribute("y");
-                int width = child->IntAttribute("width");
-                int height = child->IntAttribute("height");
-                Point corner1, corner2, corner3, corner4;
-                corner1.x = x;
-                corner1.y = y;
-
-                corner2.x = x + width - 1;
-                corner2.y = y;
-
-                corner3.x = x + width - 1;
-                corner3.y = y + height - 1;
-
-                corner4.x = x;
-                corner4.y = y + height - 1;
-
-                vector<Point> points; // Add every corner of the rectangle to a vector of points.
-                points.push_back(corner1);
-                points.push_back(corner2);
-                points.push_back(corner3);
-                points.push_back(corner4);
-                p = new Rect(points, parse_color(child->Attribute("fill")));
+                continue;
             }
-            else if (strcmp(child->Name(), "g") == 0)
+            if (number)
             {
-                p = recursive(child); // Recursive case call for groups.
+                *number = a->IntValue();
             }
-            else if (strcmp(child->Name(), "use") == 0)
+            else
             {
-                string ref = child->Attribute("href");
-                string ident = ref.substr(1, string::npos);
+                *text = a->Value();
+            }
+        }
+    }
+
+    /**
+     * @brief Parses a color attribute, defaulting to black when absent.
+     *
+     * @param value The attribute value (may be null).
+     * @return The color.
+     */
+    Color colorAttribute(const char *value)
+    {
+        return value ? parse_color(value) : Color{0, 0, 0};
+    }
+
+    /**
+     * @brief Parses a fill-rule attribute.
+     *
+     * @param value The attribute value (may be null).
+     * @param absent The rule when there is no attribute.
+     * @return The fill rule.
+     */
+    FillRule fillRuleAttribute(const char *value, FillRule absent)
+    {
+        if (value == nullptr)
+        {
+            return absent;
+        }
+        if (strcmp(value, "nonzero") == 0)
+        {
+            return FillRule::NonZero;
+        }
+        if (strcmp(value, "evenodd") == 0)
+        {
+            return FillRule::EvenOdd;
+        }
+        throw runtime_error(string("Unsupported fill-rule: ") + value);
+    }
+
+    /**
+     * @brief Parses a "points" attribute into a vector of points.
+     *
+     * @param str The attribute value (may be null).
+     * @return The points.
+     */
+    PointVector parsePoints(const char *str)
+    {
+        vector<Point> polypontos;
+        if (!str)
+        {
+            return PointVector();
+        }
+        string pontos = str;
+        transformcomma(pontos);
+        istringstream iss(pontos);
+        Point temp;
+        // Get coordinates (x, y) from input.
+        while (iss >> temp.x)
+        {
+            iss >> temp.y;
+            polypontos.push_back(temp);
+        }
+        return PointVector(std::move(polypontos));
+    }
+
+    /**
+     * @brief Creates the SVG element of a shape tag.
+     *
+     * @param tag The tag (groups and <use> are not shapes).
+     * @param attrs The attributes of the element.
+     * @param scale The scaling applied to the element by its ancestors' transforms.
+     * @return The element, without its transform, or null if the tag is not a shape.
+     */
+    unique_ptr<SVGElement> createShape(Tag tag, const ElementAttributes &attrs, int scale)
+    {
+        unique_ptr<SVGElement> p;
+        switch (tag)
+        {
+        case Tag::Ellipse:
+            p.reset(new Ellipse(colorAttribute(attrs.fill), {attrs.cx, attrs.cy}, {attrs.rx, attrs.ry}));
+            break;
+        case Tag::Circle:
+            p.reset(new Circle(colorAttribute(attrs.fill), {attrs.cx, attrs.cy}, attrs.r));
+            break;
+        case Tag::Polyline:
+            p.reset(new Polyline(parsePoints(attrs.points), colorAttribute(attrs.stroke)));
+            break;
+        case Tag::Line:
+            p.reset(new Line({attrs.x1, attrs.y1}, {attrs.x2, attrs.y2}, colorAttribute(attrs.stroke)));
+            break;
+        case Tag::Polygon:
+            // Polygons without fill-rule keep the even-odd fill they always had.
+            p.reset(new Polygon(parsePoints(attrs.points), colorAttribute(attrs.fill), "",
+                                fillRuleAttribute(attrs.fill_rule, FillRule::EvenOdd)));
+            break;
+        case Tag::Rect:
+        {
+            // Add every corner of the rectangle to a vector of points.
+            PointVector points = {{attrs.x, attrs.y},
+                                  {attrs.x + attrs.width - 1, attrs.y},
+                                  {attrs.x + attrs.width - 1, attrs.y + attrs.height - 1},
+                                  {attrs.x, attrs.y + attrs.height - 1}};
+            p.reset(new Rect(std::move(points), colorAttribute(attrs.fill)));
+            break;
+        }
+        case Tag::Path:
+        {
+            // Flatten curves to a quarter of an output pixel.
+            double tolerance = 0.25 / (scale * transformScale(attrs.transform));
+            vector<bool> closed;
+            vector<vector<PathPoint>> contours = parsePath(attrs.d ? attrs.d : "", tolerance, closed);
+            bool filled = !attrs.fill || strcmp(attrs.fill, "none") != 0;
+            bool stroked = attrs.stroke && strcmp(attrs.stroke, "none") != 0;
+            p.reset(new Path(std::move(contours), std::move(closed),
+                             filled ? colorAttribute(attrs.fill) : Color{0, 0, 0}, filled,
+                             fillRuleAttribute(attrs.fill_rule, FillRule::NonZero),
+                             stroked ? colorAttribute(attrs.stroke) : Color{0, 0, 0}, stroked));
+            break;
+        }
+        case Tag::Group:
+        case Tag::Use:
+        case Tag::Unknown:
+            break;
+        }
+        return p;
+    }
+
+    /**
+     * @brief Recursively parses an XML element and creates corresponding SVG elements.
+     * @param pParent The parent XML element to parse.
+     * @param mapa_use The elements with an identifier seen so far (not owned).
+     * @param cancel Token checked before each child element (may be null).
+     * @param scale The scaling applied to the parent by its ancestors' transforms.
+     * @return The created group of SVG elements.
+     */
+    unique_ptr<SVGElement> recursive(XMLElement *pParent, map<string, SVGElement *> &mapa_use,
+                                     const CancellationToken *cancel, int scale = 1)
+    {
+        vector<unique_ptr<SVGElement>> figsofgrupos;
+        for (XMLElement *child = pParent->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
+        {
+            checkCancelled(cancel);
+            Tag tag = tagOf(child->Name());
+            if (tag == Tag::Unknown)
+            {
+                continue; // Elements we do not render (title, desc, ...).
+            }
+            ElementAttributes attrs;
+            readAttributes(child, attrs);
+            unique_ptr<SVGElement> p;
+            // Check which element to add to figsofgrupos.
+            switch (tag)
+            {
+            case Tag::Ellipse:
+            case Tag::Circle:
+            case Tag::Polyline:
+            case Tag::Line:
+            case Tag::Polygon:
+            case Tag::Rect:
+            case Tag::Path:
+                p = createShape(tag, attrs, scale);
+                break;
+            case Tag::Group:
+                p = recursive(child, mapa_use, cancel, scale * transformScale(attrs.transform)); // Recursive case call for groups.
+                break;
+            case Tag::Use:
+            {
+                string ident = attrs.href && attrs.href[0] == '#' ? attrs.href + 1 : "";
                 // Copy the object from the map using the identifier as the key
-                p = mapa_use[ident]->copy();
+                map<string, SVGElement *>::const_iterator it = mapa_use.find(ident);
+                if (it == mapa_use.end())
+                {
+                    throw runtime_error("Unknown reference in <use>: " + ident);
+                }
+                MemoryPhaseScope use_phase(MemoryPhase::UseCopies);
+                p = it->second->copy();
+                break;
+            }
+            case Tag::Unknown:
+                break;
             }
-            // Initialize an empty identifier
-            string ident = "";
-            if (child->Attribute("id"))
+            if (attrs.id)
             {
-                // Get the id attribute of the child
-                ident = child->Attribute("id");
+                p->id = attrs.id;
                 // Add the object to the map with the identifier as the key
-                mapa_use[ident] = p;
+                mapa_use[p->id] = p.get();
             }
-            if (child->Attribute("transform"))
+            if (attrs.transform)
             {
-                const char *transform_attr = child->Attribute("transform");
-                const char *transform_origin = child->Attribute("transform-origin");
-                parseTransform(p, transform_attr, transform_origin);
+                parseTransform(*p, attrs.transform, attrs.transform_origin);
             }
-            figsofgrupos.push_back(p);
+            figsofgrupos.push_back(std::move(p));
+        }
+        return unique_ptr<SVGElement>(new Group(std::move(figsofgrupos)));
+    }
+
+    /**
+     * @brief Checks if readSVG turns an XML element into an SVG element.
+     *
+     * @param name The tag of the XML element.
+     * @return False for tags that are skipped (title, desc, defs, ...).
+     */
+    bool readsAsElement(const char *name)
+    {
+        return tagOf(name) != Tag::Unknown;
+    }
+
+    /**
+     * @brief Creates the SVG element of a single shape, as readSVG does.
+     *
+     * @param elem The XML element.
+     * @param scale The scaling applied to the element by its ancestors' transforms.
+     * @return The element, with its own transform applied, or null for groups, <use> and skipped tags.
+     */
+    unique_ptr<SVGElement> readShape(const XMLElement *elem, int scale)
+    {
+        ElementAttributes attrs;
+        readAttributes(elem, attrs);
+        unique_ptr<SVGElement> p = createShape(tagOf(elem->Name()), attrs, scale);
+        if (p && attrs.transform)
+        {
+            parseTransform(*p, attrs.transform, attrs.transform_origin);
+        }
+        return p;
+    }
+
+    /**
+     * @brief Applies the transform attribute of an XML element to an SVG element.
+     *
+     * @param element The SVG element to transform.
+     * @param elem The XML element whose transform is applied.
+     */
+    void readTransform(SVGElement &element, const XMLElement *elem)
+    {
+        ElementAttributes attrs;
+        readAttributes(elem, attrs);
+        if (attrs.transform)
+        {
+            parseTransform(element, attrs.transform, attrs.transform_origin);
+        }
+    }
+
+    /**
+     * @brief Gets the scaling factor of the transform attribute of an XML element.
+     *
+     * @param elem The XML element.
+     * @return The scaling factor, or 1 if its transform does not scale.
+     */
+    int transformScale(const XMLElement *elem)
+    {
+        return transformScale(elem->Attribute("transform"));
+    }
+
+    /**
+     * @brief Checks the size of an image before it is allocated.
+     *
+     * Each side must be positive, and the pixel bytes must fit the int sizes used by the PNG codec.
+     *
+     * @param dimensions The image width and height.
+     * @param name The document name (for error messages).
+     */
+    void checkDimensions(const Point &dimensions, const string &name)
+    {
+        if (dimensions.x <= 0 || dimensions.y <= 0 ||
+            (int64_t)dimensions.x * dimensions.y > INT_MAX / (int64_t)sizeof(Color))
+        {
+            throw runtime_error(name + ": invalid image size " + to_string(dimensions.x) + "x" +
+                                to_string(dimensions.y));
         }
-        return new Group(figsofgrupos);
     }
 
     /**
@@ -241,20 +886,185 @@ namespace svg
      * @param svg_file The path to the SVG file to be read.
      * @param dimensions The reference to a Point object where the dimensions of the SVG will be stored.
      * @param svg_elements The reference to a vector of SVGElement pointers where the extracted SVG elements will be stored.
+     * @param cancel Token checked between elements; parsing throws Cancelled once it is cancelled (may be null).
      */
-    void readSVG(const string &svg_file, Point &dimensions, vector<SVGElement *> &svg_elements)
+    void readSVG(const string &svg_file, Point &dimensions, vector<unique_ptr<SVGElement>> &svg_elements,
+                 const CancellationToken *cancel)
     {
         XMLDocument doc;
-        XMLError r = doc.LoadFile(svg_file.c_str());
-        if (r != XML_SUCCESS)
+        MemoryPhaseScope xml_phase(MemoryPhase::Xml);
+        loadXML(doc, svg_file);
+        readSVG(doc.RootElement(), dimensions, svg_elements, cancel);
+    }
+
+    /**
+     * @brief Parses a gzip file (RFC 1952) that is already in memory.
+     *
+     * The header is skipped and the deflate stream is inflated with the zlib decoder of stb_image into a buffer of
+     * bounded size. The buffer starts at a few times the compressed size, and is doubled, inflating again, until the
+     * document fits or the limit is reached. The length stored in the trailer is not trusted: it can only make the
+     * first buffer smaller.
+     *
+     * @param doc The document to fill.
+     * @param data The file contents.
+     * @param size The size of the file contents.
+     * @param file The file name (for error messages).
+     * @param max_size The largest accepted inflated size (bytes).
+     */
+    void parseGzip(XMLDocument &doc, const unsigned char *data, size_t size, const string &file, size_t max_size)
+    {
+        enum
+        {
+            FHCRC = 2,
+            FEXTRA = 4,
+            FNAME = 8,
+            FCOMMENT = 16
+        };
+        // Magic (2 bytes), method, flags, time (4 bytes), extra flags and OS, then optional fields.
+        size_t pos = 10;
+        if (size < 18 || data[2] != 8)
+        {
+            throw runtime_error("Unable to load " + file + " (unsupported gzip data)");
+        }
+        unsigned char flags = data[3];
+        if (flags & FEXTRA)
+        {
+            pos += 2 + (data[pos] | data[pos + 1] << 8);
+        }
+        for (int field : {FNAME, FCOMMENT})
+        {
+            if (flags & field)
+            {
+                while (pos < size && data[pos] != 0)
+                {
+                    pos++;
+                }
+                pos++;
+            }
+        }
+        if (flags & FHCRC)
+        {
+            pos += 2;
+        }
+        // The trailer holds the CRC-32 and the inflated size (modulo 2^32) of the last member.
+        if (pos + 8 > size || size - pos > (size_t)INT_MAX)
+        {
+            throw runtime_error("Unable to load " + file + " (truncated gzip data)");
+        }
+        const unsigned char *trailer = data + size - 4;
+        uint32_t inflated = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (uint32_t)trailer[3] << 24;
+        max_size = min(max_size, (size_t)INT_MAX);
+        size_t capacity = min(max_size, 4 * (size - pos) + 64 * 1024);
+        if (inflated < capacity)
+        {
+            capacity = max((size_t)inflated, min(max_size, (size_t)4096));
+        }
+        vector<char> xml;
+        int length;
+        for (;;)
+        {
+            xml.resize(capacity);
+            // The trailer is passed along: the decoder refuses to read its last codes
+            // without 16 bits of input left (in PNG files the Adler-32 checksum follows).
+            length = stbi_zlib_decode_noheader_buffer(xml.data(), (int)capacity, (const char *)data + pos,
+                                                      (int)(size - pos));
+            if (length >= 0)
+            {
+                break;
+            }
+            if (strcmp(stbi_failure_reason(), "output buffer limit") != 0)
+            {
+                throw runtime_error("Unable to load " + file + " (corrupt gzip data)");
+            }
+            if (capacity >= max_size)
+            {
+                throw runtime_error("Unable to load " + file + " (inflates to more than " + to_string(max_size) +
+                                    " bytes)");
+            }
+            capacity = min(max_size, 2 * capacity);
+        }
+        if (doc.Parse(xml.data(), (size_t)length) != XML_SUCCESS)
         {
-            throw runtime_error("Unable to load " + svg_file);
+            throw runtime_error("Unable to load " + file);
         }
-        XMLElement *xml_elem = doc.RootElement();
+    }
 
-        dimensions.x = xml_elem->IntAttribute("width");
-        dimensions.y = xml_elem->IntAttribute("height");
-        SVGElement *A = recursive(xml_elem);
-        svg_elements.push_back(A);
+    /**
+     * @brief Parses an XML document that is already in memory, inflating it first if it is gzip-compressed.
+     *
+     * @param doc The document to fill.
+     * @param data The document.
+     * @param size The size of the document.
+     * @param name The document name (for error messages).
+     * @param max_inflated The largest accepted size of a compressed document once inflated (bytes).
+     */
+    void parseXML(XMLDocument &doc, const char *data, size_t size, const string &name, size_t max_inflated)
+    {
+        if (size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b)
+        {
+            parseGzip(doc, (const unsigned char *)data, size, name, max_inflated);
+        }
+        else if (doc.Parse(data, size) != XML_SUCCESS)
+        {
+            throw runtime_error("Unable to load " + name);
+        }
+    }
+
+    /**
+     * @brief Loads an XML file, inflating it first if it is gzip-compressed (such as .svgz files).
+     *
+     * Compressed files are recognized by their first two bytes, whatever their name.
+     *
+     * @param doc The document to fill.
+     * @param file The file name.
+     * @param max_inflated The largest accepted size of a compressed file once inflated (bytes).
+     */
+    void loadXML(XMLDocument &doc, const string &file, size_t max_inflated)
+    {
+        unique_ptr<FILE, int (*)(FILE *)> f(fopen(file.c_str(), "rb"), fclose);
+        if (!f)
+        {
+            throw runtime_error("Unable to load " + file);
+        }
+        unsigned char magic[2] = {0, 0};
+        if (fread(magic, 1, 2, f.get()) == 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        {
+            vector<unsigned char> data;
+            unsigned char buffer[64 * 1024];
+            data.assign(magic, magic + 2);
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), f.get())) > 0)
+            {
+                data.insert(data.end(), buffer, buffer + n);
+            }
+            parseGzip(doc, data.data(), data.size(), file, max_inflated);
+        }
+        else if (doc.LoadFile(f.get()) != XML_SUCCESS)
+        {
+            throw runtime_error("Unable to load " + file);
+        }
+    }
+
+    /**
+     * Extracts the dimensions and SVG elements of an already parsed document.
+     *
+     * @param root The <svg> element of the document.
+     * @param dimensions The reference to a Point object where the dimensions of the SVG will be stored.
+     * @param svg_elements The reference to a vector of SVGElement pointers where the extracted SVG elements will be stored.
+     * @param cancel Token checked between elements; parsing throws Cancelled once it is cancelled (may be null).
+     */
+    void readSVG(XMLElement *root, Point &dimensions, vector<unique_ptr<SVGElement>> &svg_elements,
+                 const CancellationToken *cancel)
+    {
+        if (root == nullptr)
+        {
+            throw runtime_error("Document has no root element");
+        }
+        dimensions.x = root->IntAttribute("width");
+        dimensions.y = root->IntAttribute("height");
+        checkDimensions(dimensions, "Document");
+        MemoryPhaseScope elements_phase(MemoryPhase::Elements);
+        map<string, SVGElement *> mapa_use;
+        svg_elements.push_back(recursive(root, mapa_use, cancel));
     }
-}
\ No newline at end of file
+}
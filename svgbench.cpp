@@ -0,0 +1,192 @@
+#include "MemoryStats.hpp"
+#include "SVGElements.hpp"
+#include "SceneGenerator.hpp"
+#include "SceneOptimizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// One measurement of the sweep.
+struct Sample
+{
+    unsigned value;
+    long file_bytes;
+    size_t shapes;
+    double seconds[3]; // Parse, render, encode (fastest repetition).
+    uint64_t peak_bytes;
+    uint64_t peak_rss;
+};
+
+static double since(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool setParameter(const std::string &param, unsigned value, svg::GeneratorOptions &options)
+{
+    if (param == "size")
+    {
+        options.width = options.height = (int)value;
+        return true;
+    }
+    return svg::parseGeneratorOption("--" + param + "=" + std::to_string(value), options);
+}
+
+static Sample measure(const std::string &prefix, unsigned value, const svg::GeneratorOptions &generator,
+                      const svg::RenderOptions &options, int repeat)
+{
+    Sample s = Sample();
+    s.value = value;
+    std::string svg_file = prefix + ".svg", png_file = prefix + ".png";
+    {
+        std::ofstream out(svg_file);
+        svg::generateSVG(out, generator);
+        s.file_bytes = (long)out.tellp();
+    }
+    std::fill(s.seconds, s.seconds + 3, 1e30);
+    for (int r = 0; r < repeat; r++)
+    {
+        svg::startMemoryTracking();
+        auto t = std::chrono::steady_clock::now();
+        svg::Point dimensions;
+        std::vector<std::unique_ptr<svg::SVGElement>> svg_elements;
+        svg::readSVG(svg_file, dimensions, svg_elements);
+        double parse = since(t);
+        s.shapes = svg::sceneStats(svg_elements).shapes;
+        t = std::chrono::steady_clock::now();
+        svg::PNGImage img(dimensions.x, dimensions.y, false);
+        svg::renderScene(svg_elements, img, options);
+        double render = since(t);
+        t = std::chrono::steady_clock::now();
+        img.save(png_file);
+        double encode = since(t);
+        svg::MemoryStats memory = svg::stopMemoryTracking();
+        s.seconds[0] = std::min(s.seconds[0], parse);
+        s.seconds[1] = std::min(s.seconds[1], render);
+        s.seconds[2] = std::min(s.seconds[2], encode);
+        s.peak_bytes = memory.peak_bytes;
+        s.peak_rss = memory.peak_rss;
+    }
+    return s;
+}
+
+// Bars scaled to the largest value of each column, and the growth exponent
+// log(y2 / y1) / log(x2 / x1) between consecutive samples: about 1 for linear
+// behavior; "!" marks steps that grow clearly faster.
+static void plot(const std::string &param, const std::vector<Sample> &samples)
+{
+    const char *names[4] = {"parse", "render", "encode", "peak memory"};
+    double max[4] = {0, 0, 0, 0};
+    auto column = [](const Sample &s, int c) { return c < 3 ? s.seconds[c] : (double)s.peak_bytes; };
+    for (const Sample &s : samples)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            max[c] = std::max(max[c], column(s, c));
+        }
+    }
+    const int width = 16;
+    std::fprintf(stderr, "\n%10s", param.c_str());
+    for (int c = 0; c < 4; c++)
+    {
+        std::fprintf(stderr, "  %-*s %6s", width, names[c], "exp ");
+    }
+    std::fprintf(stderr, "\n");
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        std::fprintf(stderr, "%10u", samples[i].value);
+        for (int c = 0; c < 4; c++)
+        {
+            double y = column(samples[i], c);
+            int bar = max[c] > 0 ? (int)std::lround(width * y / max[c]) : 0;
+            std::fprintf(stderr, "  %s%*s", std::string(bar, '#').c_str(), width - bar, "");
+            double y0 = i > 0 ? column(samples[i - 1], c) : 0;
+            if (i > 0 && y0 > 0 && y > 0 && samples[i].value != samples[i - 1].value)
+            {
+                double exponent = std::log(y / y0) / std::log((double)samples[i].value / samples[i - 1].value);
+                bool steep = exponent > 1.3 && (c == 3 || y > 1e-3);
+                std::fprintf(stderr, " %5.2f%s", exponent, steep ? "!" : " ");
+            }
+            else
+            {
+                std::fprintf(stderr, " %6s", "");
+            }
+        }
+        std::fprintf(stderr, "\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    svg::GeneratorOptions generator;
+    svg::RenderOptions options;
+    std::string param = "elements";
+    unsigned from = 1000, to = 64000;
+    double factor = 2;
+    int repeat = 1;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+        std::string opt = argv[arg];
+        if (opt.compare(0, 8, "--param=") == 0)
+        {
+            param = opt.substr(8);
+        }
+        else if (opt.compare(0, 7, "--from=") == 0)
+        {
+            from = (unsigned)std::strtoul(opt.c_str() + 7, nullptr, 10);
+        }
+        else if (opt.compare(0, 5, "--to=") == 0)
+        {
+            to = (unsigned)std::strtoul(opt.c_str() + 5, nullptr, 10);
+        }
+        else if (opt.compare(0, 9, "--factor=") == 0)
+        {
+            factor = std::atof(opt.c_str() + 9);
+        }
+        else if (opt.compare(0, 9, "--repeat=") == 0)
+        {
+            repeat = std::max(1, std::atoi(opt.c_str() + 9));
+        }
+        else if (opt == "--antialias")
+        {
+            options.antialias = true;
+        }
+        else if (!svg::parseGeneratorOption(opt, generator))
+        {
+            std::cout << "Unknown option: " << opt << std::endl;
+            return 1;
+        }
+    }
+    if (argc - arg > 1 || from == 0 || from > to || factor <= 1 || !setParameter(param, from, generator))
+    {
+        std::cout << "Usage: svgbench [--param=elements|vertices|depth|uses|size] [--from=N] [--to=N] [--factor=F]" << std::endl;
+        std::cout << "                [--repeat=N] [--antialias] [generator options, see svggen] [work_file_prefix]" << std::endl;
+        return 1;
+    }
+    std::string prefix = arg < argc ? argv[arg] : "svgbench";
+
+    std::vector<Sample> samples;
+    std::cout << "param,value,file_bytes,shapes,parse_ms,render_ms,encode_ms,peak_bytes,peak_rss" << std::endl;
+    for (double v = from; v <= to; v = std::max(v * factor, v + 1))
+    {
+        unsigned value = (unsigned)v;
+        setParameter(param, value, generator);
+        Sample s = measure(prefix, value, generator, options, repeat);
+        samples.push_back(s);
+        std::printf("%s,%u,%ld,%zu,%.3f,%.3f,%.3f,%llu,%llu\n", param.c_str(), s.value, s.file_bytes, s.shapes,
+                    s.seconds[0] * 1e3, s.seconds[1] * 1e3, s.seconds[2] * 1e3,
+                    (unsigned long long)s.peak_bytes, (unsigned long long)s.peak_rss);
+        std::fflush(stdout);
+    }
+    plot(param, samples);
+    std::remove((prefix + ".svg").c_str());
+    std::remove((prefix + ".png").c_str());
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include "SceneGenerator.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    svg::GeneratorOptions options;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+        if (!svg::parseGeneratorOption(argv[arg], options))
+        {
+            std::cout << "Unknown option: " << argv[arg] << std::endl;
+            return 1;
+        }
+    }
+    if (argc - arg != 1)
+    {
+        std::cout << "Usage: svggen [--elements=N] [--mix=rects:circles:ellipses:lines:polylines:polygons:paths]" << std::endl;
+        std::cout << "              [--vertices=N] [--depth=N] [--group-size=N] [--uses=N] [--size=WxH] [--seed=N] out_file.svg" << std::endl;
+        return 1;
+    }
+    std::ofstream out(argv[arg]);
+    svg::generateSVG(out, options);
+    if (!out)
+    {
+        std::cout << "Unable to write " << argv[arg] << std::endl;
+        return 1;
+    }
+    return 0;
+}
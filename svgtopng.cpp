@@ -1,17 +1,409 @@
+#include "Budget.hpp"
+#include "Pipeline.hpp"
 #include "SVGElements.hpp"
+#include "SceneFile.hpp"
+#include "Server.hpp"
+#include "Watch.hpp"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static void printScene(const char *label, const svg::SceneStats &s)
+{
+    std::cout << label << s.groups << " groups, " << s.shapes << " shapes, depth " << s.depth << std::endl;
+}
+
+static void printMemory(const svg::MemoryStats &m)
+{
+    std::printf("%-12s %12s %14s %14s\n", "Phase", "Allocations", "Bytes", "Peak live");
+    for (size_t i = 0; i < svg::MEMORY_PHASES; i++)
+    {
+        const svg::PhaseMemory &p = m.phases[i];
+        if (p.allocations != 0)
+        {
+            std::printf("%-12s %12llu %14llu %14llu\n", svg::memoryPhaseName((svg::MemoryPhase)i),
+                        (unsigned long long)p.allocations, (unsigned long long)p.bytes,
+                        (unsigned long long)p.peak_bytes);
+        }
+    }
+    std::printf("Peak live bytes: %llu\n", (unsigned long long)m.peak_bytes);
+    std::printf("Peak RSS:        %llu KiB\n", (unsigned long long)(m.peak_rss / 1024));
+}
+
+static void printStage(const char *label, const svg::StageStats &s)
+{
+    std::cout << label << s.threads << " threads, " << s.items << " items, "
+              << (int)(s.utilization * 100 + 0.5) << "% busy, queue max " << s.max_queue_depth
+              << " mean " << s.mean_queue_depth << std::endl;
+}
+
+//! Token cancelled by SIGINT and SIGTERM while serving.
+static svg::CancellationToken *server_stop = nullptr;
+
+static void stopServer(int)
+{
+    if (server_stop != nullptr)
+    {
+        server_stop->cancel();
+    }
+}
+
+//! Make a path absolute, so a server with another working directory finds it.
+static std::string absolutePath(const std::string &path)
+{
+    if (!path.empty() && path[0] == '/')
+    {
+        return path;
+    }
+    std::vector<char> cwd(4096);
+    if (::getcwd(cwd.data(), cwd.size()) == nullptr)
+    {
+        return path;
+    }
+    return std::string(cwd.data()) + "/" + path;
+}
+
+//! Convert a file through a server started with --serve.
+static int convertRemotely(const std::string &socket_path, bool by_path, const std::string &svg_file,
+                           const std::string &png_file)
+{
+    try
+    {
+        svg::ConversionClient client(socket_path);
+        if (by_path)
+        {
+            client.convertFile(absolutePath(svg_file), absolutePath(png_file));
+            return 0;
+        }
+        std::ifstream in(svg_file, std::ios::binary);
+        if (!in)
+        {
+            std::cout << "Unable to load " << svg_file << std::endl;
+            return 1;
+        }
+        std::string svg_data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string png = client.convertData(svg_data);
+        std::ofstream out(png_file, std::ios::binary);
+        out.write(png.data(), (std::streamsize)png.size());
+        if (!out)
+        {
+            std::cout << "Unable to write " << png_file << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    svg::RenderOptions options;
+    bool print_stats = false;
+    bool compile = false;
+    bool batch = false;
+    bool watch = false;
+    int debounce_ms = 50;
+    std::string serve_socket, connect_socket;
+    bool by_path = false;
+    svg::ServerOptions server;
+    svg::PipelineOptions pipeline;
+    int frames = 0;
+    svg::FrameTransform frame_transform;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; arg++)
+    {
+        std::string opt = argv[arg];
+        if (opt == "--antialias")
+        {
+            options.antialias = true;
+        }
+        else if (opt == "--no-optimize")
+        {
+            options.optimize = false;
+        }
+        else if (opt.compare(0, 9, "--frames=") == 0)
+        {
+            frames = std::atoi(opt.c_str() + 9);
+        }
+        else if (opt.compare(0, 9, "--target=") == 0)
+        {
+            frame_transform.id = opt.substr(9);
+        }
+        else if (opt.compare(0, 12, "--translate=") == 0)
+        {
+            std::sscanf(opt.c_str() + 12, "%d,%d", &frame_transform.translate.x, &frame_transform.translate.y);
+        }
+        else if (opt.compare(0, 9, "--rotate=") == 0)
+        {
+            frame_transform.rotate = std::atoi(opt.c_str() + 9);
+        }
+        else if (opt.compare(0, 8, "--scale=") == 0)
+        {
+            frame_transform.scale = std::atoi(opt.c_str() + 8);
+        }
+        else if (opt.compare(0, 9, "--origin=") == 0)
+        {
+            std::sscanf(opt.c_str() + 9, "%d,%d", &frame_transform.origin.x, &frame_transform.origin.y);
+        }
+        else if (opt.compare(0, 10, "--threads=") == 0)
+        {
+            options.threads = (unsigned)std::atoi(opt.c_str() + 10);
+        }
+        else if (opt == "--batch")
+        {
+            batch = true;
+        }
+        else if (opt == "--watch")
+        {
+            watch = true;
+        }
+        else if (opt.compare(0, 11, "--debounce=") == 0)
+        {
+            debounce_ms = std::atoi(opt.c_str() + 11);
+        }
+        else if (opt.compare(0, 8, "--serve=") == 0)
+        {
+            serve_socket = opt.substr(8);
+        }
+        else if (opt.compare(0, 10, "--workers=") == 0)
+        {
+            server.workers = (unsigned)std::atoi(opt.c_str() + 10);
+        }
+        else if (opt.compare(0, 10, "--connect=") == 0)
+        {
+            connect_socket = opt.substr(10);
+        }
+        else if (opt == "--by-path")
+        {
+            by_path = true;
+        }
+        else if (opt.compare(0, 10, "--readers=") == 0)
+        {
+            pipeline.readers = (unsigned)std::atoi(opt.c_str() + 10);
+        }
+        else if (opt.compare(0, 12, "--renderers=") == 0)
+        {
+            pipeline.renderers = (unsigned)std::atoi(opt.c_str() + 12);
+        }
+        else if (opt.compare(0, 11, "--encoders=") == 0)
+        {
+            pipeline.encoders = (unsigned)std::atoi(opt.c_str() + 11);
+        }
+        else if (opt.compare(0, 8, "--queue=") == 0)
+        {
+            pipeline.queue_capacity = (size_t)std::atoi(opt.c_str() + 8);
+        }
+        else if (opt.compare(0, 13, "--max-pixels=") == 0)
+        {
+            options.budget.max_pixels = std::strtoull(opt.c_str() + 13, nullptr, 10);
+        }
+        else if (opt.compare(0, 12, "--max-edges=") == 0)
+        {
+            options.budget.max_edges = std::strtoull(opt.c_str() + 12, nullptr, 10);
+        }
+        else if (opt.compare(0, 15, "--max-vertices=") == 0)
+        {
+            options.budget.max_vertices = std::strtoull(opt.c_str() + 15, nullptr, 10);
+        }
+        else if (opt.compare(0, 12, "--max-bytes=") == 0)
+        {
+            options.budget.max_bytes = std::strtoull(opt.c_str() + 12, nullptr, 10);
+        }
+        else if (opt == "--over-budget=reject")
+        {
+            options.budget.policy = svg::BudgetPolicy::Reject;
+        }
+        else if (opt == "--over-budget=downscale")
+        {
+            options.budget.policy = svg::BudgetPolicy::Downscale;
+        }
+        else if (opt == "--over-budget=truncate")
+        {
+            options.budget.policy = svg::BudgetPolicy::Truncate;
+        }
+        else if (opt == "--compile")
+        {
+            compile = true;
+        }
+        else if (opt == "--stats")
+        {
+            print_stats = true;
+            options.track_memory = true;
+        }
+        else if (opt == "--span-buffer")
+        {
+            options.span_buffer = true;
+        }
+        else if (opt == "--simplify")
+        {
+            options.simplify = true;
+        }
+        else if (opt.compare(0, 11, "--simplify=") == 0)
+        {
+            options.simplify = true;
+            options.simplify_tolerance = std::atof(opt.c_str() + 11);
+        }
+        else
+        {
+            std::cout << "Unknown option: " << opt << std::endl;
+            return 1;
+        }
+    }
+    if (batch && argc - arg >= 2 && (argc - arg) % 2 == 0)
+    {
+        std::vector<svg::ConversionJob> jobs;
+        for (; arg < argc; arg += 2)
+        {
+            jobs.push_back({argv[arg], argv[arg + 1]});
+        }
+        std::cout << "Converting " << jobs.size() << " files ... " << std::endl;
+        pipeline.render = options;
+        svg::PipelineStats stats = svg::convertBatch(jobs, pipeline);
+        for (const std::string &error : stats.errors)
+        {
+            std::cout << "Error: " << error << std::endl;
+        }
+        if (print_stats)
+        {
+            printStage("Read:   ", stats.read);
+            printStage("Render: ", stats.render);
+            printStage("Encode: ", stats.encode);
+            std::cout << "Elapsed: " << stats.elapsed << " s" << std::endl;
+        }
+        std::cout << "Done!" << std::endl;
+        return stats.errors.empty() ? 0 : 1;
+    }
+    if (!serve_socket.empty() && argc == arg)
+    {
+        svg::CancellationToken stop;
+        server_stop = &stop;
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        // Keep the server's default limits unless other ones were given.
+        svg::RenderBudget limits = server.render.budget;
+        server.render = options;
+        if (options.budget.max_bytes == 0)
+        {
+            server.render.budget.max_bytes = limits.max_bytes;
+        }
+        if (options.budget.max_pixels == 0)
+        {
+            server.render.budget.max_pixels = limits.max_pixels;
+        }
+        std::cout << "Serving on " << serve_socket << " (Ctrl-C to stop)" << std::endl;
+        svg::ServerStats stats = svg::serve(serve_socket, server, &stop);
+        std::cout << "Served " << stats.requests << " requests (" << stats.errors << " errors) on "
+                  << stats.connections << " connections" << std::endl;
+        return 0;
+    }
+    if (!connect_socket.empty() && argc - arg == 2)
     {
-        std::cout << "Usage: svgtopng in_file.svg out_file.png" << std::endl;
+        return convertRemotely(connect_socket, by_path, argv[arg], argv[arg + 1]);
+    }
+    if (watch && !batch && argc - arg == 2)
+    {
+        std::cout << "Watching " << argv[arg] << " --> " << argv[arg + 1] << " (Ctrl-C to stop)" << std::endl;
+        svg::WatchOptions watch_options;
+        watch_options.render = options;
+        watch_options.debounce_ms = debounce_ms;
+        svg::watchDirectory(argv[arg], argv[arg + 1], watch_options, [](const svg::RenderUpdate &u) {
+            if (!u.error.empty())
+            {
+                std::cout << "Error: " << u.error << std::endl;
+                return;
+            }
+            std::cout << u.svg_file << " --> " << u.png_file << ": " << (int)(u.seconds * 1000 + 0.5) << " ms, ";
+            if (!u.incremental)
+            {
+                std::cout << "full render" << std::endl;
+            }
+            else if (u.region.empty())
+            {
+                std::cout << "unchanged" << std::endl;
+            }
+            else
+            {
+                std::cout << "redrew " << u.region.min.x << "," << u.region.min.y << " - " << u.region.max.x << ","
+                          << u.region.max.y << std::endl;
+            }
+        });
+        return 0;
+    }
+    if (batch || watch || !serve_socket.empty() || !connect_socket.empty() || argc - arg != 2)
+    {
+        std::cout << "Usage: svgtopng [--antialias] [--simplify[=pixels]] [--span-buffer] [--no-optimize] [--stats]" << std::endl;
+        std::cout << "                [--max-pixels=N] [--max-edges=N] [--max-vertices=N] [--max-bytes=N]" << std::endl;
+        std::cout << "                [--over-budget=reject|downscale|truncate] in_file.svg out_file.png" << std::endl;
+        std::cout << "       svgtopng --compile in_file.svg out_file.svgs" << std::endl;
+        std::cout << "       svgtopng --frames=N [--target=id] [--translate=dx,dy] [--rotate=degrees]" << std::endl;
+        std::cout << "                [--scale=step] [--origin=x,y] [--threads=N] in_file.svg frame_%03d.png" << std::endl;
+        std::cout << "       svgtopng --batch [--readers=N] [--renderers=N] [--encoders=N] [--queue=N] [--stats]" << std::endl;
+        std::cout << "                in_1.svg out_1.png [in_2.svg out_2.png ...]" << std::endl;
+        std::cout << "       svgtopng --watch [--debounce=ms] [--antialias] [--no-optimize] in_dir out_dir" << std::endl;
+        std::cout << "       svgtopng --serve=socket [--workers=N] [--antialias] [--no-optimize] [--span-buffer]" << std::endl;
+        std::cout << "       svgtopng --connect=socket [--by-path] in_file.svg out_file.png" << std::endl;
+    }
+    else if (frames > 0)
+    {
+        std::cout << "Rendering " << frames << " frames ... " << argv[arg] << " --> " << argv[arg + 1] << std::endl;
+        try
+        {
+            svg::renderFrames(argv[arg], argv[arg + 1], frames, {frame_transform}, options);
+        }
+        catch (const svg::BudgetExceeded &e)
+        {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "Done!" << std::endl;
+    }
+    else if (compile)
+    {
+        std::cout << "Compiling scene ... " << argv[arg] << " --> " << argv[arg + 1] << std::endl;
+        svg::compileScene(argv[arg], argv[arg + 1]);
+        std::cout << "Done!" << std::endl;
     }
     else
     {
-        std::cout << "Performing conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
-        svg::convert(argv[1], argv[2]);
+        std::cout << "Performing conversion ... " << argv[arg] << " --> " << argv[arg + 1] << std::endl;
+        svg::RenderStats stats;
+        try
+        {
+            svg::convert(argv[arg], argv[arg + 1], options, &stats);
+        }
+        catch (const svg::BudgetExceeded &e)
+        {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+        if (options.span_buffer && !options.antialias)
+        {
+            std::cout << "Overdraw: " << stats.overdraw << std::endl;
+        }
+        if (print_stats)
+        {
+            printScene("Parsed scene:    ", stats.parsed);
+            printScene("Optimized scene: ", stats.optimized);
+            std::cout << "Estimated cost:  " << stats.cost.pixels << " pixels, " << stats.cost.edges << " edges, "
+                      << stats.cost.vertices << " vertices, " << stats.cost.bytes << " bytes" << std::endl;
+            std::cout << std::flush;
+            printMemory(stats.memory);
+        }
+        if (stats.downscale > 1)
+        {
+            std::cout << "Downscaled by " << stats.downscale << " to fit the budget" << std::endl;
+        }
         std::cout << "Done!" << std::endl;
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,17 +1,32 @@
 
 // Project file headers
+#include "Async.hpp"
+#include "Budget.hpp"
+#include "ImageDiff.hpp"
+#include "Pipeline.hpp"
 #include "SVGElements.hpp"
+#include "SceneFile.hpp"
+#include "Server.hpp"
+#include "SpatialIndex.hpp"
+#include "Watch.hpp"
+#include "external/tinyxml2/tinyxml2.h"
 
 // C++ library headers
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <vector>
 #include <iterator>
+#include <utility>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <chrono>
 using namespace std;
 
 // POSIX headers
@@ -33,12 +48,108 @@ namespace svg
         int failed_tests = 0;
         FILE *log_stream;
 
+        bool exists(const string &file)
+        {
+            return ::access(file.c_str(), F_OK) == 0;
+        }
+
+        string input_file(const string &id)
+        {
+            return root_path + "/input/" + id + ".svg";
+        }
+
+        string expected_file(const string &name)
+        {
+            return root_path + "/expected/" + name + ".png";
+        }
+
+        string output_file(const string &name)
+        {
+            return root_path + "/output/" + name + ".png";
+        }
+
         bool run_conversion_test(const string &id)
         {
-            string svg_file = root_path + "/input/" + id + ".svg";
-            string exp_file = root_path + "/expected/" + id + ".png";
-            string out_file = root_path + "/output/" + id + ".png";
-            convert(svg_file, out_file);
+            return run_conversion_test(input_file(id), expected_file(id), output_file(id), RenderOptions());
+        }
+
+        bool run_conversion_test(const string &svg_file, const string &exp_file, const string &out_file,
+                                 const RenderOptions &options)
+        {
+            convert(svg_file, out_file, options);
+            return compare_images(exp_file, out_file);
+        }
+
+        bool run_scene_file_test(const string &id)
+        {
+            string scene_file = root_path + "/output/" + id + ".svgs";
+            compileScene(input_file(id), scene_file);
+            return run_conversion_test(scene_file, expected_file(id), output_file(id + "_svgs"), RenderOptions());
+        }
+
+        bool run_scene_file_checks_test()
+        {
+            string scene_file = root_path + "/output/polygon_2.svgs";
+            compileScene(input_file("polygon_2"), scene_file);
+            ifstream in(scene_file, ios::binary);
+            const string scene((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            SceneFile(scene_file).dimensions();
+            // A zero width (after the magic and version), and the convex flag on the star.
+            string no_width = scene, forced_convex = scene;
+            fill(no_width.begin() + 8, no_width.begin() + 12, '\0');
+            uint32_t records;
+            memcpy(&records, scene.data() + 16, sizeof(records));
+            for (uint32_t i = 0; i < records; i++)
+            {
+                SceneRecord *r = (SceneRecord *)&forced_convex[32 + i * sizeof(SceneRecord)];
+                if (r->type == (uint8_t)SceneRecordType::Polygon && (r->flags & (SCENE_CONVEX | SCENE_AXIS_RECT)) == 0)
+                {
+                    r->flags |= SCENE_CONVEX;
+                }
+            }
+            for (const string *corrupt : {&no_width, &forced_convex})
+            {
+                string corrupt_file = root_path + "/output/polygon_2_corrupt.svgs";
+                ofstream(corrupt_file, ios::binary) << *corrupt;
+                try
+                {
+                    SceneFile loaded(corrupt_file);
+                    cout << "A corrupt scene file was loaded" << endl;
+                    return false;
+                }
+                catch (const runtime_error &)
+                {
+                }
+            }
+            return forced_convex != scene;
+        }
+
+        bool run_gzip_limits_test()
+        {
+            string svgz_file = root_path + "/input/compressed/lion.svgz";
+            ifstream in(svgz_file, ios::binary);
+            string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            tinyxml2::XMLDocument doc;
+            // The stored length may lie either way without changing the result.
+            for (uint32_t stored : {0u, 1u, 0xFFFFFFFFu})
+            {
+                memcpy(&data[data.size() - 4], &stored, sizeof(stored));
+                parseXML(doc, data.data(), data.size(), svgz_file);
+            }
+            try
+            {
+                parseXML(doc, data.data(), data.size(), svgz_file, 4096);
+                cout << "A document was inflated past its limit" << endl;
+                return false;
+            }
+            catch (const runtime_error &)
+            {
+            }
+            return true;
+        }
+
+        bool compare_images(const string &exp_file, const string &out_file)
+        {
             PNGImage img1(exp_file), img2(out_file);
             int w1 = img1.width(), h1 = img1.height(),
                 w2 = img2.width(), h2 = img2.height();
@@ -49,22 +160,374 @@ namespace svg
                           << w2 << "x" << h2 << endl;
                 return false;
             }
-            for (int i = 0; i < w1; i++)
+            DiffResult diff = diffImages(img1, img2);
+            if (diff.pixels != 0)
+            {
+                Color c1 = img1.at(diff.first.x, diff.first.y), c2 = img2.at(diff.first.x, diff.first.y);
+                cout << diff.pixels << " pixels differ in (" << diff.box.min.x << ' ' << diff.box.min.y << ")-("
+                     << diff.box.max.x << ' ' << diff.box.max.y << "); pixel (" << diff.first.x << ' ' << diff.first.y
+                     << "): expected " << (int)c1.red << ' ' << (int)c1.green << ' ' << (int)c1.blue
+                     << " got " << (int)c2.red << ' ' << (int)c2.green << ' ' << (int)c2.blue << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool run_spatial_index_test()
+        {
+            // Two overlapping circles in a translated group: red around
+            // (25,25), then blue around (45,45), both of radius 25.
+            string svg_file = root_path + "/input/group_2.svg";
+            PNGImage expected(root_path + "/expected/group_2.png");
+            Point dimensions;
+            vector<unique_ptr<SVGElement>> svg_elements;
+            readSVG(svg_file, dimensions, svg_elements);
+            SpatialIndex index;
+            index.build(svg_elements);
+            if (index.size() != 2)
+            {
+                cout << "Indexed " << index.size() << " shapes instead of 2" << endl;
+                return false;
+            }
+            // The topmost shape at a pixel, drawn alone, paints the golden color there.
+            const Point points[] = {{15, 15}, {40, 40}, {60, 60}};
+            vector<SVGElement *> picked;
+            for (const Point &p : points)
+            {
+                vector<SVGElement *> found = index.at(p);
+                if (found.empty())
+                {
+                    cout << "No shape at (" << p.x << ' ' << p.y << ")" << endl;
+                    return false;
+                }
+                PNGImage img(dimensions.x, dimensions.y);
+                found.front()->draw(img);
+                Color c1 = expected.at(p.x, p.y), c2 = img.at(p.x, p.y);
+                if (c1.red != c2.red || c1.green != c2.green || c1.blue != c2.blue)
+                {
+                    cout << "Wrong shape at (" << p.x << ' ' << p.y << ")" << endl;
+                    return false;
+                }
+                picked.push_back(found.front());
+            }
+            if (index.at({40, 40}).size() != 2 || index.at({40, 40}).back() != picked[0])
+            {
+                cout << "Both circles should be at (40 40), red last" << endl;
+                return false;
+            }
+            // (22,22) is inside the box of the blue circle, but only the red one draws it.
+            vector<SVGElement *> corner = index.at({22, 22});
+            if (corner.size() != 1 || corner.front() != picked[0] || index.in(Box{{22, 22}, {22, 22}}).size() != 2)
+            {
+                cout << "Only the red circle should be at (22 22)" << endl;
+                return false;
+            }
+            // Moving the whole group moves every shape inside it.
+            Point t = {30, 30};
+            svg_elements.front()->translate(t);
+            index.update(*svg_elements.front());
+            for (size_t i = 0; i < picked.size(); i++)
+            {
+                Point p = {points[i].x + t.x, points[i].y + t.y};
+                vector<SVGElement *> found = index.at(p);
+                if (found.empty() || found.front() != picked[i])
+                {
+                    cout << "Wrong shape at (" << p.x << ' ' << p.y << ") after translate" << endl;
+                    return false;
+                }
+            }
+            if (!index.at(points[0]).empty())
+            {
+                cout << "Shapes left at (" << points[0].x << ' ' << points[0].y << ") after translate" << endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool run_incremental_test()
+        {
+            // One polygon of the lion is moved, and only what it covered is redrawn.
+            tinyxml2::XMLDocument doc;
+            if (doc.LoadFile(input_file("lion").c_str()) != tinyxml2::XML_SUCCESS)
+            {
+                cout << "Unable to load the lion" << endl;
+                return false;
+            }
+            tinyxml2::XMLElement *moved = doc.RootElement()->FirstChildElement("polygon");
+            for (int i = 0; i < 20 && moved != nullptr; i++)
+            {
+                moved = moved->NextSiblingElement("polygon");
+            }
+            string svg_file = root_path + "/output/lion_incremental.svg";
+            for (bool antialias : {false, true})
+            {
+                string name = antialias ? "lion_incremental_antialias" : "lion_incremental";
+                moved->DeleteAttribute("transform");
+                doc.SaveFile(svg_file.c_str());
+                RenderOptions options;
+                options.antialias = antialias;
+                IncrementalRenderer renderer(options);
+                RenderUpdate first = renderer.update(svg_file, output_file(name));
+                moved->SetAttribute("transform", "translate(15,9)");
+                doc.SaveFile(svg_file.c_str());
+                RenderUpdate second = renderer.update(svg_file, output_file(name));
+                if (!first.error.empty() || !second.error.empty())
+                {
+                    cout << "Incremental update failed: " << first.error << second.error << endl;
+                    return false;
+                }
+                if (first.incremental || !second.incremental)
+                {
+                    cout << "Expected a full redraw, then an incremental one" << endl;
+                    return false;
+                }
+                convert(svg_file, output_file(name + "_full"), options);
+                if (!compare_images(output_file(name + "_full"), output_file(name)))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool run_batch_test()
+        {
+            // Documents, a compiled scene and a missing file, through every stage at once.
+            const vector<string> ids = {"circle_1", "ellipse_2", "group_3", "lion", "path_1", "polygon_3", "rect_3", "use_4"};
+            vector<ConversionJob> jobs;
+            for (const string &id : ids)
+            {
+                jobs.push_back({input_file(id), output_file(id + "_batch")});
+            }
+            string scene_file = root_path + "/output/lion_batch.svgs";
+            compileScene(input_file("lion"), scene_file);
+            jobs.push_back({scene_file, output_file("lion_batch_scene")});
+            string missing = input_file("missing");
+            jobs.push_back({missing, output_file("missing_batch")});
+            PipelineOptions options;
+            options.readers = options.renderers = options.encoders = 2;
+            options.queue_capacity = 2;
+            PipelineStats stats = convertBatch(jobs, options);
+
+            // Every job is either written by all three stages or reported once.
+            size_t done = jobs.size() - 1;
+            if (stats.read.items != done || stats.render.items != done || stats.encode.items != done)
+            {
+                cout << "Stages processed " << stats.read.items << '/' << stats.render.items << '/'
+                     << stats.encode.items << " jobs instead of " << done << endl;
+                return false;
+            }
+            if (stats.errors.size() != 1 || stats.errors.front().compare(0, missing.size(), missing) != 0)
+            {
+                cout << "Expected one error, for " << missing << endl;
+                return false;
+            }
+            for (const string &id : ids)
+            {
+                if (!compare_images(expected_file(id), output_file(id + "_batch")))
+                {
+                    return false;
+                }
+            }
+            return compare_images(expected_file("lion"), output_file("lion_batch_scene"));
+        }
+
+        bool run_cancellation_test()
+        {
+            string svg_file = input_file("lion");
+            string out_file = output_file("lion_cancelled");
+            ::unlink(out_file.c_str());
+            CancellationToken cancel;
+            cancel.cancel();
+            RenderOptions options;
+            options.cancel = &cancel;
+            try
+            {
+                convert(svg_file, out_file, options);
+                cout << "convert() ignored a cancelled token" << endl;
+                return false;
+            }
+            catch (const Cancelled &)
+            {
+            }
+            if (exists(out_file))
+            {
+                cout << "A cancelled conversion wrote " << out_file << endl;
+                return false;
+            }
+            future<RenderStats> result = convertAsync(svg_file, out_file, RenderOptions(), cancel);
+            try
+            {
+                result.get();
+                cout << "convertAsync() ignored a cancelled token" << endl;
+                return false;
+            }
+            catch (const Cancelled &)
             {
-                for (int j = 0; j < h1; j++)
+            }
+            return !exists(out_file);
+        }
+
+        bool run_budget_test()
+        {
+            string svg_file = input_file("lion");
+            RenderStats full;
+            convert(svg_file, output_file("lion_budget"), RenderOptions(), &full);
+            // Half the edges of the document: it does not fit.
+            RenderOptions options;
+            options.budget.max_edges = full.cost.edges / 2;
+            const BudgetPolicy policies[] = {BudgetPolicy::Reject, BudgetPolicy::Truncate};
+            for (BudgetPolicy policy : policies)
+            {
+                bool reject = policy == BudgetPolicy::Reject;
+                string out_file = output_file(reject ? "lion_rejected" : "lion_truncated");
+                ::unlink(out_file.c_str());
+                options.budget.policy = policy;
+                RenderStats stats;
+                try
+                {
+                    convert(svg_file, out_file, options, &stats);
+                    cout << (reject ? "Reject" : "Truncate") << " did not throw BudgetExceeded" << endl;
+                    return false;
+                }
+                catch (const BudgetExceeded &)
+                {
+                }
+                // Reject draws nothing; Truncate writes the elements that fit.
+                if (exists(out_file) == reject)
+                {
+                    cout << (reject ? "Reject wrote " : "Truncate did not write ") << out_file << endl;
+                    return false;
+                }
+                if (!reject && (stats.truncated == 0 || stats.truncated >= full.parsed.shapes))
+                {
+                    cout << "Truncate left out " << stats.truncated << " of " << full.parsed.shapes
+                         << " shapes" << endl;
+                    return false;
+                }
+            }
+            // A scene file cannot be downscaled or truncated: it is rejected.
+            string scene_file = root_path + "/output/lion_budget.svgs";
+            compileScene(svg_file, scene_file);
+            options.budget.policy = BudgetPolicy::Downscale;
+            try
+            {
+                convert(scene_file, output_file("lion_budget_svgs"), options);
+                cout << "A scene file over budget was drawn" << endl;
+                return false;
+            }
+            catch (const BudgetExceeded &)
+            {
+            }
+            // An empty image is an error, not a free one.
+            try
+            {
+                estimateCost(vector<unique_ptr<SVGElement>>(), {0, 10});
+                cout << "An empty image fits the budget" << endl;
+                return false;
+            }
+            catch (const runtime_error &)
+            {
+            }
+            return true;
+        }
+
+        bool run_server_requests(const string &socket_path)
+        {
+            // serve() may not be listening yet.
+            unique_ptr<ConversionClient> client;
+            for (int attempt = 0; !client; attempt++)
+            {
+                try
+                {
+                    client.reset(new ConversionClient(socket_path));
+                }
+                catch (const runtime_error &)
                 {
-                    Color c1 = img1.at(i, j), c2 = img2.at(i, j);
-                    if (c1.red != c2.red || c1.green != c2.green || c1.blue != c2.blue)
+                    if (attempt == 100)
                     {
-                        cout << "pixel (" << i << ' ' << j << "): expected "
-                             << (int)c1.red << ' ' << (int)c1.green << ' ' << (int)c1.blue
-                             << " got "
-                             << (int)c2.red << ' ' << (int)c2.green << ' ' << (int)c2.blue << std::endl;
-                        return false;
+                        throw;
                     }
+                    this_thread::sleep_for(chrono::milliseconds(20));
                 }
             }
-            return true;
+            ifstream in(input_file("lion"), ios::binary);
+            string svg_data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            string png_data = client->convertData(svg_data);
+            string out_file = output_file("lion_served");
+            ofstream(out_file, ios::binary) << png_data;
+            if (!compare_images(expected_file("lion"), out_file))
+            {
+                return false;
+            }
+            out_file = output_file("path_1_served");
+            client->convertFile(input_file("path_1"), out_file);
+            if (!compare_images(expected_file("path_1"), out_file))
+            {
+                return false;
+            }
+            // An error is answered and leaves the connection usable.
+            try
+            {
+                client->convertFile(input_file("missing"), output_file("missing_served"));
+                cout << "The server converted a missing file" << endl;
+                return false;
+            }
+            catch (const runtime_error &)
+            {
+            }
+            // Empty, impossibly large and over-budget images are refused before
+            // the canvas is allocated.
+            const char *const bad_documents[] = {
+                "<svg width=\"0\" height=\"10\"></svg>",
+                "<svg width=\"100000\" height=\"100000\"></svg>",
+                "<svg width=\"20000\" height=\"20000\"></svg>",
+            };
+            for (const char *document : bad_documents)
+            {
+                try
+                {
+                    client->convertData(document);
+                    cout << "The server converted " << document << endl;
+                    return false;
+                }
+                catch (const runtime_error &)
+                {
+                }
+            }
+            png_data = client->convertData(svg_data);
+            return png_data.size() > 0;
+        }
+
+        bool run_server_test()
+        {
+            string socket_path = "/tmp/svgtopng_test_" + to_string(::getpid()) + ".sock";
+            ServerOptions options;
+            options.workers = 2;
+            CancellationToken stop;
+            ServerStats stats;
+            thread server([&] { stats = serve(socket_path, options, &stop); });
+            bool passed;
+            try
+            {
+                passed = run_server_requests(socket_path);
+            }
+            catch (...)
+            {
+                stop.cancel();
+                server.join();
+                throw;
+            }
+            stop.cancel();
+            server.join();
+            ::unlink(socket_path.c_str());
+            if (passed && (stats.requests != 7 || stats.errors != 4))
+            {
+                cout << "The server counted " << stats.requests << " requests and " << stats.errors
+                     << " errors" << endl;
+                return false;
+            }
+            return passed;
         }
 
         void onTestBegin(const string &id)
@@ -95,7 +558,8 @@ namespace svg
             }
         }
 
-        void run_test(const string& id)
+        template <typename Test>
+        void run_test(const string& id, Test test)
         {
             int log_fd = ::fileno(log_stream);
             onTestBegin(id);
@@ -106,7 +570,7 @@ namespace svg
             
                 ::dup2(log_fd, 1);
                 ::dup2(log_fd, 2);
-                bool success = run_conversion_test(id);
+                bool success = test();
                 ::exit(success ? 0 : 1);
             }
             else if (pid > 0)
@@ -157,17 +621,90 @@ namespace svg
                 }
             }
             ::closedir(directory);
-            if (scripts_to_execute.empty())
+            sort(scripts_to_execute.begin(), scripts_to_execute.end());
+
+            // Every test, by name, in the order they run.
+            vector<pair<string, function<bool()>>> tests;
+            for (const string &id : scripts_to_execute)
+            {
+                tests.push_back({id, [this, id] { return run_conversion_test(id); }});
+            }
+            // Inputs with an "<id>_antialias.png" golden are also rendered anti-aliased.
+            RenderOptions antialias;
+            antialias.antialias = true;
+            for (const string &id : scripts_to_execute)
+            {
+                if (exists(expected_file(id + "_antialias")))
+                {
+                    tests.push_back({id + "_antialias", [this, id, antialias]
+                                     { return run_conversion_test(input_file(id), expected_file(id + "_antialias"),
+                                                                  output_file(id + "_antialias"), antialias); }});
+                }
+            }
+            // Inputs with a gzip-compressed copy in input/compressed are also read from it.
+            for (const string &id : scripts_to_execute)
+            {
+                string svgz_file = root_path + "/input/compressed/" + id + ".svgz";
+                if (exists(svgz_file))
+                {
+                    tests.push_back({id + "_svgz", [this, id, svgz_file]
+                                     { return run_conversion_test(svgz_file, expected_file(id),
+                                                                  output_file(id + "_svgz"), RenderOptions()); }});
+                }
+            }
+            // Writing each pixel once through a span buffer must not change any pixel.
+            RenderOptions span_buffer;
+            span_buffer.span_buffer = true;
+            for (const string &id : scripts_to_execute)
+            {
+                tests.push_back({id + "_span_buffer", [this, id, span_buffer]
+                                 { return run_conversion_test(input_file(id), expected_file(id),
+                                                              output_file(id + "_span_buffer"), span_buffer); }});
+            }
+            // The scene optimizer must not change any pixel either.
+            RenderOptions no_optimize;
+            no_optimize.optimize = false;
+            for (const string &id : scripts_to_execute)
+            {
+                tests.push_back({id + "_no_optimize", [this, id, no_optimize]
+                                 { return run_conversion_test(input_file(id), expected_file(id),
+                                                              output_file(id + "_no_optimize"), no_optimize); }});
+            }
+            // A compiled scene file draws the same pixels as its document.
+            for (const string &id : scripts_to_execute)
+            {
+                tests.push_back({id + "_svgs", [this, id] { return run_scene_file_test(id); }});
+            }
+            // Tests that check more than the conversion of one input.
+            typedef bool (TestDriver::*Check)();
+            const vector<pair<string, Check>> checks = {
+                {"batch", &TestDriver::run_batch_test},
+                {"budget", &TestDriver::run_budget_test},
+                {"cancellation", &TestDriver::run_cancellation_test},
+                {"gzip_limits", &TestDriver::run_gzip_limits_test},
+                {"incremental", &TestDriver::run_incremental_test},
+                {"scene_file_checks", &TestDriver::run_scene_file_checks_test},
+                {"server", &TestDriver::run_server_test},
+                {"spatial_index", &TestDriver::run_spatial_index_test},
+            };
+            for (const pair<string, Check> &check : checks)
+            {
+                if (check.first.find(spec) == 0)
+                {
+                    Check run = check.second;
+                    tests.push_back({check.first, [this, run] { return (this->*run)(); }});
+                }
+            }
+            if (tests.empty())
             {
                 cout << "No scripts matched the spec: " << spec << endl;
                 return;
             }
-            sort(scripts_to_execute.begin(), scripts_to_execute.end());
 
-            cout << "== " << scripts_to_execute.size() << " tests to execute  ==" << endl;
-            for (string id : scripts_to_execute)
+            cout << "== " << tests.size() << " tests to execute  ==" << endl;
+            for (const pair<string, function<bool()>> &test : tests)
             {
-                run_test(id);
+                run_test(test.first, test.second);
             }
 
             cout << "== TEST EXECUTION SUMMARY ==" << endl
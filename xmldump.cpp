@@ -1,8 +1,12 @@
 #include "external/tinyxml2/tinyxml2.h"
+#include "SVGElements.hpp"
+#include "SceneProfile.hpp"
 
 using namespace tinyxml2;
 
+#include <exception>
 #include <iostream>
+#include <string>
 
 void dump(XMLElement *elem, int indentation)
 {
@@ -24,14 +28,35 @@ void dump(XMLElement *elem, int indentation)
 int main(int argc, char **argv)
 {
     XMLDocument doc;
-    if (argc != 2)
+    if (argc == 3 && std::string(argv[1]) == "--profile")
     {
-        std::cout << "Usage: xmldump filename";
+        try
+        {
+            svg::writeJSON(std::cout, svg::profileSVG(argv[2]));
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
+    }
+    else if (argc != 2)
+    {
+        std::cout << "Usage: xmldump filename" << std::endl;
+        std::cout << "       xmldump --profile filename.svg" << std::endl;
     }
     else
     {
-        doc.LoadFile(argv[1]);
+        try
+        {
+            svg::loadXML(doc, argv[1]);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << e.what() << std::endl;
+            return 1;
+        }
         dump(doc.RootElement(), 0);
     }
     return 0;
-}
\ No newline at end of file
+}